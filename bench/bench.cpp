@@ -0,0 +1,380 @@
+// Benchmark suite for the engine's hot paths, built as VulkanEngineBench from the same headers as the
+// engine.
+//
+//   VulkanEngineBench [--json <file>] [--filter <substring>] [--frames <n>]
+//
+// Micro benchmarks run on the CPU alone: uuid_to_string, the std::formatter specializations, extension
+// lookups in long lists and building a dear imgui frame. Macro benchmarks drive the engine headless:
+// setup and teardown time, frames/s with a mesh and sprite scene, resize latency and the mesh path from
+// 1k to 1M objects. Results go to a JSON file (bench.json by default) for tracking over time, pick the
+// device with DS_GPU or e.g. VK_DRIVER_FILES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json for lavapipe.
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <imgui.h>
+#include <imgui_impl_sdl3.h>
+#include <imgui_impl_vulkan.h>
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_version.h>
+#include <SDL3/SDL_vulkan.h>
+
+#include <vulkan/vulkan.h>
+#ifndef VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME
+#define VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME "VK_KHR_portability_enumeration"
+#endif
+#ifndef VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME
+#define VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME "VK_KHR_portability_subset"
+#endif
+#ifndef VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR
+#define VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR 0x00000001
+#endif
+
+#include "../src/engine.hpp"
+#include "../src/global.hpp"
+#include "../src/gui.hpp"
+#include "../src/host_allocator.hpp"
+#include "../src/jobs.hpp"
+#include "../src/log.hpp"
+#include "../src/meshes.hpp"
+#include "../src/profiler.hpp"
+#include "../src/recording.hpp"
+#include "../src/sprites.hpp"
+#include "../src/transfer.hpp"
+#include "../src/util.hpp"
+#include "../src/validation.hpp"
+#include "../src/vulkan_util.hpp"
+
+using std::println, std::print;
+
+using namespace DS;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    std::string unit;
+    uint64_t iterations = 0; // Per sample
+    std::vector<double> samples;
+};
+
+std::vector<Result> g_Results;
+std::string g_Filter;
+std::string g_JsonPath = Constants::bench_suite_json_path;
+uint32_t g_FrameCount = Constants::bench_suite_frames;
+std::string g_DeviceName; // Read before teardown destroys the instance
+uint32_t g_DriverVersion = 0;
+
+bool enabled(std::string_view name) {
+    return g_Filter.empty() || name.find(g_Filter) != std::string_view::npos;
+}
+
+bool any_enabled(std::initializer_list<std::string_view> names) {
+    return std::any_of(names.begin(), names.end(), enabled);
+}
+
+// Keeps the compiler from optimizing a benchmarked result away
+template <typename T>
+void keep(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+double percentile(std::vector<double> sorted, double p) {
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())))];
+}
+
+double mean(const std::vector<double> &samples) {
+    double sum = 0.0;
+    for (double s : samples) sum += s;
+    return sum / static_cast<double>(samples.size());
+}
+
+void report(Result result) {
+    DS_LOG_INFO(Bench, "{:<40} median {:>12.3f} {}, min {:>12.3f} {} ({} samples x {})", result.name,
+        percentile(result.samples, 0.5), result.unit, *std::min_element(result.samples.begin(), result.samples.end()),
+        result.unit, result.samples.size(), result.iterations);
+    g_Results.push_back(std::move(result));
+}
+
+// Runs `function` in batches long enough to time reliably and reports ns per call
+template <typename F>
+void micro(std::string_view name, F function) {
+    if (!enabled(name)) return;
+    const auto sample_time = std::chrono::milliseconds(Constants::bench_suite_sample_ms);
+    uint64_t iterations = 1;
+    for (;;) {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) function();
+        if (Clock::now() - start >= sample_time / 4) break;
+        iterations *= 2;
+    }
+    iterations *= 4;
+
+    Result result = {.name = std::string(name), .unit = "ns", .iterations = iterations, .samples = {}};
+    for (uint32_t sample = 0; sample < Constants::bench_suite_samples; ++sample) {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) function();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        result.samples.push_back(ns / static_cast<double>(iterations));
+    }
+    report(std::move(result));
+}
+
+// Without a renderer backend the bench acknowledges texture requests itself
+void acknowledge_textures() {
+    for (ImTextureData *texture : ImGui::GetPlatformIO().Textures) {
+        if (texture->Status == ImTextureStatus_WantCreate || texture->Status == ImTextureStatus_WantUpdates) {
+            texture->SetTexID(static_cast<ImTextureID>(1));
+            texture->SetStatus(ImTextureStatus_OK);
+        } else if (texture->Status == ImTextureStatus_WantDestroy) {
+            texture->SetTexID(ImTextureID_Invalid);
+            texture->SetStatus(ImTextureStatus_Destroyed);
+        }
+    }
+}
+
+void micro_benchmarks() {
+    VkPhysicalDeviceProperties properties = {};
+    properties.apiVersion = VK_API_VERSION_1_3;
+    properties.driverVersion = VK_MAKE_VERSION(24, 2, 8);
+    properties.vendorID = 0x10005;
+    properties.deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+    std::snprintf(properties.deviceName, sizeof(properties.deviceName), "llvmpipe (LLVM 17.0.6, 256 bits)");
+    for (size_t i = 0; i < Constants::uuid_size; ++i) properties.pipelineCacheUUID[i] = static_cast<uint8_t>(i * 37);
+
+    micro("micro/uuid_to_string", [&] { keep(Util::uuid_to_string(properties.pipelineCacheUUID)); });
+
+    std::string text;
+    text.reserve(1024);
+    auto format_into = [&text](const auto &value) {
+        text.clear();
+        std::format_to(std::back_inserter(text), "{}", value);
+        keep(text);
+    };
+    VkExtensionProperties extension = {};
+    std::snprintf(extension.extensionName, sizeof(extension.extensionName), "VK_KHR_dynamic_rendering");
+    extension.specVersion = 1;
+    micro("micro/format/VkResult", [&] { format_into(VK_ERROR_OUT_OF_DATE_KHR); });
+    micro("micro/format/VkPresentModeKHR", [&] { format_into(VK_PRESENT_MODE_MAILBOX_KHR); });
+    micro("micro/format/VkExtensionProperties", [&] { format_into(extension); });
+    micro("micro/format/VkPhysicalDeviceProperties", [&] { format_into(properties); });
+
+    // A driver's worth of extensions and then some, the looked up one last
+    std::vector<VkExtensionProperties> extensions(Constants::bench_suite_extensions);
+    for (uint32_t i = 0; i < extensions.size(); ++i) {
+        std::snprintf(extensions[i].extensionName, sizeof(extensions[i].extensionName), "VK_EXT_synthetic_extension_%04u", i);
+    }
+    std::snprintf(extensions.back().extensionName, sizeof(extensions.back().extensionName), "%s", Vulkan::Strings::extension_swapchain);
+    micro("micro/has_extension/last", [&] { keep(Vulkan::has_extension(extensions, Vulkan::Strings::extension_swapchain)); });
+    micro("micro/has_extension/missing", [&] { keep(Vulkan::has_extension(extensions, "VK_EXT_not_there")); });
+
+    if (any_enabled({"micro/imgui/empty_frame", "micro/imgui/demo_window_frame"})) {
+        ImGuiContext *context = ImGui::CreateContext();
+        ImGuiIO &io = ImGui::GetIO();
+        io.IniFilename = nullptr;
+        io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+        io.DisplaySize = ImVec2(static_cast<float>(Constants::window_width), static_cast<float>(Constants::window_height));
+        io.DeltaTime = 1.0f / 60.0f;
+        auto frame = [](bool demo) {
+            ImGui::NewFrame();
+            if (demo) ImGui::ShowDemoWindow();
+            ImGui::Render();
+            acknowledge_textures();
+            keep(ImGui::GetDrawData()->TotalVtxCount);
+        };
+        micro("micro/imgui/empty_frame", [&] { frame(false); });
+        micro("micro/imgui/demo_window_frame", [&] { frame(true); });
+        ImGui::DestroyContext(context);
+    }
+}
+
+// The headless path of the main loop, with a fixed time step so every run animates the same
+void render_frame(uint64_t index) {
+    Profiler::begin_frame();
+    Jobs::begin_frame();
+    HostAllocator::begin_frame();
+    Validation::begin_frame();
+    Sprites::begin_frame();
+    ImGui_ImplVulkan_NewFrame();
+    Engine::headless_new_frame();
+    const float time = static_cast<float>(index) / 60.0f;
+    Meshes::animate(g_WD, time);
+    Sprites::demo(g_WD, time);
+    ImGui::NewFrame();
+    GUI::debug();
+    ImGui::Render();
+    for (int i = 0; i < 3; ++i) g_MainWindowData.ClearValue.color.float32[i] = g_ClearColor[i] * g_ClearColor.w;
+    g_MainWindowData.ClearValue.color.float32[3] = g_ClearColor.w;
+    if (Engine::FrameRender(&g_MainWindowData, ImGui::GetDrawData())) Engine::FramePresent(&g_MainWindowData);
+    Profiler::end_frame();
+}
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void macro_benchmarks() {
+    if (!any_enabled({"macro/setup", "macro/frame", "macro/frames_per_second", "macro/resize", "macro/meshes", "macro/teardown"})) return;
+    g_Headless = true;
+    Meshes::g_DemoCount = Constants::bench_suite_meshes;
+    Sprites::g_DemoCount = Constants::bench_suite_sprites;
+
+    auto start = Clock::now();
+    Engine::setup();
+    double setup_ms = elapsed_ms(start);
+    if (enabled("macro/setup")) report({.name = "macro/setup", .unit = "ms", .iterations = 1, .samples = {setup_ms}});
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+    g_DeviceName = properties.deviceName;
+    g_DriverVersion = properties.driverVersion;
+    Meshes::demo_scene(Meshes::g_DemoCount);
+
+    uint64_t frame_index = 0;
+    if (any_enabled({"macro/frame", "macro/frames_per_second"})) {
+        for (uint32_t i = 0; i < Constants::bench_suite_warmup_frames; ++i) render_frame(frame_index++);
+        Result frames = {.name = "macro/frame", .unit = "ms", .iterations = 1, .samples = {}};
+        auto run_start = Clock::now();
+        for (uint32_t i = 0; i < g_FrameCount; ++i) {
+            auto frame_start = Clock::now();
+            render_frame(frame_index++);
+            frames.samples.push_back(elapsed_ms(frame_start));
+        }
+        Vulkan::check(vkDeviceWaitIdle(g_Device));
+        double fps = 1000.0 * static_cast<double>(g_FrameCount) / elapsed_ms(run_start);
+        report(std::move(frames));
+        report({.name = "macro/frames_per_second", .unit = "frames/s", .iterations = g_FrameCount, .samples = {fps}});
+    }
+
+    // Latency from the resize to the first frame at the new size being done on the GPU
+    if (enabled("macro/resize")) {
+        Result resizes = {.name = "macro/resize", .unit = "ms", .iterations = 1, .samples = {}};
+        for (uint32_t i = 0; i < Constants::bench_suite_resizes; ++i) {
+            const bool shrink = i % 2 == 0;
+            auto resize_start = Clock::now();
+            Engine::resize_headless_target(shrink ? Constants::window_width / 2 : Constants::window_width,
+                shrink ? Constants::window_height / 2 : Constants::window_height);
+            render_frame(frame_index++);
+            Vulkan::check(vkDeviceWaitIdle(g_Device));
+            resizes.samples.push_back(elapsed_ms(resize_start));
+        }
+        report(std::move(resizes));
+    }
+
+    // The mesh path's CPU cost from 1k to 1M objects: uploading the scene grows with it, recording the
+    // mesh secondary shouldn't. Frames include the GPU, which does grow.
+    for (uint32_t count = Constants::bench_suite_mesh_scale_min; count <= Constants::bench_suite_mesh_scale_max; count *= 10) {
+        const std::string name = std::format("macro/meshes/{}", count);
+        if (!enabled(name) || !Meshes::g_Enabled) continue;
+        Vulkan::check(vkDeviceWaitIdle(g_Device));
+        auto upload_start = Clock::now();
+        Meshes::demo_scene(count);
+        Transfer::flush();
+        Vulkan::check(vkDeviceWaitIdle(g_Device));
+        report({.name = name + "/upload", .unit = "ms", .iterations = 1, .samples = {elapsed_ms(upload_start)}});
+
+        for (uint32_t i = 0; i < Constants::bench_suite_warmup_frames; ++i) render_frame(frame_index++);
+        Result frames = {.name = name + "/frame", .unit = "ms", .iterations = 1, .samples = {}};
+        for (uint32_t i = 0; i < Constants::bench_suite_mesh_scale_frames; ++i) {
+            auto frame_start = Clock::now();
+            render_frame(frame_index++);
+            frames.samples.push_back(elapsed_ms(frame_start));
+        }
+        report(std::move(frames));
+
+        Vulkan::check(vkDeviceWaitIdle(g_Device));
+        VkCommandBufferInheritanceRenderingInfo rendering;
+        VkCommandBufferInheritanceInfo inheritance = Engine::make_inheritance(g_WD, rendering);
+        const std::array<Recording::Task, 1> tasks = {[](VkCommandBuffer cmd) { Meshes::record(cmd, g_WD); }};
+        Result record = {.name = name + "/record", .unit = "ms", .iterations = 1, .samples = {}};
+        for (uint32_t i = 0; i < Constants::bench_suite_mesh_scale_frames; ++i) {
+            Recording::reset(g_FrameSlot);
+            auto record_start = Clock::now();
+            keep(Recording::record(g_FrameSlot, inheritance, tasks, 1)[0]);
+            record.samples.push_back(elapsed_ms(record_start));
+        }
+        Recording::reset(g_FrameSlot);
+        report(std::move(record));
+    }
+
+    start = Clock::now();
+    Engine::cleanup();
+    if (enabled("macro/teardown")) report({.name = "macro/teardown", .unit = "ms", .iterations = 1, .samples = {elapsed_ms(start)}});
+}
+
+std::string escape(std::string_view text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+    }
+    return out;
+}
+
+void write_json() {
+    std::ofstream file(g_JsonPath, std::ios::trunc);
+    if (!file) {
+        DS_LOG_ERROR(Bench, "Can't open '{}' for writing", g_JsonPath);
+        exit(-1);
+    }
+    auto now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+#ifdef NDEBUG
+    constexpr std::string_view build = "release";
+#else
+    constexpr std::string_view build = "debug";
+#endif
+    file << std::format("{{\n  \"schema\": 1,\n  \"timestamp\": \"{:%FT%TZ}\",\n  \"build\": \"{}\",\n", now, build);
+    file << std::format("  \"device\": \"{}\",\n  \"driver_version\": {},\n  \"benchmarks\": [", escape(g_DeviceName), g_DriverVersion);
+    for (size_t i = 0; i < g_Results.size(); ++i) {
+        const Result &result = g_Results[i];
+        file << std::format("{}\n    {{\"name\": \"{}\", \"unit\": \"{}\", \"samples\": {}, \"iterations\": {}, "
+                            "\"mean\": {}, \"median\": {}, \"p99\": {}, \"min\": {}, \"max\": {}}}",
+            i == 0 ? "" : ",", escape(result.name), escape(result.unit), result.samples.size(), result.iterations,
+            mean(result.samples), percentile(result.samples, 0.5), percentile(result.samples, 0.99),
+            *std::min_element(result.samples.begin(), result.samples.end()),
+            *std::max_element(result.samples.begin(), result.samples.end()));
+    }
+    file << "\n  ]\n}\n";
+    DS_LOG_INFO(Bench, "Wrote {} results to '{}'", g_Results.size(), g_JsonPath);
+}
+
+bool parse_uint(std::string_view text, uint32_t &out) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc{} && ptr == text.data() + text.size();
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    Log::start();
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if ((arg == "--json" || arg == "--filter") && i + 1 < argc) {
+            (arg == "--json" ? g_JsonPath : g_Filter) = argv[++i];
+        } else if (arg == "--frames" && i + 1 < argc && parse_uint(argv[i + 1], g_FrameCount) && g_FrameCount > 0) {
+            ++i;
+        } else {
+            println(stderr, "Usage: {} [--json <file>] [--filter <substring>] [--frames <n>]", argv[0]);
+            return -1;
+        }
+    }
+
+    micro_benchmarks();
+    macro_benchmarks();
+    write_json();
+}
@@ -0,0 +1,21 @@
+#version 450
+
+layout(push_constant) uniform PushConstants {
+    mat4 view_proj;
+    vec4 light; // xyz direction towards the light, w ambient
+    uint objects;
+    uint meshes;
+    uint draws;
+    uint object_count;
+    uint compact;
+} pc;
+
+layout(location = 0) in vec3 in_normal;
+layout(location = 1) in vec4 in_color;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    float diffuse = max(dot(normalize(in_normal), normalize(pc.light.xyz)), 0.0);
+    out_color = vec4(in_color.rgb * (pc.light.w + (1.0 - pc.light.w) * diffuse), in_color.a);
+}
@@ -0,0 +1,42 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+
+// See DS::Meshes::Object
+struct Object {
+    vec4 position_scale;
+    vec4 rotation;
+    uint mesh;
+    uint color;
+    uint pad[2];
+};
+
+layout(set = 1, binding = 0) readonly buffer Objects { Object objects[]; } object_buffers[];
+
+layout(push_constant) uniform PushConstants {
+    mat4 view_proj;
+    vec4 light;
+    uint objects;
+    uint meshes;
+    uint draws;
+    uint object_count;
+    uint compact;
+} pc;
+
+layout(location = 0) out vec3 out_normal;
+layout(location = 1) out vec4 out_color;
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() {
+    // The culling pass puts the object index in firstInstance
+    Object object = object_buffers[pc.objects].objects[gl_InstanceIndex];
+    vec3 world = rotate(object.rotation, in_position * object.position_scale.w) + object.position_scale.xyz;
+    gl_Position = pc.view_proj * vec4(world, 1.0);
+    out_normal = rotate(object.rotation, in_normal);
+    out_color = unpackUnorm4x8(object.color);
+}
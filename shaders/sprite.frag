@@ -0,0 +1,22 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Bindless tables, see DS::Bindless
+layout(set = 0, binding = 0) uniform texture2D textures[];
+layout(set = 2, binding = 0) uniform sampler samplers[];
+
+layout(push_constant) uniform PushConstants {
+    vec2 pixel_to_ndc;
+    uint texture;
+    uint sampler_index;
+} pc;
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 1) in vec4 in_color;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    // One texture per draw, so the index is dynamically uniform
+    out_color = in_color * texture(sampler2D(textures[pc.texture], samplers[pc.sampler_index]), in_uv);
+}
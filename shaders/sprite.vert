@@ -0,0 +1,29 @@
+#version 450
+
+// Per instance, see DS::Sprites::Instance
+layout(location = 0) in vec2 in_position; // Center in pixels
+layout(location = 1) in vec2 in_size;     // In pixels
+layout(location = 2) in vec4 in_uv_rect;  // u0, v0, u1, v1
+layout(location = 3) in vec4 in_color;
+layout(location = 4) in float in_rotation; // Radians, around the center
+
+layout(push_constant) uniform PushConstants {
+    vec2 pixel_to_ndc; // 2 / viewport size
+    uint texture;
+    uint sampler_index;
+} pc;
+
+layout(location = 0) out vec2 out_uv;
+layout(location = 1) out vec4 out_color;
+
+void main() {
+    // Triangle strip over the unit square, no vertex buffer
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec2 local = (corner - 0.5) * in_size;
+    float c = cos(in_rotation);
+    float s = sin(in_rotation);
+    vec2 pixel = in_position + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+    gl_Position = vec4(pixel * pc.pixel_to_ndc - 1.0, 0.0, 1.0);
+    out_uv = mix(in_uv_rect.xy, in_uv_rect.zw, corner);
+    out_color = in_color;
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace DS::AssetFormat {
+// Packed asset container, written offline by tools/asset_packer and read in place from a mapping
+// (see DS::Assets). Everything is little endian and naturally aligned, so the header, index and
+// payloads are used straight from the file bytes without parsing or copying:
+//
+//   Header | payloads, each aligned to data_alignment | Entry index, sorted by name | names
+//
+// Texture payloads are the mip levels back to back, largest first, each tightly packed and aligned
+// to level_alignment. Mesh payloads are the vertices followed by the 32 bit indices at index_offset.
+static_assert(std::endian::native == std::endian::little, "Packages are stored little endian");
+
+constexpr uint32_t magic = 0x4B505344; // "DSPK"
+constexpr uint32_t version = 1;
+constexpr uint64_t data_alignment = 4096; // Page aligned, so a consumed payload can be released from the mapping
+constexpr uint64_t level_alignment = 16;
+
+enum class Type : uint32_t {
+    Blob,
+    Mesh,
+    Texture,
+};
+
+enum class TextureFormat : uint32_t {
+    RGBA8, // VK_FORMAT_R8G8B8A8_UNORM
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t reserved;
+    uint64_t index_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t file_size;
+};
+static_assert(sizeof(Header) == 48);
+
+struct Entry {
+    uint64_t offset; // Payload, from the start of the file
+    uint64_t size;
+    uint32_t name_offset; // Into the name table, not null terminated
+    uint32_t name_size;
+    Type type;
+    uint32_t reserved;
+    // Mesh
+    uint32_t vertex_count;
+    uint32_t vertex_stride;
+    uint64_t index_offset; // From the start of the payload
+    uint32_t index_count;
+    // Texture
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    TextureFormat format;
+    uint32_t pad[3];
+};
+static_assert(sizeof(Entry) == 80);
+
+constexpr uint64_t align_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+constexpr uint32_t texel_size(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::RGBA8:
+    default:
+        return 4;
+    }
+}
+
+constexpr uint32_t level_extent(uint32_t extent, uint32_t level) {
+    return std::max(1u, extent >> level);
+}
+
+constexpr uint64_t level_size(const Entry &entry, uint32_t level) {
+    return static_cast<uint64_t>(level_extent(entry.width, level)) * level_extent(entry.height, level) * texel_size(entry.format);
+}
+
+// Offset of mip `level` from the start of the payload
+constexpr uint64_t level_offset(const Entry &entry, uint32_t level) {
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < level; ++i) offset = align_up(offset + level_size(entry, i), level_alignment);
+    return offset;
+}
+
+// A validated package, the bytes have to stay alive and unchanged while it is used
+struct View {
+    std::span<const uint8_t> bytes;
+
+    bool valid() const {
+        return !bytes.empty();
+    }
+};
+
+const Header &header(const View &view) {
+    return *reinterpret_cast<const Header *>(view.bytes.data());
+}
+
+std::span<const Entry> entries(const View &view) {
+    if (!view.valid()) return {};
+    return {reinterpret_cast<const Entry *>(view.bytes.data() + header(view).index_offset), header(view).entry_count};
+}
+
+std::string_view name(const View &view, const Entry &entry) {
+    return {reinterpret_cast<const char *>(view.bytes.data() + header(view).names_offset + entry.name_offset), entry.name_size};
+}
+
+std::span<const uint8_t> payload(const View &view, const Entry &entry) {
+    return view.bytes.subspan(entry.offset, entry.size);
+}
+
+// Checks the header and every index entry against the size of `bytes`. Returns nullptr and fills
+// `view` if the package is well formed, otherwise what is wrong with it.
+const char *open(std::span<const uint8_t> bytes, View &view) {
+    view = {};
+    if (bytes.size() < sizeof(Header)) return "file too small";
+    if (reinterpret_cast<uintptr_t>(bytes.data()) % alignof(Entry) != 0) return "misaligned data";
+    const auto *h = reinterpret_cast<const Header *>(bytes.data());
+    if (h->magic != magic) return "bad magic";
+    if (h->version != version) return "unsupported version";
+    if (h->file_size != bytes.size()) return "truncated";
+    if (h->index_offset % alignof(Entry) != 0 || h->index_offset > bytes.size() ||
+        (bytes.size() - h->index_offset) / sizeof(Entry) < h->entry_count) return "index out of bounds";
+    if (h->names_offset > bytes.size() || bytes.size() - h->names_offset < h->names_size) return "names out of bounds";
+    const auto *all = reinterpret_cast<const Entry *>(bytes.data() + h->index_offset);
+    for (uint32_t i = 0; i < h->entry_count; ++i) {
+        const Entry &entry = all[i];
+        if (entry.offset > bytes.size() || bytes.size() - entry.offset < entry.size) return "payload out of bounds";
+        if (static_cast<uint64_t>(entry.name_offset) + entry.name_size > h->names_size) return "name out of bounds";
+        if (entry.type == Type::Mesh &&
+            (entry.index_offset > entry.size || (entry.size - entry.index_offset) / sizeof(uint32_t) < entry.index_count ||
+                static_cast<uint64_t>(entry.vertex_count) * entry.vertex_stride > entry.index_offset)) return "mesh out of bounds";
+        if (entry.type == Type::Texture &&
+            (entry.width == 0 || entry.height == 0 || entry.mip_levels == 0 ||
+                entry.mip_levels > static_cast<uint32_t>(std::bit_width(std::max(entry.width, entry.height))) ||
+                level_offset(entry, entry.mip_levels - 1) + level_size(entry, entry.mip_levels - 1) > entry.size)) return "texture levels out of bounds";
+    }
+    view.bytes = bytes;
+    return nullptr;
+}
+
+// Binary search over the sorted index, nullptr if there is no such asset
+const Entry *find(const View &view, std::string_view asset) {
+    std::span<const Entry> all = entries(view);
+    auto it = std::lower_bound(all.begin(), all.end(), asset, [&view](const Entry &entry, std::string_view key) {
+        return name(view, entry) < key;
+    });
+    return it != all.end() && name(view, *it) == asset ? &*it : nullptr;
+}
+} // namespace DS::AssetFormat
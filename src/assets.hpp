@@ -0,0 +1,382 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vulkan/vulkan.h>
+
+#include "asset_format.hpp"
+#include "bindless.hpp"
+#include "deletion_queue.hpp"
+#include "global.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+#include "profiler.hpp"
+#include "transfer.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Assets {
+// Runtime side of the asset container (see DS::AssetFormat and tools/asset_packer). A package is
+// mmapped and validated once; lookups go through the sorted index in the mapping, nothing is parsed
+// or copied. load() creates the GPU resource and queues the asset, pump() then streams payload byte
+// ranges from the mapping straight into the staging ring, a budget per frame, so large packages
+// load progressively while the frame loop keeps running. A full ring ends the frame's pumping
+// instead of waiting. Consumed pages are dropped from the mapping and the next range is prefetched.
+enum class State {
+    Streaming,
+    Ready,
+    Failed,
+};
+
+struct Package {
+    std::string path;
+    std::span<const uint8_t> mapping; // Empty when read into `owned`
+    std::vector<uint8_t> owned;       // Read-whole-file loader, only for the benchmark
+    AssetFormat::View view;
+    uint32_t pending = 0;
+    uint64_t pending_bytes = 0;
+    std::chrono::steady_clock::time_point started;
+};
+
+struct Asset {
+    std::string name;
+    Package *package = nullptr;
+    const AssetFormat::Entry *entry = nullptr; // Into the mapping, only valid while streaming
+    Memory::Buffer *buffer = nullptr;          // Blob and mesh payloads
+    Memory::Image *image = nullptr;            // Textures
+    VkImageView view = VK_NULL_HANDLE;
+    Bindless::ImageHandle texture;
+    uint64_t uploaded = 0; // Bytes for buffers, mip levels for textures
+    State state = State::Streaming;
+};
+
+std::vector<Package *> g_Packages;
+std::vector<Asset *> g_Assets;
+std::deque<Asset *> g_Queue; // Streaming, in request order
+uint64_t g_BytesStreamed = 0;
+size_t g_PageSize = 0;
+
+std::string g_LoadPath;  // --load
+std::string g_BenchPath; // --bench-assets
+
+// Lets the kernel drop the pages of a consumed range, only whole pages inside it
+void release_pages(const Package &package, uint64_t offset, uint64_t size) {
+    if (package.mapping.empty()) return;
+    uint64_t begin = AssetFormat::align_up(offset, g_PageSize);
+    uint64_t end = (offset + size) & ~(static_cast<uint64_t>(g_PageSize) - 1);
+    if (end <= begin) return;
+    madvise(const_cast<uint8_t *>(package.mapping.data()) + begin, end - begin, MADV_DONTNEED);
+}
+
+// Starts reading the next range in the background, so pump() doesn't block on page faults
+void prefetch(const Package &package, uint64_t offset, uint64_t size) {
+    if (package.mapping.empty() || offset >= package.mapping.size()) return;
+    size = std::min<uint64_t>(size, package.mapping.size() - offset);
+    uint64_t begin = offset & ~(static_cast<uint64_t>(g_PageSize) - 1);
+    uint64_t end = std::min<uint64_t>(AssetFormat::align_up(offset + size, g_PageSize), package.mapping.size());
+    if (end <= begin) return;
+    madvise(const_cast<uint8_t *>(package.mapping.data()) + begin, end - begin, MADV_WILLNEED);
+}
+
+// Maps (or with `mapped` false reads) and validates a package. Returns nullptr on failure.
+Package *open(const std::string &path, bool mapped = true) {
+    if (g_PageSize == 0) g_PageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto *package = new Package();
+    package->path = path;
+    std::span<const uint8_t> bytes;
+    if (mapped) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info = {};
+        if (fd < 0 || fstat(fd, &info) != 0 || info.st_size <= 0) {
+            DS_LOG_ERROR(Assets, "Can't open '{}': {}", path, std::strerror(errno));
+            if (fd >= 0) ::close(fd);
+            delete package;
+            return nullptr;
+        }
+        void *mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps the file open
+        if (mapping == MAP_FAILED) {
+            DS_LOG_ERROR(Assets, "Can't map '{}': {}", path, std::strerror(errno));
+            delete package;
+            return nullptr;
+        }
+        madvise(mapping, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+        package->mapping = {static_cast<const uint8_t *>(mapping), static_cast<size_t>(info.st_size)};
+        bytes = package->mapping;
+    } else {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            DS_LOG_ERROR(Assets, "Can't open '{}'", path);
+            delete package;
+            return nullptr;
+        }
+        package->owned.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(package->owned.data()), static_cast<std::streamsize>(package->owned.size()));
+        bytes = package->owned;
+    }
+
+    if (const char *error = AssetFormat::open(bytes, package->view)) {
+        DS_LOG_ERROR(Assets, "'{}' is not a valid package: {}", path, error);
+        if (!package->mapping.empty()) munmap(const_cast<uint8_t *>(package->mapping.data()), package->mapping.size());
+        delete package;
+        return nullptr;
+    }
+    g_Packages.push_back(package);
+    return package;
+}
+
+// Destroys the asset's resources right away, the GPU must be done with them
+void destroy(Asset *asset) {
+    Bindless::release(asset->texture);
+    if (asset->view != VK_NULL_HANDLE) vkDestroyImageView(g_Device, asset->view, g_Allocator);
+    Memory::destroy_image(asset->image);
+    Memory::destroy_buffer(asset->buffer);
+    delete asset;
+}
+
+void forget(Asset *asset) {
+    g_Queue.erase(std::remove(g_Queue.begin(), g_Queue.end(), asset), g_Queue.end());
+    g_Assets.erase(std::remove(g_Assets.begin(), g_Assets.end(), asset), g_Assets.end());
+    if (asset->state == State::Streaming && asset->package) --asset->package->pending;
+}
+
+// Frees the asset once the frames that may use it have retired
+void release(Asset *asset) {
+    if (!asset) return;
+    forget(asset);
+    Bindless::release(asset->texture);
+    asset->texture = {};
+    Memory::destroy_image_deferred(asset->image);
+    Memory::destroy_buffer_deferred(asset->buffer);
+    asset->image = nullptr;
+    asset->buffer = nullptr;
+    DeletionQueue::push([asset] { destroy(asset); });
+}
+
+// Assets still streaming from the package are cancelled, loaded ones stay valid
+void close(Package *package) {
+    if (!package) return;
+    for (Asset *asset : g_Assets) {
+        if (asset->package != package) continue;
+        if (asset->state == State::Streaming) {
+            DS_LOG_WARNING(Assets, "'{}' closed while '{}' was still streaming", package->path, asset->name);
+            asset->state = State::Failed;
+            g_Queue.erase(std::remove(g_Queue.begin(), g_Queue.end(), asset), g_Queue.end());
+        }
+        asset->package = nullptr;
+        asset->entry = nullptr;
+    }
+    if (!package->mapping.empty()) munmap(const_cast<uint8_t *>(package->mapping.data()), package->mapping.size());
+    g_Packages.erase(std::remove(g_Packages.begin(), g_Packages.end(), package), g_Packages.end());
+    delete package;
+}
+
+// Creates the asset's GPU resource and queues its payload for streaming. Returns nullptr if the
+// package has no such asset or it is a texture too large for the device.
+Asset *load(Package *package, std::string_view name) {
+    const AssetFormat::Entry *entry = AssetFormat::find(package->view, name);
+    if (!entry) {
+        DS_LOG_ERROR(Assets, "No asset '{}' in '{}'", name, package->path);
+        return nullptr;
+    }
+    if (entry->type == AssetFormat::Type::Texture) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+        uint32_t max_dimension = properties.limits.maxImageDimension2D;
+        if (entry->width > max_dimension || entry->height > max_dimension) {
+            DS_LOG_ERROR(Assets, "Texture '{}' in '{}' is {}x{}, this device supports up to {}", name, package->path,
+                entry->width, entry->height, max_dimension);
+            return nullptr;
+        }
+    }
+    auto *asset = new Asset();
+    asset->name = name;
+    asset->package = package;
+    asset->entry = entry;
+    if (entry->type == AssetFormat::Type::Texture) {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        image_info.extent = {entry->width, entry->height, 1};
+        image_info.mipLevels = entry->mip_levels;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        asset->image = Memory::create_image(image_info, Memory::Usage::GpuOnly);
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = asset->image->image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = image_info.format;
+        view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, entry->mip_levels, 0, 1};
+        Vulkan::check(vkCreateImageView(g_Device, &view_info, g_Allocator, &asset->view));
+    } else if (entry->size > 0) {
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if (entry->type == AssetFormat::Type::Mesh) usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        // Streamed in and out with the packages, and never written by the GPU, so movable
+        asset->buffer = Memory::create_buffer(entry->size, usage, Memory::Usage::GpuOnly, true);
+    }
+    if (package->pending == 0) package->started = std::chrono::steady_clock::now();
+    ++package->pending;
+    package->pending_bytes += entry->size;
+    g_Assets.push_back(asset);
+    g_Queue.push_back(asset);
+    return asset;
+}
+
+void load_all(Package *package) {
+    if (!package) return;
+    for (const AssetFormat::Entry &entry : AssetFormat::entries(package->view)) load(package, AssetFormat::name(package->view, entry));
+}
+
+void finish(Asset *asset, State state) {
+    asset->state = state;
+    if (state == State::Ready && asset->view != VK_NULL_HANDLE) asset->texture = Bindless::register_image(asset->view);
+    Package *package = asset->package;
+    asset->entry = nullptr;
+    if (--package->pending > 0) return;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - package->started).count();
+    DS_LOG_INFO(Assets, "Streamed '{}', {:.2f} MiB in {:.3f} ms", package->path,
+        static_cast<double>(package->pending_bytes) / (1024.0 * 1024.0), ms);
+    package->pending_bytes = 0;
+}
+
+// Streams up to `budget` bytes of queued payloads into the staging ring. Call before
+// Transfer::flush; an asset is Ready once its last range has been queued, the frames submitted
+// after that flush see it.
+void pump(uint64_t budget) {
+    DS_PROFILE_SCOPE("Assets::pump");
+    uint64_t left = budget;
+    while (!g_Queue.empty() && left > 0) {
+        Asset *asset = g_Queue.front();
+        const AssetFormat::Entry &entry = *asset->entry;
+        const Package &package = *asset->package;
+        std::span<const uint8_t> payload = AssetFormat::payload(package.view, entry);
+        bool done;
+        if (entry.type == AssetFormat::Type::Texture) {
+            uint32_t level = static_cast<uint32_t>(asset->uploaded);
+            uint64_t offset = AssetFormat::level_offset(entry, level);
+            uint64_t size = AssetFormat::level_size(entry, level);
+            if (size > Constants::staging_ring_size) {
+                DS_LOG_ERROR(Assets, "'{}' mip {} is larger than the staging ring, skipped", asset->name, level);
+                g_Queue.pop_front();
+                finish(asset, State::Failed);
+                continue;
+            }
+            if (size > left && left < budget) break; // Starts next frame with the full budget
+            VkExtent3D extent = {AssetFormat::level_extent(entry.width, level), AssetFormat::level_extent(entry.height, level), 1};
+            if (!Transfer::upload_image(asset->image->image, {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1}, extent,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, payload.data() + offset, size)) break;
+            release_pages(package, entry.offset + offset, size);
+            left -= std::min(left, size);
+            g_BytesStreamed += size;
+            done = ++asset->uploaded == entry.mip_levels;
+        } else {
+            uint64_t size = std::min({entry.size - asset->uploaded, left, Constants::asset_chunk_size});
+            if (size > 0 && !Transfer::upload_buffer(asset->buffer, asset->uploaded, payload.data() + asset->uploaded, size)) break;
+            release_pages(package, entry.offset + asset->uploaded, size);
+            asset->uploaded += size;
+            left -= size;
+            g_BytesStreamed += size;
+            done = asset->uploaded == entry.size;
+        }
+        if (done) {
+            g_Queue.pop_front();
+            finish(asset, State::Ready);
+        }
+    }
+    if (!g_Queue.empty()) {
+        const Asset &next = *g_Queue.front();
+        bool texture = next.entry->type == AssetFormat::Type::Texture;
+        uint64_t position = texture ? AssetFormat::level_offset(*next.entry, static_cast<uint32_t>(next.uploaded)) : next.uploaded;
+        prefetch(*next.package, next.entry->offset + position, budget);
+    }
+}
+
+// Only valid once the device is idle, before DeletionQueue::flush and Bindless::cleanup
+void cleanup() {
+    for (Asset *asset : g_Assets) destroy(asset);
+    g_Assets.clear();
+    g_Queue.clear();
+    while (!g_Packages.empty()) close(g_Packages.back());
+}
+
+// Highest resident set size so far in bytes. On Linux the peak can be reset between runs.
+uint64_t peak_rss() {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with("VmHWM:")) return std::stoull(line.substr(6)) * 1024;
+    }
+    return 0;
+#else
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss); // Bytes on macOS
+#endif
+}
+
+void reset_peak_rss() {
+#ifdef __linux__
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+// --bench-assets <package>: loads every asset of the package through the mapping, then again with
+// the whole file read into memory first, streaming without a frame budget. Without a resettable
+// peak (macOS) the mapped run goes first so the larger read peak shows up as growth.
+void benchmark() {
+    using Clock = std::chrono::steady_clock;
+    Vulkan::check(vkDeviceWaitIdle(g_Device));
+    DS_LOG_INFO(Assets, "Asset load benchmark, '{}'", g_BenchPath);
+    for (bool mapped : {true, false}) {
+        reset_peak_rss();
+        uint64_t rss_before = peak_rss();
+        auto start = Clock::now();
+        Package *package = open(g_BenchPath, mapped);
+        if (!package) return;
+        load_all(package);
+        while (!g_Queue.empty()) {
+            pump(std::numeric_limits<uint64_t>::max());
+            Transfer::flush();
+            Vulkan::check(vkQueueWaitIdle(g_TransferQueue));
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        uint64_t rss_growth = peak_rss() - std::min(rss_before, peak_rss());
+        double mib = static_cast<double>(package->view.bytes.size()) / (1024.0 * 1024.0);
+        DS_LOG_INFO(Assets, "\t{} {:10.3f} ms {:8.1f} MiB/s, peak RSS +{:.1f} MiB", mapped ? "mmap" : "read", ms,
+            mib / (ms / 1000.0), static_cast<double>(rss_growth) / (1024.0 * 1024.0));
+
+        Vulkan::check(vkDeviceWaitIdle(g_Device));
+        for (Asset *asset : g_Assets) destroy(asset);
+        g_Assets.clear();
+        close(package);
+    }
+}
+} // namespace DS::Assets
@@ -0,0 +1,263 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <print>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "deletion_queue.hpp"
+#include "global.hpp"
+#include "log.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Bindless {
+// One large update-after-bind descriptor set per resource type, bound once per command buffer
+// with g_PipelineLayout. Resources are registered into a slot and shaders index the arrays with
+// the integer handle (usually passed in push constants or a storage buffer), so draws never bind
+// descriptor sets. Released slots go back on the free list only after every frame that could
+// still read them has retired.
+//
+//   set 0: sampled images   layout(set = 0, binding = 0) uniform texture2D textures[];
+//   set 1: storage buffers  layout(set = 1, binding = 0) buffer Buffers { ... } buffers[];
+//   set 2: samplers         layout(set = 2, binding = 0) uniform sampler samplers[];
+enum class Kind : uint32_t {
+    SampledImage,
+    StorageBuffer,
+    Sampler,
+};
+
+constexpr uint32_t kind_count = 3;
+constexpr uint32_t invalid_index = std::numeric_limits<uint32_t>::max();
+constexpr auto kind_names = std::to_array<const char *>({"Sampled images", "Storage buffers", "Samplers"});
+constexpr auto descriptor_types = std::to_array<VkDescriptorType>(
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLER});
+
+// Stable integer handle, the index into the kind's descriptor array
+template <Kind K>
+struct Handle {
+    uint32_t index = invalid_index;
+
+    bool valid() const {
+        return index != invalid_index;
+    }
+};
+using ImageHandle = Handle<Kind::SampledImage>;
+using BufferHandle = Handle<Kind::StorageBuffer>;
+using SamplerHandle = Handle<Kind::Sampler>;
+
+struct Table {
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    uint32_t capacity = 0;
+    uint32_t next_unused = 0; // Slots below this have been handed out at least once
+    std::vector<uint32_t> free_list;
+    uint32_t live = 0;
+};
+
+bool g_Enabled = false;
+VkDescriptorPool g_Pool = VK_NULL_HANDLE;
+VkPipelineLayout g_PipelineLayout = VK_NULL_HANDLE;
+std::array<Table, kind_count> g_Tables;
+
+Table &table(Kind kind) {
+    return g_Tables[Util::enum_to_number(kind)];
+}
+
+// The descriptor indexing features enable_features() turns on
+bool supported(const VkPhysicalDeviceVulkan12Features &features) {
+    return features.descriptorIndexing &&
+           features.runtimeDescriptorArray &&
+           features.descriptorBindingPartiallyBound &&
+           features.descriptorBindingUpdateUnusedWhilePending &&
+           features.descriptorBindingSampledImageUpdateAfterBind &&
+           features.descriptorBindingStorageBufferUpdateAfterBind &&
+           features.shaderSampledImageArrayNonUniformIndexing &&
+           features.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+void enable_features(VkPhysicalDeviceVulkan12Features &features) {
+    features.descriptorIndexing = VK_TRUE;
+    features.runtimeDescriptorArray = VK_TRUE;
+    features.descriptorBindingPartiallyBound = VK_TRUE;
+    features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+}
+
+void setup() {
+    if (!g_Enabled) {
+        DS_LOG_WARNING(Vulkan, "Descriptor indexing not supported, bindless resources disabled");
+        return;
+    }
+
+    VkPhysicalDeviceVulkan12Properties properties12 = {};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(g_PhysicalDevice, &properties);
+    table(Kind::SampledImage).capacity = std::min(Constants::bindless_image_capacity, properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+    table(Kind::StorageBuffer).capacity = std::min(Constants::bindless_buffer_capacity, properties12.maxDescriptorSetUpdateAfterBindStorageBuffers);
+    table(Kind::Sampler).capacity = std::min(Constants::bindless_sampler_capacity, properties12.maxDescriptorSetUpdateAfterBindSamplers);
+
+    {
+        std::array<VkDescriptorPoolSize, kind_count> pool_sizes;
+        for (uint32_t i = 0; i < kind_count; ++i) pool_sizes[i] = {descriptor_types[i], g_Tables[i].capacity};
+        VkDescriptorPoolCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        info.maxSets = kind_count;
+        info.poolSizeCount = kind_count;
+        info.pPoolSizes = pool_sizes.data();
+        Vulkan::check(vkCreateDescriptorPool(g_Device, &info, g_Allocator, &g_Pool));
+    }
+
+    for (uint32_t i = 0; i < kind_count; ++i) {
+        Table &t = g_Tables[i];
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = 0;
+        binding.descriptorType = descriptor_types[i];
+        binding.descriptorCount = t.capacity;
+        binding.stageFlags = VK_SHADER_STAGE_ALL;
+        VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                                 VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                                 VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {};
+        flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        flags_info.bindingCount = 1;
+        flags_info.pBindingFlags = &binding_flags;
+        VkDescriptorSetLayoutCreateInfo layout_info = {};
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.pNext = &flags_info;
+        layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layout_info.bindingCount = 1;
+        layout_info.pBindings = &binding;
+        Vulkan::check(vkCreateDescriptorSetLayout(g_Device, &layout_info, g_Allocator, &t.layout));
+
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = g_Pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &t.layout;
+        Vulkan::check(vkAllocateDescriptorSets(g_Device, &alloc_info, &t.set));
+    }
+
+    {
+        std::array<VkDescriptorSetLayout, kind_count> layouts;
+        for (uint32_t i = 0; i < kind_count; ++i) layouts[i] = g_Tables[i].layout;
+        VkPushConstantRange push_constants = {};
+        push_constants.stageFlags = VK_SHADER_STAGE_ALL;
+        push_constants.offset = 0;
+        push_constants.size = Constants::bindless_push_constant_size;
+        VkPipelineLayoutCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        info.setLayoutCount = kind_count;
+        info.pSetLayouts = layouts.data();
+        info.pushConstantRangeCount = 1;
+        info.pPushConstantRanges = &push_constants;
+        Vulkan::check(vkCreatePipelineLayout(g_Device, &info, g_Allocator, &g_PipelineLayout));
+    }
+
+    for (uint32_t i = 0; i < kind_count; ++i) {
+        DS_LOG_INFO(Vulkan, "Bindless {}: {} slots", kind_names[i], g_Tables[i].capacity);
+    }
+}
+
+// Only valid once the device is idle and the deletion queue has been flushed
+void cleanup() {
+    if (!g_Enabled) return;
+    vkDestroyPipelineLayout(g_Device, g_PipelineLayout, g_Allocator);
+    for (Table &t : g_Tables) {
+        vkDestroyDescriptorSetLayout(g_Device, t.layout, g_Allocator);
+        t = Table();
+    }
+    vkDestroyDescriptorPool(g_Device, g_Pool, g_Allocator); // Frees the sets
+    g_PipelineLayout = VK_NULL_HANDLE;
+    g_Pool = VK_NULL_HANDLE;
+}
+
+uint32_t allocate_slot(Kind kind) {
+    Table &t = table(kind);
+    uint32_t index;
+    if (!t.free_list.empty()) {
+        index = t.free_list.back();
+        t.free_list.pop_back();
+    } else if (t.next_unused < t.capacity) {
+        index = t.next_unused++;
+    } else {
+        DS_LOG_ERROR(Vulkan, "Bindless {} exhausted ({} slots)", kind_names[Util::enum_to_number(kind)], t.capacity);
+        return invalid_index;
+    }
+    ++t.live;
+    return index;
+}
+
+void write(Kind kind, uint32_t index, const VkDescriptorImageInfo *image, const VkDescriptorBufferInfo *buffer) {
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = table(kind).set;
+    write.dstBinding = 0;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = descriptor_types[Util::enum_to_number(kind)];
+    write.pImageInfo = image;
+    write.pBufferInfo = buffer;
+    vkUpdateDescriptorSets(g_Device, 1, &write, 0, nullptr);
+}
+
+ImageHandle register_image(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+    if (!g_Enabled) return {};
+    uint32_t index = allocate_slot(Kind::SampledImage);
+    if (index == invalid_index) return {};
+    VkDescriptorImageInfo info = {VK_NULL_HANDLE, view, layout};
+    write(Kind::SampledImage, index, &info, nullptr);
+    return {index};
+}
+
+BufferHandle register_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) {
+    if (!g_Enabled) return {};
+    uint32_t index = allocate_slot(Kind::StorageBuffer);
+    if (index == invalid_index) return {};
+    VkDescriptorBufferInfo info = {buffer, offset, range};
+    write(Kind::StorageBuffer, index, nullptr, &info);
+    return {index};
+}
+
+SamplerHandle register_sampler(VkSampler sampler) {
+    if (!g_Enabled) return {};
+    uint32_t index = allocate_slot(Kind::Sampler);
+    if (index == invalid_index) return {};
+    VkDescriptorImageInfo info = {sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED};
+    write(Kind::Sampler, index, &info, nullptr);
+    return {index};
+}
+
+// The slot is recycled once the frames that may still index it have retired. The descriptor is
+// left as is until then; partially bound arrays only require that shaders don't read it.
+template <Kind K>
+void release(Handle<K> handle) {
+    if (!handle.valid()) return;
+    DeletionQueue::push([index = handle.index] {
+        Table &t = table(K);
+        t.free_list.push_back(index);
+        --t.live;
+    });
+}
+
+// Binds all three sets, once per command buffer and bind point
+void bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point) {
+    if (!g_Enabled) return;
+    std::array<VkDescriptorSet, kind_count> sets;
+    for (uint32_t i = 0; i < kind_count; ++i) sets[i] = g_Tables[i].set;
+    vkCmdBindDescriptorSets(cmd, bind_point, g_PipelineLayout, 0, kind_count, sets.data(), 0, nullptr);
+}
+} // namespace DS::Bindless
@@ -0,0 +1,443 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <print>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <imgui.h>
+
+#include <SDL3/SDL.h>
+
+#include "global.hpp"
+#include "log.hpp"
+#include "meshes.hpp"
+#include "profiler.hpp"
+#include "shader.hpp"
+#include "sprites.hpp"
+#include "util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Capture {
+// Deterministic frame capture for before/after timing. --capture streams every frame's inputs to a
+// file: the animation time, the clear color, the SDL events polled that frame and the complete dear
+// imgui draw data. --replay feeds the frames back through FrameRender headless and as fast as
+// possible, without polling events or running the GUI, so two builds render the same workload.
+// Little endian, records packed back to back:
+//
+//   Header | per frame: FrameHeader, Event[event_count], then per draw list
+//            ListHeader, ImDrawVert[vertex_count], ImDrawIdx[index_count], Command[command_count]
+//
+// Texture references are handles of the capturing process and can't be replayed as they are, every
+// command samples the font atlas on replay instead, which keeps the draw calls and fragment count.
+static_assert(std::endian::native == std::endian::little, "Captures are stored little endian");
+
+constexpr uint32_t magic = 0x50435344;       // "DSCP"
+constexpr uint32_t version = 1;
+constexpr uint32_t frame_magic = 0x4D524644; // "DFRM", catches a misparsed record early
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_size; // sizeof(ImDrawVert) and sizeof(ImDrawIdx) of the capturing build
+    uint32_t index_size;
+    int32_t width; // Render target at the start, a replay renders at this size
+    int32_t height;
+    uint32_t mesh_count; // --meshes and --sprites of the capture, the replay uses the same scene
+    uint32_t sprite_count;
+};
+static_assert(sizeof(Header) == 32);
+
+struct FrameHeader {
+    uint32_t magic;
+    uint32_t event_count;
+    uint32_t list_count;
+    uint32_t reserved;
+    double time; // Drives Meshes::animate and Sprites::demo
+    float clear_color[4];
+    float display_pos[2];
+    float display_size[2];
+    float framebuffer_scale[2];
+};
+static_assert(sizeof(FrameHeader) == 64);
+
+// The SDL events polled during the frame, recorded for reference. A replay doesn't re-inject them,
+// the draw data they produced is replayed directly.
+struct Event {
+    uint64_t timestamp;
+    uint32_t type;
+    uint32_t code; // Key code, mouse button or window id
+    float x;       // Mouse position, wheel delta or window data
+    float y;
+};
+static_assert(sizeof(Event) == 24);
+
+struct ListHeader {
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t command_count;
+    uint32_t reserved;
+};
+static_assert(sizeof(ListHeader) == 16);
+
+enum class Texture : uint32_t {
+    Managed,          // An ImTextureData owned by dear imgui, i.e. the font atlas
+    User,             // A raw ImTextureID
+    ResetRenderState, // ImDrawCallback_ResetRenderState, other callbacks aren't captured
+};
+
+struct Command {
+    float clip_rect[4];
+    uint32_t vertex_offset;
+    uint32_t index_offset;
+    uint32_t element_count;
+    Texture texture;
+    uint64_t texture_id; // As captured (not yet assigned on the atlas' first frame), informational only
+};
+static_assert(sizeof(Command) == 40);
+
+using Clock = std::chrono::steady_clock;
+
+std::string g_CapturePath; // --capture
+std::string g_ReplayPath;  // --replay
+bool g_Capturing = false;
+bool g_Replaying = false;
+
+// Capture
+std::ofstream g_File;
+std::vector<Event> g_Events;
+std::vector<Command> g_Commands;
+uint64_t g_FrameCount = 0;
+uint64_t g_BytesWritten = 0;
+double g_Time = 0.0;
+
+// Replay
+std::vector<char> g_Data;
+std::vector<size_t> g_FrameOffsets;
+size_t g_NextFrame = 0;
+FrameHeader g_Frame = {};
+std::vector<std::unique_ptr<ImDrawList>> g_Lists;
+ImDrawData g_DrawData;
+uint64_t g_Hash = 0;
+Clock::time_point g_FrameStart;
+std::vector<double> g_FrameMs;
+bool g_SizeWarned = false;
+
+void write(const void *data, size_t size) {
+    g_File.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    g_BytesWritten += size;
+}
+
+// After Engine::setup, so the header has the render target size
+void start_capture() {
+    g_File.open(g_CapturePath, std::ios::binary | std::ios::trunc);
+    if (!g_File) {
+        DS_LOG_ERROR(Replay, "Can't open '{}' for writing", g_CapturePath);
+        exit(-1);
+    }
+    Header header = {
+        .magic = magic,
+        .version = version,
+        .vertex_size = sizeof(ImDrawVert),
+        .index_size = sizeof(ImDrawIdx),
+        .width = g_WD->Width,
+        .height = g_WD->Height,
+        .mesh_count = Meshes::g_DemoCount,
+        .sprite_count = Sprites::g_DemoCount};
+    write(&header, sizeof(header));
+    g_Capturing = true;
+    DS_LOG_INFO(Replay, "Capturing frames to '{}'", g_CapturePath);
+}
+
+void record_event(const SDL_Event &event) {
+    if (!g_Capturing) return;
+    Event out = {.timestamp = event.common.timestamp, .type = event.type, .code = 0, .x = 0.0f, .y = 0.0f};
+    switch (event.type) {
+    case SDL_EVENT_KEY_DOWN:
+    case SDL_EVENT_KEY_UP:
+        out.code = event.key.key;
+        break;
+    case SDL_EVENT_MOUSE_MOTION:
+        out.x = event.motion.x;
+        out.y = event.motion.y;
+        break;
+    case SDL_EVENT_MOUSE_BUTTON_DOWN:
+    case SDL_EVENT_MOUSE_BUTTON_UP:
+        out.code = event.button.button;
+        out.x = event.button.x;
+        out.y = event.button.y;
+        break;
+    case SDL_EVENT_MOUSE_WHEEL:
+        out.x = event.wheel.x;
+        out.y = event.wheel.y;
+        break;
+    default:
+        if (event.type >= SDL_EVENT_WINDOW_FIRST && event.type <= SDL_EVENT_WINDOW_LAST) {
+            out.code = event.window.windowID;
+            out.x = static_cast<float>(event.window.data1);
+            out.y = static_cast<float>(event.window.data2);
+        }
+        break;
+    }
+    g_Events.push_back(out);
+}
+
+// The time the frame animates with: the live time while capturing (and recorded), the captured one on replay
+double frame_time(double live) {
+    if (g_Replaying) return g_Frame.time;
+    g_Time = live;
+    return live;
+}
+
+// After ImGui::Render, with the draw data FrameRender is about to get
+void write_frame(const ImDrawData *draw_data) {
+    if (!g_Capturing) return;
+    DS_PROFILE_SCOPE("Capture::write_frame");
+    FrameHeader frame = {
+        .magic = frame_magic,
+        .event_count = static_cast<uint32_t>(g_Events.size()),
+        .list_count = static_cast<uint32_t>(draw_data->CmdListsCount),
+        .reserved = 0,
+        .time = g_Time,
+        .clear_color = {g_ClearColor.x, g_ClearColor.y, g_ClearColor.z, g_ClearColor.w},
+        .display_pos = {draw_data->DisplayPos.x, draw_data->DisplayPos.y},
+        .display_size = {draw_data->DisplaySize.x, draw_data->DisplaySize.y},
+        .framebuffer_scale = {draw_data->FramebufferScale.x, draw_data->FramebufferScale.y}};
+    write(&frame, sizeof(frame));
+    write(g_Events.data(), g_Events.size() * sizeof(Event));
+    g_Events.clear();
+
+    for (const ImDrawList *list : draw_data->CmdLists) {
+        g_Commands.clear();
+        for (const ImDrawCmd &cmd : list->CmdBuffer) {
+            Texture texture = cmd.TexRef._TexData ? Texture::Managed : Texture::User;
+            if (cmd.UserCallback == ImDrawCallback_ResetRenderState) {
+                texture = Texture::ResetRenderState;
+            } else if (cmd.UserCallback) {
+                continue;
+            }
+            g_Commands.push_back({
+                .clip_rect = {cmd.ClipRect.x, cmd.ClipRect.y, cmd.ClipRect.z, cmd.ClipRect.w},
+                .vertex_offset = cmd.VtxOffset,
+                .index_offset = cmd.IdxOffset,
+                .element_count = cmd.ElemCount,
+                .texture = texture,
+                .texture_id = static_cast<uint64_t>(cmd.TexRef._TexData ? cmd.TexRef._TexData->TexID : cmd.TexRef._TexID)});
+        }
+        ListHeader header = {
+            .vertex_count = static_cast<uint32_t>(list->VtxBuffer.Size),
+            .index_count = static_cast<uint32_t>(list->IdxBuffer.Size),
+            .command_count = static_cast<uint32_t>(g_Commands.size()),
+            .reserved = 0};
+        write(&header, sizeof(header));
+        write(list->VtxBuffer.Data, list->VtxBuffer.size_in_bytes());
+        write(list->IdxBuffer.Data, list->IdxBuffer.size_in_bytes());
+        write(g_Commands.data(), g_Commands.size() * sizeof(Command));
+    }
+    ++g_FrameCount;
+}
+
+// Size of the frame record at `offset`, 0 if it is truncated or malformed (including draw commands
+// that index past their list's vertices or indices)
+size_t frame_size(std::span<const char> data, size_t offset) {
+    auto fits = [&](size_t size) { return size <= data.size() - offset; };
+    size_t start = offset;
+    FrameHeader frame;
+    if (!fits(sizeof(frame))) return 0;
+    std::memcpy(&frame, data.data() + offset, sizeof(frame));
+    if (frame.magic != frame_magic) return 0;
+    offset += sizeof(frame);
+    if (!fits(uint64_t{frame.event_count} * sizeof(Event))) return 0;
+    offset += frame.event_count * sizeof(Event);
+    for (uint32_t i = 0; i < frame.list_count; ++i) {
+        ListHeader list;
+        if (!fits(sizeof(list))) return 0;
+        std::memcpy(&list, data.data() + offset, sizeof(list));
+        offset += sizeof(list);
+        uint64_t size = uint64_t{list.vertex_count} * sizeof(ImDrawVert) + uint64_t{list.index_count} * sizeof(ImDrawIdx) +
+                        uint64_t{list.command_count} * sizeof(Command);
+        if (!fits(size)) return 0;
+        // Commands must stay inside their list, a replay hands them to the backend unchecked
+        const char *commands = data.data() + offset + size - uint64_t{list.command_count} * sizeof(Command);
+        for (uint32_t c = 0; c < list.command_count; ++c) {
+            Command command;
+            std::memcpy(&command, commands + c * sizeof(Command), sizeof(command));
+            if (uint64_t{command.index_offset} + command.element_count > list.index_count) return 0;
+            if (command.element_count > 0 && command.vertex_offset >= list.vertex_count) return 0;
+        }
+        offset += size;
+    }
+    return offset - start;
+}
+
+// Before Engine::setup: loads the whole capture so no file reads end up in the timing, and switches
+// to a headless run at the captured size with the captured scene
+void open_replay() {
+    std::ifstream file(g_ReplayPath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        DS_LOG_ERROR(Replay, "Can't open '{}'", g_ReplayPath);
+        exit(-1);
+    }
+    g_Data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(g_Data.data(), static_cast<std::streamsize>(g_Data.size()));
+
+    Header header;
+    if (g_Data.size() < sizeof(header)) {
+        DS_LOG_ERROR(Replay, "'{}' is not a capture", g_ReplayPath);
+        exit(-1);
+    }
+    std::memcpy(&header, g_Data.data(), sizeof(header));
+    if (header.magic != magic || header.version != version) {
+        DS_LOG_ERROR(Replay, "'{}' is not a version {} capture", g_ReplayPath, version);
+        exit(-1);
+    }
+    if (header.width <= 0 || header.height <= 0) {
+        DS_LOG_ERROR(Replay, "'{}' has an invalid render target size {}x{}", g_ReplayPath, header.width, header.height);
+        exit(-1);
+    }
+    if (header.vertex_size != sizeof(ImDrawVert) || header.index_size != sizeof(ImDrawIdx)) {
+        DS_LOG_ERROR(Replay, "'{}' was captured with {} byte vertices and {} byte indices, this build uses {} and {}",
+            g_ReplayPath, header.vertex_size, header.index_size, sizeof(ImDrawVert), sizeof(ImDrawIdx));
+        exit(-1);
+    }
+
+    size_t offset = sizeof(header);
+    while (offset < g_Data.size()) {
+        size_t size = frame_size(g_Data, offset);
+        if (size == 0) { // A capture that was cut short keeps its complete frames
+            DS_LOG_WARNING(Replay, "Ignoring {} trailing bytes of a truncated frame", g_Data.size() - offset);
+            break;
+        }
+        g_FrameOffsets.push_back(offset);
+        offset += size;
+    }
+    if (g_FrameOffsets.empty()) {
+        DS_LOG_ERROR(Replay, "'{}' contains no frames", g_ReplayPath);
+        exit(-1);
+    }
+    g_Hash = Shader::hash(g_Data.data(), offset);
+
+    g_Headless = true;
+    g_HeadlessWidth = header.width;
+    g_HeadlessHeight = header.height;
+    Meshes::g_DemoCount = header.mesh_count;
+    Sprites::g_DemoCount = header.sprite_count;
+    g_FrameMs.reserve(g_FrameOffsets.size());
+    g_Replaying = true;
+    DS_LOG_INFO(Replay, "Loaded {} frames ({:.1f} MiB) from '{}', {}x{}, {} meshes, {} sprites, workload hash {:016x}",
+        g_FrameOffsets.size(), static_cast<double>(offset) / (1 << 20), g_ReplayPath, header.width, header.height,
+        header.mesh_count, header.sprite_count, g_Hash);
+}
+
+void end_frame_timing() {
+    if (g_FrameMs.size() < g_NextFrame) {
+        g_FrameMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - g_FrameStart).count());
+    }
+}
+
+// Start of every replayed frame, loads the frame's draw lists and clear color. False once all are done.
+bool next_frame() {
+    end_frame_timing();
+    if (g_NextFrame == g_FrameOffsets.size()) return false;
+    g_FrameStart = Clock::now();
+
+    const char *cursor = g_Data.data() + g_FrameOffsets[g_NextFrame++];
+    auto take = [&cursor](void *out, size_t size) {
+        std::memcpy(out, cursor, size);
+        cursor += size;
+    };
+    take(&g_Frame, sizeof(g_Frame));
+    cursor += g_Frame.event_count * sizeof(Event);
+    g_ClearColor = {g_Frame.clear_color[0], g_Frame.clear_color[1], g_Frame.clear_color[2], g_Frame.clear_color[3]};
+
+    while (g_Lists.size() < g_Frame.list_count) {
+        g_Lists.push_back(std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData()));
+    }
+    for (uint32_t i = 0; i < g_Frame.list_count; ++i) {
+        ImDrawList &list = *g_Lists[i];
+        ListHeader header;
+        take(&header, sizeof(header));
+        list.VtxBuffer.resize(static_cast<int>(header.vertex_count));
+        take(list.VtxBuffer.Data, list.VtxBuffer.size_in_bytes());
+        list.IdxBuffer.resize(static_cast<int>(header.index_count));
+        take(list.IdxBuffer.Data, list.IdxBuffer.size_in_bytes());
+        list.CmdBuffer.resize(static_cast<int>(header.command_count));
+        for (ImDrawCmd &cmd : list.CmdBuffer) {
+            Command command;
+            take(&command, sizeof(command));
+            cmd = ImDrawCmd();
+            cmd.ClipRect = ImVec4(command.clip_rect[0], command.clip_rect[1], command.clip_rect[2], command.clip_rect[3]);
+            cmd.TexRef = g_IO->Fonts->TexRef;
+            cmd.VtxOffset = command.vertex_offset;
+            cmd.IdxOffset = command.index_offset;
+            cmd.ElemCount = command.element_count;
+            if (command.texture == Texture::ResetRenderState) cmd.UserCallback = ImDrawCallback_ResetRenderState;
+        }
+    }
+
+    if (!g_SizeWarned && (g_Frame.display_size[0] != static_cast<float>(g_WD->Width) ||
+                             g_Frame.display_size[1] != static_cast<float>(g_WD->Height))) {
+        DS_LOG_WARNING(Replay, "Frame {} was captured at {}x{}, replaying at {}x{}", g_NextFrame - 1,
+            g_Frame.display_size[0], g_Frame.display_size[1], g_WD->Width, g_WD->Height);
+        g_SizeWarned = true;
+    }
+    return true;
+}
+
+// Replaces the live draw data. Texture uploads (the font atlas) still come from `live`, the result of
+// an empty ImGui frame.
+ImDrawData *replay_draw_data(const ImDrawData *live) {
+    g_DrawData.Clear();
+    g_DrawData.Valid = true;
+    g_DrawData.DisplayPos = ImVec2(g_Frame.display_pos[0], g_Frame.display_pos[1]);
+    g_DrawData.DisplaySize = ImVec2(g_Frame.display_size[0], g_Frame.display_size[1]);
+    g_DrawData.FramebufferScale = ImVec2(g_Frame.framebuffer_scale[0], g_Frame.framebuffer_scale[1]);
+    g_DrawData.OwnerViewport = live->OwnerViewport;
+    g_DrawData.Textures = live->Textures;
+    for (uint32_t i = 0; i < g_Frame.list_count; ++i) g_DrawData.AddDrawList(g_Lists[i].get());
+    return &g_DrawData;
+}
+
+void report() {
+    end_frame_timing();
+    if (g_FrameMs.empty()) return;
+    std::vector<double> sorted = g_FrameMs;
+    std::sort(sorted.begin(), sorted.end());
+    double total_ms = 0.0;
+    for (double ms : sorted) total_ms += ms;
+    auto percentile = [&sorted](double p) {
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())))];
+    };
+    DS_LOG_INFO(Replay, "Replayed {} of {} frames in {:.3f} s, {:.1f} frames/s, workload hash {:016x}",
+        sorted.size(), g_FrameOffsets.size(), total_ms / 1000.0, 1000.0 * static_cast<double>(sorted.size()) / total_ms, g_Hash);
+    DS_LOG_INFO(Replay, "Frame time avg {:.3f} ms, p50 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms",
+        total_ms / static_cast<double>(sorted.size()), percentile(0.50), percentile(0.99), sorted.back());
+}
+
+// Before Engine::cleanup, while the ImGui context still exists
+void cleanup() {
+    if (g_Capturing) {
+        g_File.close();
+        DS_LOG_INFO(Replay, "Captured {} frames ({:.1f} MiB) to '{}'", g_FrameCount,
+            static_cast<double>(g_BytesWritten) / (1 << 20), g_CapturePath);
+        g_Capturing = false;
+    }
+    if (g_Replaying) {
+        report();
+        g_DrawData.Clear();
+        g_Lists.clear();
+        g_Data = {};
+        g_Replaying = false;
+    }
+}
+} // namespace DS::Capture
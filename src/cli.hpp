@@ -0,0 +1,179 @@
+#pragma once
+#include <charconv>
+#include <cstdlib>
+#include <format>
+#include <optional>
+#include <print>
+#include <string_view>
+
+#include "assets.hpp"
+#include "capture.hpp"
+#include "device_select.hpp"
+#include "global.hpp"
+#include "host_allocator.hpp"
+#include "jobs.hpp"
+#include "log.hpp"
+#include "meshes.hpp"
+#include "pacing.hpp"
+#include "present.hpp"
+#include "recording.hpp"
+#include "shader_registry.hpp"
+#include "sprites.hpp"
+#include "util.hpp"
+#include "validation.hpp"
+
+using std::println, std::print;
+
+namespace DS::CLI {
+void print_usage(const char *program) {
+    println("Usage: {} [options]", program);
+    println("  --headless        Render into offscreen images, no window or swapchain");
+    println("  --frames <n>      Exit after rendering n frames (0 = unlimited)");
+    println("  --frames-in-flight <n>  How many frames the CPU may run ahead of the GPU (1-{}, default {})",
+        Constants::max_frames_in_flight, Constants::default_frames_in_flight);
+    println("  --present-mode <fifo|fifo_relaxed|mailbox|immediate>  Request a specific present mode");
+    println("  --latency <vsync|low|uncapped>  Pick the present mode from a latency preference list");
+    println("  --gpu <index|#index|name|uuid>  Use this physical device instead of the best ranked one (or set DS_GPU)");
+    println("  --dynamic-rendering  Use Vulkan 1.3 dynamic rendering instead of render passes and framebuffers");
+    println("  --host-allocator <default|tracking|pooled>  Host allocator behind g_Allocator (default tracking)");
+    println("  --on-demand       Only redraw on input, a 1 s timer or running UI animations");
+    println("  --fps <n>         Cap the frame rate with a sleep + spin limiter (1-{}, default off)", Constants::max_target_fps);
+    println("  --threads <n>     Job system threads including the main thread (1-{}, default one per core)", Constants::max_job_threads);
+    println("  --bench-record    Measure recording throughput from 1 to --threads threads and exit");
+    println("  --meshes <n>      Draw n meshes, culled and drawn on the GPU");
+    println("  --sprites <n>     Draw n animated sprites every frame");
+    println("  --bench-sprites   Measure sprite submit and sort/write throughput and exit");
+    println("  --bench-jobs      Measure job spawn, steal and wait latency and exit");
+    println("  --load <file>     Stream every asset of a package built by asset_packer");
+    println("  --bench-assets <file>  Compare mmap streaming against reading the whole package, and exit");
+    println("  --hot-reload      Recompile edited shaders in shaders/ and swap the affected pipelines while running");
+    println("  --capture <file>  Record every frame's draw data, input events and clear color to a file");
+    println("  --replay <file>   Render a capture headless and as fast as possible, print frame time statistics and exit");
+    println("  --validation <off|errors|full|sync|gpu>  Validation tier (or set DS_VALIDATION, default {})",
+        Validation::tier_name(Validation::default_tier));
+    println("  --help            Show this help");
+}
+
+bool parse_uint(std::string_view text, uint32_t &out) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+void parse(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            exit(0);
+        } else if (arg == "--headless") {
+            g_Headless = true;
+        } else if (arg == "--frames") {
+            if (i + 1 >= argc || !parse_uint(argv[i + 1], g_FrameLimit)) {
+                DS_LOG_ERROR(CLI, "--frames expects a non-negative integer");
+                exit(-1);
+            }
+            ++i;
+        } else if (arg == "--frames-in-flight") {
+            if (i + 1 >= argc || !parse_uint(argv[i + 1], g_FramesInFlight) ||
+                g_FramesInFlight < 1 || g_FramesInFlight > Constants::max_frames_in_flight) {
+                DS_LOG_ERROR(CLI, "--frames-in-flight expects a value in 1-{}", Constants::max_frames_in_flight);
+                exit(-1);
+            }
+            ++i;
+        } else if (arg == "--present-mode") {
+            std::optional<VkPresentModeKHR> mode;
+            if (i + 1 >= argc || !(mode = Present::parse_mode(argv[i + 1]))) {
+                DS_LOG_ERROR(CLI, "--present-mode expects one of fifo, fifo_relaxed, mailbox, immediate");
+                exit(-1);
+            }
+            Present::g_ExplicitMode = mode;
+            ++i;
+        } else if (arg == "--latency") {
+            std::optional<Present::LatencyMode> mode;
+            if (i + 1 >= argc || !(mode = Present::parse_latency_mode(argv[i + 1]))) {
+                DS_LOG_ERROR(CLI, "--latency expects one of vsync, low, uncapped");
+                exit(-1);
+            }
+            Present::g_LatencyMode = *mode;
+            ++i;
+        } else if (arg == "--gpu") {
+            if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                DS_LOG_ERROR(CLI, "--gpu expects a device index, name or UUID");
+                exit(-1);
+            }
+            DeviceSelect::g_Override = argv[i + 1];
+            ++i;
+        } else if (arg == "--dynamic-rendering") {
+            g_DynamicRendering = true;
+        } else if (arg == "--host-allocator") {
+            std::optional<HostAllocator::Mode> mode;
+            if (i + 1 >= argc || !(mode = HostAllocator::parse_mode(argv[i + 1]))) {
+                DS_LOG_ERROR(CLI, "--host-allocator expects one of default, tracking, pooled");
+                exit(-1);
+            }
+            HostAllocator::g_Mode = *mode;
+            ++i;
+        } else if (arg == "--on-demand") {
+            Pacing::g_OnDemand = true;
+        } else if (arg == "--fps") {
+            if (i + 1 >= argc || !parse_uint(argv[i + 1], Pacing::g_TargetFps) ||
+                Pacing::g_TargetFps < 1 || Pacing::g_TargetFps > Constants::max_target_fps) {
+                DS_LOG_ERROR(CLI, "--fps expects a value in 1-{}", Constants::max_target_fps);
+                exit(-1);
+            }
+            ++i;
+        } else if (arg == "--threads") {
+            if (i + 1 >= argc || !parse_uint(argv[i + 1], Jobs::g_ThreadCount) ||
+                Jobs::g_ThreadCount < 1 || Jobs::g_ThreadCount > Constants::max_job_threads) {
+                DS_LOG_ERROR(CLI, "--threads expects a value in 1-{}", Constants::max_job_threads);
+                exit(-1);
+            }
+            ++i;
+        } else if (arg == "--bench-record") {
+            Recording::g_Benchmark = true;
+        } else if (arg == "--meshes") {
+            if (i + 1 >= argc || !parse_uint(argv[i + 1], Meshes::g_DemoCount) || Meshes::g_DemoCount > Constants::mesh_max_objects) {
+                DS_LOG_ERROR(CLI, "--meshes expects a value in 0-{}", Constants::mesh_max_objects);
+                exit(-1);
+            }
+            ++i;
+        } else if (arg == "--sprites") {
+            if (i + 1 >= argc || !parse_uint(argv[i + 1], Sprites::g_DemoCount)) {
+                DS_LOG_ERROR(CLI, "--sprites expects a non-negative integer");
+                exit(-1);
+            }
+            ++i;
+        } else if (arg == "--bench-sprites") {
+            Sprites::g_Benchmark = true;
+        } else if (arg == "--bench-jobs") {
+            Jobs::g_Benchmark = true;
+        } else if (arg == "--load" || arg == "--bench-assets") {
+            if (i + 1 >= argc) {
+                DS_LOG_ERROR(CLI, "{} expects a package path", arg);
+                exit(-1);
+            }
+            (arg == "--load" ? Assets::g_LoadPath : Assets::g_BenchPath) = argv[i + 1];
+            ++i;
+        } else if (arg == "--capture" || arg == "--replay") {
+            if (i + 1 >= argc) {
+                DS_LOG_ERROR(CLI, "{} expects a file path", arg);
+                exit(-1);
+            }
+            (arg == "--capture" ? Capture::g_CapturePath : Capture::g_ReplayPath) = argv[i + 1];
+            ++i;
+        } else if (arg == "--validation") {
+            std::optional<Validation::Tier> tier;
+            if (i + 1 >= argc || !(tier = Validation::parse_tier(argv[i + 1]))) {
+                DS_LOG_ERROR(CLI, "--validation expects one of off, errors, full, sync, gpu");
+                exit(-1);
+            }
+            Validation::g_Requested = tier;
+            ++i;
+        } else if (arg == "--hot-reload") {
+            ShaderRegistry::g_HotReload = true;
+        } else {
+            DS_LOG_WARNING(CLI, "Ignoring unknown argument '{}'", arg);
+        }
+    }
+}
+} // namespace DS::CLI
@@ -0,0 +1,222 @@
+#pragma once
+#include <cstdint>
+#include <format>
+#include <print>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "global.hpp"
+#include "memory.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Compute {
+// Async compute: work recorded between begin() and submit() runs on g_ComputeQueue. The frame's
+// graphics submit waits for it on the compute timeline, so compute for frame N can overlap the
+// raster work of frame N-1. Compute can in turn wait for a graphics frame (e.g. before overwriting
+// a buffer that frame reads) on the graphics timeline, which FrameRender signals with g_FrameNumber.
+// With a single queue (lavapipe, or no timeline semaphores) the same calls submit to g_Queue and
+// are ordered by submission order and pipeline barriers instead.
+struct Slot {
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    bool recording = false;
+};
+
+std::vector<Slot> g_Slots; // One per frame in flight, indexed by g_FrameSlot
+VkSemaphore g_ComputeTimeline = VK_NULL_HANDLE;
+VkSemaphore g_GraphicsTimeline = VK_NULL_HANDLE;
+uint64_t g_ComputeValue = 0; // Last value submitted on the compute timeline
+
+// Handed over to the next graphics submit
+uint64_t g_PendingValue = 0;
+VkPipelineStageFlags g_PendingStages = 0;
+VkAccessFlags g_PendingAccess = 0;
+std::vector<VkBufferMemoryBarrier> g_Releases; // Recorded at submit into the compute command buffer
+std::vector<VkBufferMemoryBarrier> g_Acquires; // Recorded by acquire_for_graphics
+
+uint32_t g_Submits = 0;
+
+bool async() {
+    return g_ComputeQueue != g_Queue;
+}
+
+VkSemaphore create_timeline() {
+    VkSemaphoreTypeCreateInfo type_info = {};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+    VkSemaphoreCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    info.pNext = &type_info;
+    VkSemaphore semaphore;
+    Vulkan::check(vkCreateSemaphore(g_Device, &info, g_Allocator, &semaphore));
+    return semaphore;
+}
+
+void setup() {
+    g_Slots.resize(g_FramesInFlight);
+    for (Slot &slot : g_Slots) {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = g_ComputeQueueFamily;
+        Vulkan::check(vkCreateCommandPool(g_Device, &pool_info, g_Allocator, &slot.command_pool));
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = slot.command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        Vulkan::check(vkAllocateCommandBuffers(g_Device, &alloc_info, &slot.command_buffer));
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        Vulkan::check(vkCreateFence(g_Device, &fence_info, g_Allocator, &slot.fence));
+    }
+    if (async()) {
+        g_ComputeTimeline = create_timeline();
+        g_GraphicsTimeline = create_timeline();
+    }
+    g_ComputeValue = 0;
+}
+
+// Only valid once the device is idle
+void cleanup() {
+    for (Slot &slot : g_Slots) {
+        vkDestroyFence(g_Device, slot.fence, g_Allocator);
+        vkDestroyCommandPool(g_Device, slot.command_pool, g_Allocator);
+    }
+    g_Slots.clear();
+    if (g_ComputeTimeline != VK_NULL_HANDLE) vkDestroySemaphore(g_Device, g_ComputeTimeline, g_Allocator);
+    if (g_GraphicsTimeline != VK_NULL_HANDLE) vkDestroySemaphore(g_Device, g_GraphicsTimeline, g_Allocator);
+    g_ComputeTimeline = VK_NULL_HANDLE;
+    g_GraphicsTimeline = VK_NULL_HANDLE;
+}
+
+// Command buffer for this frame's compute work, call in FrameRender before the graphics command
+// buffer is recorded (see Meshes::cull_async). Calling it again in the same frame returns the same
+// command buffer.
+VkCommandBuffer begin() {
+    Slot &slot = g_Slots[g_FrameSlot];
+    if (slot.recording) return slot.command_buffer;
+    Vulkan::check(vkWaitForFences(g_Device, 1, &slot.fence, VK_TRUE, Constants::no_timeout));
+    Vulkan::check(vkResetFences(g_Device, 1, &slot.fence));
+    Vulkan::check(vkResetCommandPool(g_Device, slot.command_pool, Constants::no_flags));
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    Vulkan::check(vkBeginCommandBuffer(slot.command_buffer, &info));
+    slot.recording = true;
+
+    if (!async()) {
+        // Same queue: order against earlier frames so compute never overwrites what a previous
+        // frame is still reading and sees what it wrote, the equivalent of the graphics timeline wait
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(slot.command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            Constants::no_flags, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    return slot.command_buffer;
+}
+
+// Makes `buffer`, written by this frame's compute work, visible to graphics at `dst_stage` with
+// `dst_access`. Ownership moves to the graphics family for the frame; compute is expected to
+// overwrite the contents next time, so nothing is transferred back.
+void release_buffer(Memory::Buffer *buffer, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    g_PendingStages |= dst_stage;
+    g_PendingAccess |= dst_access;
+    if (!async()) return;
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = g_ComputeQueueFamily;
+    barrier.dstQueueFamilyIndex = g_QueueFamily;
+    barrier.buffer = buffer->buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    g_Releases.push_back(barrier);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dst_access;
+    g_Acquires.push_back(barrier);
+}
+
+// Submits this frame's compute work. If `after_graphics_frame` is non-zero the work waits until
+// that graphics frame has finished on the GPU. Returns the compute timeline value it signals
+// (0 on the single-queue path).
+uint64_t submit(uint64_t after_graphics_frame = 0) {
+    Slot &slot = g_Slots[g_FrameSlot];
+    if (!slot.recording) return 0;
+    if (!g_Releases.empty()) {
+        vkCmdPipelineBarrier(slot.command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            Constants::no_flags, 0, nullptr, static_cast<uint32_t>(g_Releases.size()), g_Releases.data(), 0, nullptr);
+        g_Releases.clear();
+    }
+    Vulkan::check(vkEndCommandBuffer(slot.command_buffer));
+    slot.recording = false;
+
+    VkSubmitInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &slot.command_buffer;
+    ++g_Submits;
+    if (!async()) {
+        Vulkan::check(vkQueueSubmit(g_Queue, 1, &info, slot.fence));
+        return 0;
+    }
+
+    uint64_t signal_value = ++g_ComputeValue;
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkTimelineSemaphoreSubmitInfo timeline = {};
+    timeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline.waitSemaphoreValueCount = after_graphics_frame != 0 ? 1 : 0;
+    timeline.pWaitSemaphoreValues = &after_graphics_frame;
+    timeline.signalSemaphoreValueCount = 1;
+    timeline.pSignalSemaphoreValues = &signal_value;
+    info.pNext = &timeline;
+    info.waitSemaphoreCount = after_graphics_frame != 0 ? 1 : 0;
+    info.pWaitSemaphores = &g_GraphicsTimeline;
+    info.pWaitDstStageMask = &wait_stage;
+    info.signalSemaphoreCount = 1;
+    info.pSignalSemaphores = &g_ComputeTimeline;
+    Vulkan::check(vkQueueSubmit(g_ComputeQueue, 1, &info, slot.fence));
+    g_PendingValue = signal_value;
+    return signal_value;
+}
+
+// Graphics side: makes the frame's submit wait for the compute work handed over with
+// release_buffer, recording the acquire barriers (outside a render pass) where needed
+void acquire_for_graphics(VkCommandBuffer cmd, Vulkan::SubmitWaits &waits) {
+    if (g_PendingStages == 0) return;
+    if (async()) {
+        waits.add(g_ComputeTimeline, g_PendingStages, g_PendingValue);
+        if (!g_Acquires.empty()) {
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, g_PendingStages, Constants::no_flags,
+                0, nullptr, static_cast<uint32_t>(g_Acquires.size()), g_Acquires.data(), 0, nullptr);
+            g_Acquires.clear();
+        }
+    } else {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = g_PendingAccess;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, g_PendingStages, Constants::no_flags,
+            1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    g_PendingStages = 0;
+    g_PendingAccess = 0;
+}
+
+// Added to the graphics submit's signal list with value g_FrameNumber, VK_NULL_HANDLE on the single-queue path
+VkSemaphore graphics_timeline() {
+    return g_GraphicsTimeline;
+}
+} // namespace DS::Compute
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include "global.hpp"
+
+namespace DS::DeletionQueue {
+// Destruction of GPU objects that in-flight frames may still use, tagged with the frame number that
+// was being recorded when they were retired. Once that frame's fence has signalled they are safe to free.
+struct Entry {
+    uint64_t frame;
+    std::function<void()> destroy;
+};
+
+std::deque<Entry> g_Entries;
+
+void push(std::function<void()> destroy) {
+    g_Entries.push_back({.frame = g_FrameNumber, .destroy = std::move(destroy)});
+}
+
+// Runs everything retired in or before `completed_frame`
+void collect(uint64_t completed_frame) {
+    while (!g_Entries.empty() && g_Entries.front().frame <= completed_frame) {
+        g_Entries.front().destroy();
+        g_Entries.pop_front();
+    }
+}
+
+// Only valid once the device is idle
+void flush() {
+    while (!g_Entries.empty()) {
+        g_Entries.front().destroy();
+        g_Entries.pop_front();
+    }
+}
+} // namespace DS::DeletionQueue
@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <format>
+#include <print>
+
+#include <vulkan/vulkan.h>
+
+#include "deletion_queue.hpp"
+#include "global.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Depth {
+// One depth buffer shared by every frame in flight. Frames run in submission order on g_Queue, so
+// the render pass dependency (or the frame graph's barrier) is enough to keep a frame's clear from
+// racing the previous frame's depth tests. Depth-only formats, there is no stencil.
+constexpr auto format_preference = std::to_array<VkFormat>(
+    {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM});
+
+VkFormat g_Format = VK_FORMAT_UNDEFINED;
+Memory::Image *g_Image = nullptr;
+VkImageView g_View = VK_NULL_HANDLE;
+
+VkFormat select_format() {
+    for (VkFormat format : format_preference) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(g_PhysicalDevice, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) return format;
+    }
+    return VK_FORMAT_D16_UNORM; // Required to be supported
+}
+
+// Creates the depth buffer at the given size. An existing one is retired through the deletion
+// queue, frames still in flight keep using it.
+void create(uint32_t width, uint32_t height) {
+    if (g_Format == VK_FORMAT_UNDEFINED) {
+        g_Format = select_format();
+        DS_LOG_INFO(Vulkan, "Depth format {}", Util::enum_to_number(g_Format));
+    }
+    if (g_Image != nullptr) {
+        Memory::destroy_image_deferred(g_Image);
+        DeletionQueue::push([view = g_View] { vkDestroyImageView(g_Device, view, g_Allocator); });
+    }
+
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = g_Format;
+    image_info.extent = {width, height, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    g_Image = Memory::create_image(image_info, Memory::Usage::GpuOnly);
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = g_Image->image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = g_Format;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+    Vulkan::check(vkCreateImageView(g_Device, &view_info, g_Allocator, &g_View));
+}
+
+// Only valid once the device is idle
+void destroy() {
+    if (g_Image == nullptr) return;
+    vkDestroyImageView(g_Device, g_View, g_Allocator);
+    Memory::destroy_image(g_Image);
+    g_Image = nullptr;
+    g_View = VK_NULL_HANDLE;
+}
+} // namespace DS::Depth
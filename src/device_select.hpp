@@ -0,0 +1,262 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "bindless.hpp"
+#include "global.hpp"
+#include "log.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::DeviceSelect {
+// Ranks every physical device instead of taking the last discrete GPU. Devices missing something
+// the engine cannot run without are skipped; the rest are scored by type first, then by the size of
+// their largest device-local heap, queue family mix, API version and optional features. An explicit
+// choice from --gpu or DS_GPU (index or #index, name substring or device UUID) wins over the score.
+constexpr int64_t score_discrete = 10'000;
+constexpr int64_t score_integrated = 5'000;
+constexpr int64_t score_virtual = 2'000;
+constexpr int64_t score_cpu = 100;
+constexpr int64_t score_per_vram_gib = 250;
+constexpr uint64_t score_vram_cap_gib = 32; // Beyond this VRAM doesn't decide anything
+constexpr int64_t score_async_compute = 500;
+constexpr int64_t score_transfer_queue = 250;
+constexpr int64_t score_api_1_3 = 300;
+constexpr int64_t score_api_1_2 = 150;
+constexpr int64_t score_timeline = 200;
+constexpr int64_t score_dynamic_rendering = 100;
+constexpr int64_t score_bindless = 200;
+
+struct Candidate {
+    VkPhysicalDevice gpu = VK_NULL_HANDLE;
+    uint32_t index = 0;
+    VkPhysicalDeviceProperties properties = {};
+    uint8_t uuid[VK_UUID_SIZE] = {};
+    uint64_t vram_bytes = 0; // Largest device-local heap
+    bool async_compute = false;
+    bool transfer_queue = false;
+    bool timeline = false;
+    bool dynamic_rendering = false;
+    bool bindless = false;
+    const char *rejected = nullptr; // Why the device can't be used, nullptr if it can
+    int64_t score = 0;
+};
+
+std::string g_Override; // From --gpu, falls back to the DS_GPU environment variable
+
+bool has_extension(VkPhysicalDevice gpu, const char *name) {
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(gpu, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> extensions(count);
+    vkEnumerateDeviceExtensionProperties(gpu, nullptr, &count, extensions.data());
+    return std::any_of(extensions.begin(), extensions.end(), [&](const VkExtensionProperties &e) {
+        return std::strcmp(e.extensionName, name) == 0;
+    });
+}
+
+Candidate inspect(VkPhysicalDevice gpu, uint32_t index) {
+    Candidate c;
+    c.gpu = gpu;
+    c.index = index;
+    vkGetPhysicalDeviceProperties(gpu, &c.properties);
+    if (c.properties.apiVersion < VK_API_VERSION_1_1) {
+        c.rejected = "Vulkan 1.1 required";
+        return c;
+    }
+
+    VkPhysicalDeviceIDProperties id_properties = {};
+    id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &id_properties;
+    vkGetPhysicalDeviceProperties2(gpu, &properties2);
+    std::memcpy(c.uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+
+    VkPhysicalDeviceMemoryProperties memory;
+    vkGetPhysicalDeviceMemoryProperties(gpu, &memory);
+    for (uint32_t i = 0; i < memory.memoryHeapCount; ++i) {
+        if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            c.vram_bytes = std::max<uint64_t>(c.vram_bytes, memory.memoryHeaps[i].size);
+        }
+    }
+
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &family_count, families.data());
+    bool graphics = false;
+    for (const VkQueueFamilyProperties &family : families) {
+        VkQueueFlags flags = family.queueFlags;
+        graphics |= (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        c.async_compute |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+        c.transfer_queue |= (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+    }
+    if (!graphics) {
+        c.rejected = "no graphics queue";
+        return c;
+    }
+    if (!g_Headless && !has_extension(gpu, Vulkan::Strings::extension_swapchain)) {
+        c.rejected = "no VK_KHR_swapchain";
+        return c;
+    }
+
+    if (c.properties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceVulkan13Features features13 = {};
+        features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        VkPhysicalDeviceVulkan12Features features12 = {};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.pNext = c.properties.apiVersion >= VK_API_VERSION_1_3 ? &features13 : nullptr;
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &features12;
+        vkGetPhysicalDeviceFeatures2(gpu, &features);
+        c.timeline = features12.timelineSemaphore == VK_TRUE;
+        c.dynamic_rendering = features13.dynamicRendering == VK_TRUE;
+        c.bindless = Bindless::supported(features12);
+    }
+    // Async compute is only used with timeline semaphores, see setup_vulkan
+    c.async_compute &= c.timeline;
+
+    switch (c.properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        c.score += score_discrete;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        c.score += score_integrated;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        c.score += score_virtual;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        c.score += score_cpu;
+        break;
+    default:
+        break;
+    }
+    c.score += static_cast<int64_t>(std::min(c.vram_bytes >> 30, score_vram_cap_gib)) * score_per_vram_gib;
+    if (c.async_compute) c.score += score_async_compute;
+    if (c.transfer_queue) c.score += score_transfer_queue;
+    if (c.properties.apiVersion >= VK_API_VERSION_1_3) {
+        c.score += score_api_1_3;
+    } else if (c.properties.apiVersion >= VK_API_VERSION_1_2) {
+        c.score += score_api_1_2;
+    }
+    if (c.timeline) c.score += score_timeline;
+    if (c.dynamic_rendering) c.score += score_dynamic_rendering;
+    if (c.bindless) c.score += score_bindless;
+    return c;
+}
+
+std::string_view type_name(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+std::string lowercase(std::string_view text) {
+    std::string result(text);
+    std::transform(result.begin(), result.end(), result.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return result;
+}
+
+// UUIDs compare as hex digits only, so both "0a1b..." and the logged "0A-1B-..." form match
+std::string hex_digits(std::string_view text) {
+    std::string result;
+    for (char ch : text) {
+        if (std::isxdigit(static_cast<unsigned char>(ch))) result.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(ch))));
+    }
+    return result;
+}
+
+// "#1" is always an index. A bare number is an index while it is in range, otherwise it is matched
+// against the names, so "4090" still finds an RTX 4090.
+bool matches(const Candidate &c, std::string_view request, size_t device_count) {
+    bool explicit_index = request.starts_with('#');
+    std::string_view number = explicit_index ? request.substr(1) : request;
+    uint32_t index;
+    auto [ptr, ec] = std::from_chars(number.data(), number.data() + number.size(), index);
+    bool is_number = !number.empty() && ec == std::errc{} && ptr == number.data() + number.size();
+    if (explicit_index) return is_number && index == c.index;
+    if (is_number && index < device_count) return index == c.index;
+    std::string digits = hex_digits(request);
+    if (digits.size() == Constants::uuid_size * 2 && digits == hex_digits(Util::uuid_to_string(c.uuid))) return true;
+    return lowercase(c.properties.deviceName).find(lowercase(request)) != std::string::npos;
+}
+
+void log_table(const std::vector<Candidate> &ranked) {
+    DS_LOG_INFO(Vulkan, "Physical devices, best first");
+    DS_LOG_INFO(Vulkan, "\t  # {:>6} {:<10} {:>9} {:>5} {:<10} {:<40} {}", "score", "type", "VRAM MiB", "API", "features", "name", "UUID");
+    for (const Candidate &c : ranked) {
+        std::string features = std::format("{}{}{}{}{}",
+            c.async_compute ? 'C' : '-', c.transfer_queue ? 'T' : '-', c.timeline ? 'S' : '-',
+            c.dynamic_rendering ? 'D' : '-', c.bindless ? 'B' : '-');
+        std::string score = c.rejected ? std::string("-") : std::format("{}", c.score);
+        DS_LOG_INFO(Vulkan, "\t{:3} {:>6} {:<10} {:>9} {:>5} {:<10} {:<40} {}{}", c.index, score,
+            type_name(c.properties.deviceType), c.vram_bytes >> 20,
+            std::format("{}.{}", VK_VERSION_MAJOR(c.properties.apiVersion), VK_VERSION_MINOR(c.properties.apiVersion)),
+            features, c.properties.deviceName, Util::uuid_to_string(c.uuid),
+            c.rejected ? std::format(" (skipped: {})", c.rejected) : std::string());
+    }
+    DS_LOG_INFO(Vulkan, "\tfeatures: C async compute, T transfer queue, S timeline semaphores, D dynamic rendering, B bindless");
+}
+
+VkPhysicalDevice select(const std::vector<VkPhysicalDevice> &gpus) {
+    std::vector<Candidate> ranked;
+    for (uint32_t i = 0; i < gpus.size(); ++i) ranked.push_back(inspect(gpus[i], i));
+    // Usable devices first, then by score; ties keep enumeration order
+    std::stable_sort(ranked.begin(), ranked.end(), [](const Candidate &a, const Candidate &b) {
+        if ((a.rejected == nullptr) != (b.rejected == nullptr)) return a.rejected == nullptr;
+        return a.score > b.score;
+    });
+    log_table(ranked);
+
+    std::string request = g_Override;
+    const char *source = "--gpu";
+    if (request.empty()) {
+        const char *env = std::getenv("DS_GPU");
+        if (env != nullptr) request = env;
+        source = "DS_GPU";
+    }
+    if (!request.empty()) {
+        auto it = std::find_if(ranked.begin(), ranked.end(), [&](const Candidate &c) { return matches(c, request, ranked.size()); });
+        if (it == ranked.end()) {
+            DS_LOG_WARNING(Vulkan, "{} '{}' matches no physical device, using the best ranked one", source, request);
+        } else if (it->rejected) {
+            DS_LOG_WARNING(Vulkan, "{} '{}' selects {}, which can't be used ({}), using the best ranked one",
+                source, request, it->properties.deviceName, it->rejected);
+        } else {
+            DS_LOG_INFO(Vulkan, "{} '{}' selects device {}: {}", source, request, it->index, it->properties.deviceName);
+            return it->gpu;
+        }
+    }
+
+    if (ranked.front().rejected) {
+        DS_LOG_ERROR(Vulkan, "No usable physical device. Aborting!");
+        abort();
+    }
+    DS_LOG_INFO(Vulkan, "Selected device {}: {}", ranked.front().index, ranked.front().properties.deviceName);
+    return ranked.front().gpu;
+}
+} // namespace DS::DeviceSelect
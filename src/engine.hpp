@@ -1,8 +1,11 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstring>
 #include <format>
 #include <print>
+#include <span>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -26,8 +29,29 @@
 #define VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR 0x00000001
 #endif
 
+#include "assets.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "deletion_queue.hpp"
+#include "depth.hpp"
+#include "device_select.hpp"
 #include "global.hpp"
+#include "host_allocator.hpp"
+#include "jobs.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+#include "meshes.hpp"
+#include "pipeline_cache.hpp"
+#include "present.hpp"
+#include "profiler.hpp"
+#include "recording.hpp"
+#include "render_graph.hpp"
+#include "shader_registry.hpp"
+#include "sprites.hpp"
+#include "swapchain.hpp"
+#include "transfer.hpp"
 #include "util.hpp"
+#include "validation.hpp"
 #include "vulkan_util.hpp"
 
 using std::println, std::print;
@@ -41,11 +65,71 @@ namespace DS::Engine {
 
 constexpr bool log_setup = true;
 
+// The frames-in-flight ring is independent of the swapchain: g_FramesInFlight bounds how far the CPU
+// runs ahead, while the swapchain image is only needed (and acquired) once recording is done.
+void setup_frames() {
+    g_Frames.resize(g_FramesInFlight);
+    for (uint32_t i = 0; i < g_FramesInFlight; ++i) {
+        FrameContext &frame = g_Frames[i];
+        {
+            VkCommandPoolCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            info.queueFamilyIndex = g_QueueFamily;
+            Vulkan::check(vkCreateCommandPool(g_Device, &info, g_Allocator, &frame.command_pool));
+        }
+        {
+            VkCommandBufferAllocateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            info.commandPool = frame.command_pool;
+            info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            info.commandBufferCount = 1;
+            Vulkan::check(vkAllocateCommandBuffers(g_Device, &info, &frame.command_buffer));
+        }
+        {
+            VkFenceCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+            Vulkan::check(vkCreateFence(g_Device, &info, g_Allocator, &frame.fence));
+        }
+        {
+            VkSemaphoreCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            Vulkan::check(vkCreateSemaphore(g_Device, &info, g_Allocator, &frame.image_acquired));
+        }
+        Validation::set_name(VK_OBJECT_TYPE_COMMAND_POOL, frame.command_pool, "Frame {} command pool", i);
+        Validation::set_name(VK_OBJECT_TYPE_COMMAND_BUFFER, frame.command_buffer, "Frame {} primary", i);
+        Validation::set_name(VK_OBJECT_TYPE_FENCE, frame.fence, "Frame {} fence", i);
+        Validation::set_name(VK_OBJECT_TYPE_SEMAPHORE, frame.image_acquired, "Frame {} image acquired", i);
+    }
+    g_FrameSlot = 0;
+    if (log_setup) DS_LOG_INFO(Render, "Created {} frames in flight", g_FramesInFlight);
+}
+
+void destroy_frames() {
+    for (FrameContext &frame : g_Frames) {
+        vkDestroySemaphore(g_Device, frame.image_acquired, g_Allocator);
+        vkDestroyFence(g_Device, frame.fence, g_Allocator);
+        vkDestroyCommandPool(g_Device, frame.command_pool, g_Allocator);
+    }
+    g_Frames.clear();
+}
+
 void setup_vulkan(std::vector<Vulkan::Extension> extensions) {
     VkResult err;
 
+    if (log_setup) DS_LOG_INFO(Vulkan, "Installing host allocation callbacks");
+    HostAllocator::install();
+
+    // 1.2 brings timeline semaphores into core, the backends already target 1.3
+    VkApplicationInfo app_info = {};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "VulkanEngine";
+    app_info.pEngineName = "VulkanEngine";
+    app_info.apiVersion = VK_API_VERSION_1_3;
+
     VkInstanceCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    create_info.pApplicationInfo = &app_info;
 
     uint32_t properties_count;
     std::vector<VkExtensionProperties> properties;
@@ -53,12 +137,12 @@ void setup_vulkan(std::vector<Vulkan::Extension> extensions) {
     properties.resize(properties_count);
     Vulkan::check(vkEnumerateInstanceExtensionProperties(nullptr, &properties_count, properties.data()));
 
-    if (log_setup) println("[Vulkan] Info: Availiable Extensions");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Availiable Extensions");
     for (const auto &p : properties) {
-        if (log_setup) println("[Vulkan] Info: \t{}", p);
+        if (log_setup) DS_LOG_INFO(Vulkan, "\t{}", p);
     }
 
-    if (log_setup) println("[Vulkan] Info: Enabling required extensions");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Enabling required extensions");
     {
         Extension ext = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
         if (Vulkan::check_extension(properties, ext)) extensions.push_back(ext);
@@ -70,68 +154,38 @@ void setup_vulkan(std::vector<Vulkan::Extension> extensions) {
         }
     }
 
-    if (log_setup) println("[Vulkan] Info: Enabling validation layers");
-    {
-        ValidationLayer layers[] = {Vulkan::Strings::layer_validation};
-        create_info.enabledLayerCount = 1;
-        create_info.ppEnabledLayerNames = layers;
-        // TODO: This is deprecated use VK_EXT_debug_utils + VkDebugUtilsMessengerEXT instead
-        extensions.push_back(Vulkan::Strings::extension_debug_report);
-    }
+    if (log_setup) DS_LOG_INFO(Vulkan, "Selecting validation tier");
+    Validation::request(create_info, extensions, properties);
 
-    if (log_setup) println("[Vulkan] Info: Creating Vulkan Instance");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating Vulkan Instance");
     { // Create Vulkan Instance
         create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
         create_info.ppEnabledExtensionNames = extensions.data();
         Vulkan::check(vkCreateInstance(&create_info, g_Allocator, &g_Instance));
     }
 
-    if (log_setup) println("[Vulkan] Info: Setup the debug report callback");
-    { // Setup the debug report callback
-        auto f_vkCreateDebugReportCallbackEXT = reinterpret_cast<PFN_vkCreateDebugReportCallbackEXT>(
-            vkGetInstanceProcAddr(g_Instance, Vulkan::Strings::vkCreateDebugReportCallbackEXT));
-        if (!f_vkCreateDebugReportCallbackEXT) {
-            println(stderr, "[Vulkan] Error: Failed to setup debug report callback!");
-            abort();
-        }
-        VkDebugReportCallbackCreateInfoEXT debug_report_ci = {};
-        debug_report_ci.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
-        debug_report_ci.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
-        debug_report_ci.pfnCallback = Vulkan::debug_report;
-        debug_report_ci.pUserData = nullptr;
-        Vulkan::check(f_vkCreateDebugReportCallbackEXT(g_Instance, &debug_report_ci, g_Allocator, &g_DebugReport));
-    }
+    if (log_setup && Validation::enabled()) DS_LOG_INFO(Vulkan, "Setup the debug utils messenger");
+    Validation::setup();
 
-    if (log_setup) println("[Vulkan] Info: Select physical device");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Select physical device");
     {
         uint32_t gpu_count;
         Vulkan::check(vkEnumeratePhysicalDevices(g_Instance, &gpu_count, nullptr));
         if (gpu_count == 0) {
-            println("[Vulkan] Error: No physical devices found. Aborting!");
+            DS_LOG_ERROR(Vulkan, "No physical devices found. Aborting!");
             abort();
         }
         std::vector<VkPhysicalDevice> gpus;
         gpus.resize(gpu_count);
         Vulkan::check(vkEnumeratePhysicalDevices(g_Instance, &gpu_count, gpus.data()));
 
-        for (auto &gpu : gpus) {
-            VkPhysicalDeviceProperties properties;
-            vkGetPhysicalDeviceProperties(gpu, &properties);
-            if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
-                println("[VULKAN] Info: Found suitable GPU\n{}", properties);
-                g_PhysicalDevice = gpu;
-            }
-        }
-        if (g_PhysicalDevice == VK_NULL_HANDLE) {
-            VkPhysicalDevice fallback_gpu = gpus[0];
-            VkPhysicalDeviceProperties properties;
-            vkGetPhysicalDeviceProperties(fallback_gpu, &properties);
-            println("[Vulkan] Warning: Didn't find a discrete gpu, falling back to first gpu\n{}", properties);
-            g_PhysicalDevice = fallback_gpu;
-        }
+        g_PhysicalDevice = DeviceSelect::select(gpus);
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+        if (log_setup) DS_LOG_INFO(Vulkan, "Using GPU\n{}", properties);
     }
 
-    if (log_setup) println("[Vulkan] Info: Select graphics queue family");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Select graphics queue family");
     {
         uint32_t count;
         vkGetPhysicalDeviceQueueFamilyProperties(g_PhysicalDevice, &count, nullptr);
@@ -145,15 +199,77 @@ void setup_vulkan(std::vector<Vulkan::Extension> extensions) {
             }
         }
         if (g_QueueFamily == Constants::queue_familily_not_init) {
-            if (log_setup) println(stderr, "[Vulkan] Error: Failed to select graphics queue family!");
+            if (log_setup) DS_LOG_ERROR(Vulkan, "Failed to select graphics queue family!");
             abort();
         }
+
+        // A transfer-only family maps to the copy engines on discrete GPUs, so uploads don't compete
+        // with rendering. Without one, transfers share the graphics queue.
+        g_TransferQueueFamily = g_QueueFamily;
+        for (uint32_t i = 0; i < count; i++) {
+            VkQueueFlags flags = queues_properties[i].queueFlags;
+            if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                g_TransferQueueFamily = i;
+                break;
+            }
+        }
+        if (log_setup) {
+            if (g_TransferQueueFamily != g_QueueFamily) {
+                DS_LOG_INFO(Vulkan, "Using dedicated transfer queue family {}", g_TransferQueueFamily);
+            } else {
+                DS_LOG_INFO(Vulkan, "No transfer-only queue family, uploads share the graphics queue");
+            }
+        }
+
+        // Async compute needs a compute family without graphics, and timeline semaphores to
+        // schedule against the graphics queue. Otherwise compute shares the graphics queue.
+        VkPhysicalDeviceProperties device_properties;
+        vkGetPhysicalDeviceProperties(g_PhysicalDevice, &device_properties);
+        if (device_properties.apiVersion >= VK_API_VERSION_1_2) {
+            VkPhysicalDeviceVulkan13Features features13 = {};
+            features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+            VkPhysicalDeviceVulkan12Features features12 = {};
+            features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            features12.pNext = device_properties.apiVersion >= VK_API_VERSION_1_3 ? &features13 : nullptr;
+            VkPhysicalDeviceFeatures2 features = {};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &features12;
+            vkGetPhysicalDeviceFeatures2(g_PhysicalDevice, &features);
+            g_TimelineSemaphores = features12.timelineSemaphore == VK_TRUE;
+            g_Synchronization2 = features13.synchronization2 == VK_TRUE;
+            Bindless::g_Enabled = Bindless::supported(features12);
+            Meshes::check_support(features.features, features12);
+            if (g_DynamicRendering && features13.dynamicRendering != VK_TRUE) {
+                DS_LOG_WARNING(Vulkan, "Dynamic rendering needs a Vulkan 1.3 device, using render passes");
+                g_DynamicRendering = false;
+            }
+        } else if (g_DynamicRendering) {
+            DS_LOG_WARNING(Vulkan, "Dynamic rendering needs a Vulkan 1.3 device, using render passes");
+            g_DynamicRendering = false;
+        }
+        g_ComputeQueueFamily = g_QueueFamily;
+        for (uint32_t i = 0; g_TimelineSemaphores && i < count; i++) {
+            VkQueueFlags flags = queues_properties[i].queueFlags;
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+                g_ComputeQueueFamily = i;
+                break;
+            }
+        }
+        if (log_setup) {
+            if (g_ComputeQueueFamily != g_QueueFamily) {
+                DS_LOG_INFO(Vulkan, "Using async compute queue family {}", g_ComputeQueueFamily);
+            } else if (!g_TimelineSemaphores) {
+                DS_LOG_WARNING(Vulkan, "No timeline semaphore support, compute shares the graphics queue");
+            } else {
+                DS_LOG_INFO(Vulkan, "No compute-only queue family, compute shares the graphics queue");
+            }
+        }
     }
 
-    if (log_setup) println("[Vulkan] Info: Creating Logical Device (with 1 queue)");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating Logical Device");
     {
         std::vector<Extension> device_extensions;
-        device_extensions.push_back(Vulkan::Strings::extension_swapchain);
+        if (!g_Headless) device_extensions.push_back(Vulkan::Strings::extension_swapchain);
 
         uint32_t properties_count;
         std::vector<VkExtensionProperties> properties;
@@ -174,15 +290,36 @@ void setup_vulkan(std::vector<Vulkan::Extension> extensions) {
         }
 
         const float queue_priority[] = {1.0f};
-        VkDeviceQueueCreateInfo queue_info[1] = {};
-        queue_info[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queue_info[0].queueFamilyIndex = g_QueueFamily;
-        queue_info[0].queueCount = 1;
-        queue_info[0].pQueuePriorities = queue_priority;
+        std::vector<VkDeviceQueueCreateInfo> queue_info;
+        for (uint32_t family : {g_QueueFamily, g_TransferQueueFamily, g_ComputeQueueFamily}) {
+            bool already_added = std::any_of(queue_info.begin(), queue_info.end(), [&](const VkDeviceQueueCreateInfo &info) {
+                return info.queueFamilyIndex == family;
+            });
+            if (already_added) continue;
+            VkDeviceQueueCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            info.queueFamilyIndex = family;
+            info.queueCount = 1;
+            info.pQueuePriorities = queue_priority;
+            queue_info.push_back(info);
+        }
+        VkPhysicalDeviceVulkan13Features features13 = {};
+        features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        features13.dynamicRendering = g_DynamicRendering ? VK_TRUE : VK_FALSE;
+        features13.synchronization2 = g_Synchronization2 ? VK_TRUE : VK_FALSE;
+        VkPhysicalDeviceVulkan12Features features12 = {};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.pNext = (g_DynamicRendering || g_Synchronization2) ? &features13 : nullptr;
+        features12.timelineSemaphore = g_TimelineSemaphores ? VK_TRUE : VK_FALSE;
+        if (Bindless::g_Enabled) Bindless::enable_features(features12);
+        VkPhysicalDeviceFeatures features = {};
+        Meshes::enable_features(features, features12);
         VkDeviceCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        create_info.queueCreateInfoCount = sizeof(queue_info) / sizeof(queue_info[0]);
-        create_info.pQueueCreateInfos = queue_info;
+        create_info.pNext = (g_TimelineSemaphores || Bindless::g_Enabled || g_DynamicRendering || g_Synchronization2 || Meshes::g_DrawIndirectCount) ? &features12 : nullptr;
+        create_info.pEnabledFeatures = &features;
+        create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_info.size());
+        create_info.pQueueCreateInfos = queue_info.data();
         create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
         create_info.ppEnabledExtensionNames = device_extensions.data();
         Vulkan::check(vkCreateDevice(
@@ -190,9 +327,16 @@ void setup_vulkan(std::vector<Vulkan::Extension> extensions) {
             &create_info,
             g_Allocator, &g_Device));
         vkGetDeviceQueue(g_Device, g_QueueFamily, 0, &g_Queue);
+        vkGetDeviceQueue(g_Device, g_TransferQueueFamily, 0, &g_TransferQueue);
+        vkGetDeviceQueue(g_Device, g_ComputeQueueFamily, 0, &g_ComputeQueue);
+        // Shared queues just end up with the last name
+        Validation::set_name(VK_OBJECT_TYPE_DEVICE, g_Device, "Main device");
+        Validation::set_name(VK_OBJECT_TYPE_QUEUE, g_ComputeQueue, "Compute queue (family {})", g_ComputeQueueFamily);
+        Validation::set_name(VK_OBJECT_TYPE_QUEUE, g_TransferQueue, "Transfer queue (family {})", g_TransferQueueFamily);
+        Validation::set_name(VK_OBJECT_TYPE_QUEUE, g_Queue, "Graphics queue (family {})", g_QueueFamily);
     }
 
-    if (log_setup) println("[Vulkan] Info: Creating Descriptor Pool");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating Descriptor Pool");
     {
         constexpr auto pool_sizes = std::to_array<VkDescriptorPoolSize>(
             {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, Constants::descriptor_pool_count}});
@@ -211,7 +355,32 @@ void setup_vulkan(std::vector<Vulkan::Extension> extensions) {
                 &pool_info,
                 g_Allocator,
                 &g_DescriptorPool));
+        Validation::set_name(VK_OBJECT_TYPE_DESCRIPTOR_POOL, g_DescriptorPool, "ImGui descriptor pool");
     }
+
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating bindless descriptor sets");
+    Bindless::setup();
+
+    if (log_setup) DS_LOG_INFO(Vulkan, "Setting up device memory allocator");
+    Memory::setup();
+
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating staging ring");
+    Transfer::setup();
+
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating compute command buffers");
+    Compute::setup();
+
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating Pipeline Cache");
+    PipelineCache::create();
+
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating Timestamp Query Pool");
+    Profiler::setup_gpu();
+
+    if (log_setup) DS_LOG_INFO(Render, "Creating frames in flight");
+    setup_frames();
+
+    if (log_setup) DS_LOG_INFO(Render, "Creating per-thread command pools");
+    Recording::setup();
 }
 
 void setup_vulkan_window(ImGui_ImplVulkanH_Window *wd, VkSurfaceKHR surface, int width, int height) {
@@ -224,7 +393,7 @@ void setup_vulkan_window(ImGui_ImplVulkanH_Window *wd, VkSurfaceKHR surface, int
         wd->Surface,
         &res);
     if (res != VK_TRUE) {
-        if (log_setup) println(stderr, "[Vulkan] Error: No WSI (Window System Integration) support on physical device 0");
+        if (log_setup) DS_LOG_ERROR(Vulkan, "No WSI (Window System Integration) support on physical device 0");
         exit(-1);
     }
 
@@ -239,47 +408,138 @@ void setup_vulkan_window(ImGui_ImplVulkanH_Window *wd, VkSurfaceKHR surface, int
         request_surface_color_space);
 
     // Select Present Mode
-    constexpr auto present_modes = std::to_array<VkPresentModeKHR>({VK_PRESENT_MODE_FIFO_KHR});
-    wd->PresentMode = ImGui_ImplVulkanH_SelectPresentMode(
-        g_PhysicalDevice,
-        wd->Surface,
-        present_modes.data(),
-        present_modes.size());
-    println("[Vulkan] Info: Selected PresentMode = {}", Util::enum_to_number(wd->PresentMode));
+    Present::query_supported_modes(wd->Surface);
+    wd->PresentMode = Present::select();
+    DS_LOG_INFO(Vulkan, "Selected PresentMode = {}", wd->PresentMode);
 
-    // Create SwapChain, RenderPass, Framebuffer, etc.
+    // Create SwapChain, RenderPass, Framebuffer, etc. With dynamic rendering only the swapchain and views
     static_assert(g_MinImageCount >= 2);
-    ImGui_ImplVulkanH_CreateOrResizeWindow(
-        g_Instance,
-        g_PhysicalDevice,
-        g_Device,
-        wd,
-        g_QueueFamily,
-        g_Allocator,
-        width,
-        height,
-        g_MinImageCount);
+    wd->UseDynamicRendering = g_DynamicRendering;
+    wd->ClearEnable = true;
+    Swapchain::create_or_resize(wd, width, height);
 }
 
-static void FrameRender(ImGui_ImplVulkanH_Window *wd, ImDrawData *draw_data) {
-    VkSemaphore image_acquired_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].ImageAcquiredSemaphore;
-    VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].RenderCompleteSemaphore;
-    VkResult err = vkAcquireNextImageKHR(g_Device, wd->Swapchain, Constants::no_timeout, image_acquired_semaphore, VK_NULL_HANDLE, &wd->FrameIndex);
+std::vector<Memory::Image *> g_HeadlessImages;
 
+// Stand-in for setup_vulkan_window when there is no display: fills `wd` with an engine-owned ring of
+// offscreen color images (plus views and framebuffers) so FrameRender can record into it unchanged.
+// There is no swapchain, surface or semaphores. The ring is at least g_FramesInFlight deep, so an
+// image is never reused before the frame that last rendered into it has retired.
+void setup_headless_target(ImGui_ImplVulkanH_Window *wd, int width, int height) {
+    wd->Width = width;
+    wd->Height = height;
+    wd->Swapchain = VK_NULL_HANDLE;
+    wd->Surface = VK_NULL_HANDLE;
+    wd->SurfaceFormat = {Constants::headless_color_format, VK_COLORSPACE_SRGB_NONLINEAR_KHR};
+    wd->PresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    wd->ClearEnable = true;
+    wd->FrameIndex = 0;
+    wd->ImageCount = std::max(Constants::headless_image_count, g_FramesInFlight);
+    wd->SemaphoreCount = 0;
+    wd->SemaphoreIndex = 0;
+    wd->UseDynamicRendering = g_DynamicRendering;
+    static_assert(Constants::headless_image_count >= g_MinImageCount);
+
+    Depth::create(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    if (!g_DynamicRendering) { // Finishing in TRANSFER_SRC so the images are ready for readback
+        wd->RenderPass = Swapchain::create_render_pass(wd->SurfaceFormat.format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    }
+
+    wd->Frames.resize(static_cast<int>(wd->ImageCount));
+    g_HeadlessImages.resize(wd->ImageCount);
+    for (uint32_t i = 0; i < wd->ImageCount; ++i) {
+        ImGui_ImplVulkanH_Frame *fd = &wd->Frames[i];
+        *fd = ImGui_ImplVulkanH_Frame();
+        {
+            VkImageCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            info.imageType = VK_IMAGE_TYPE_2D;
+            info.format = wd->SurfaceFormat.format;
+            info.extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
+            info.mipLevels = 1;
+            info.arrayLayers = 1;
+            info.samples = VK_SAMPLE_COUNT_1_BIT;
+            info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            g_HeadlessImages[i] = Memory::create_image(info, Memory::Usage::GpuOnly);
+            fd->Backbuffer = g_HeadlessImages[i]->image;
+        }
+        {
+            VkImageViewCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            info.image = fd->Backbuffer;
+            info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            info.format = wd->SurfaceFormat.format;
+            info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            Vulkan::check(vkCreateImageView(g_Device, &info, g_Allocator, &fd->BackbufferView));
+        }
+        if (!g_DynamicRendering) {
+            VkFramebufferCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            const std::array<VkImageView, 2> attachments = {fd->BackbufferView, Depth::g_View};
+            info.renderPass = wd->RenderPass;
+            info.attachmentCount = static_cast<uint32_t>(attachments.size());
+            info.pAttachments = attachments.data();
+            info.width = static_cast<uint32_t>(width);
+            info.height = static_cast<uint32_t>(height);
+            info.layers = 1;
+            Vulkan::check(vkCreateFramebuffer(g_Device, &info, g_Allocator, &fd->Framebuffer));
+        }
+    }
+}
+
+void destroy_headless_target(ImGui_ImplVulkanH_Window *wd) {
+    for (uint32_t i = 0; i < wd->ImageCount; ++i) {
+        ImGui_ImplVulkanH_Frame *fd = &wd->Frames[i];
+        vkDestroyFramebuffer(g_Device, fd->Framebuffer, g_Allocator);
+        vkDestroyImageView(g_Device, fd->BackbufferView, g_Allocator);
+        Memory::destroy_image(g_HeadlessImages[i]);
+    }
+    g_HeadlessImages.clear();
+    vkDestroyRenderPass(g_Device, wd->RenderPass, g_Allocator);
+    *wd = ImGui_ImplVulkanH_Window();
+}
+
+
+// Headless stand-in for a swapchain rebuild, timed the same way. The ring's images are destroyed right
+// away, so this waits for the device first. Used by the benchmark suite to measure resize latency.
+float resize_headless_target(int width, int height) {
+    auto rebuild_start = std::chrono::steady_clock::now();
+    Vulkan::check(vkDeviceWaitIdle(g_Device));
+    destroy_headless_target(&g_MainWindowData);
+    setup_headless_target(&g_MainWindowData, width, height);
+    float rebuild_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - rebuild_start).count();
+    Present::record_rebuild(rebuild_ms);
+    return rebuild_ms;
+}
+
+// Picks the image to render into. Returns false if the frame has to be dropped (swapchain out of date
+// or the acquire timed out); the slot's fence is untouched in that case so the slot can be retried.
+bool acquire_image(ImGui_ImplVulkanH_Window *wd, VkSemaphore image_acquired_semaphore) {
+    if (g_Headless) {
+        // Nothing to acquire, just walk the offscreen ring
+        wd->FrameIndex = (wd->FrameIndex + 1) % wd->ImageCount;
+        return true;
+    }
+
+    VkResult err = vkAcquireNextImageKHR(g_Device, wd->Swapchain, Constants::acquire_timeout_ns, image_acquired_semaphore, VK_NULL_HANDLE, &wd->FrameIndex);
     if (err == VK_ERROR_OUT_OF_DATE_KHR) {
         if (log_setup) {
-            println(stderr,
-                "[Vulkan] Error: vkAcquireNextImageKHR gave {}. Rebuilding Swapchain and cancelling FrameRender.",
+            DS_LOG_ERROR(Vulkan, "vkAcquireNextImageKHR gave {}. Rebuilding Swapchain and cancelling FrameRender.",
                 err);
         }
         g_SwapChainRebuild = true;
-        return;
+        return false;
+    }
+    if (err == VK_TIMEOUT || err == VK_NOT_READY) {
+        return false;
     }
     if (err == VK_SUBOPTIMAL_KHR) {
         if (false) { // TODO: Uncomment this once we have swapchains actually implemented
             if (log_setup) {
-                println(stderr,
-                    "[Vulkan] Warning: vkAcquireNextImageKHR gave {}. Rebuilding Swapchain.",
+                DS_LOG_WARNING(Vulkan, "vkAcquireNextImageKHR gave {}. Rebuilding Swapchain.",
                     err);
             }
         }
@@ -287,57 +547,243 @@ static void FrameRender(ImGui_ImplVulkanH_Window *wd, ImDrawData *draw_data) {
     } else {
         Vulkan::check(err);
     }
+    return true;
+}
 
-    ImGui_ImplVulkanH_Frame *fd = &wd->Frames[wd->FrameIndex];
-    {
-        Vulkan::check(vkWaitForFences(g_Device, 1, &fd->Fence, VK_TRUE, Constants::no_timeout));
-        Vulkan::check(vkResetFences(g_Device, 1, &fd->Fence));
-    }
-    {
-        Vulkan::check(vkResetCommandPool(g_Device, fd->CommandPool, Constants::no_flags));
-        VkCommandBufferBeginInfo info = {};
-        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        Vulkan::check(vkBeginCommandBuffer(fd->CommandBuffer, &info));
+// What secondaries recorded for `wd` inherit: its render pass, or with dynamic rendering the
+// attachment formats (`rendering` has to outlive the returned struct)
+VkCommandBufferInheritanceInfo make_inheritance(const ImGui_ImplVulkanH_Window *wd, VkCommandBufferInheritanceRenderingInfo &rendering) {
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    if (g_DynamicRendering) {
+        rendering = {};
+        rendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+        rendering.colorAttachmentCount = 1;
+        rendering.pColorAttachmentFormats = &wd->SurfaceFormat.format;
+        rendering.depthAttachmentFormat = Depth::g_Format;
+        rendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        inheritance.pNext = &rendering;
+    } else {
+        inheritance.renderPass = wd->RenderPass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = VK_NULL_HANDLE;
     }
-    {
+    return inheritance;
+}
+
+// The frame's passes, compiled once and rebuilt when the render target changes size. The
+// backbuffer and the per-frame buffers are bound before every execution.
+RenderGraph::Graph g_FrameGraph;
+VkExtent2D g_FrameGraphExtent = {};
+RenderGraph::ResourceId g_BackbufferResource = 0;
+RenderGraph::ResourceId g_DepthResource = 0;
+RenderGraph::ResourceId g_DrawsResource = 0;
+RenderGraph::ResourceId g_ReadbackResource = 0;
+ImGui_ImplVulkanH_Frame *g_GraphFrame = nullptr;       // The acquired image, for the main pass
+std::span<const VkCommandBuffer> g_GraphSecondaries; // Recorded this frame, executed by the main pass
+
+// Clears the backbuffer and depth and executes the recorded secondaries. With render passes the
+// render pass does the attachment transitions, with dynamic rendering the graph does.
+void main_pass(VkCommandBuffer cmd, ImGui_ImplVulkanH_Window *wd) {
+    VkClearValue depth_clear = {};
+    depth_clear.depthStencil = {1.0f, 0};
+    if (g_DynamicRendering) {
+        VkRenderingAttachmentInfo color = {};
+        color.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        color.imageView = RenderGraph::view(g_FrameGraph, g_BackbufferResource);
+        color.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        color.clearValue = wd->ClearValue;
+        VkRenderingAttachmentInfo depth = {};
+        depth.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depth.imageView = RenderGraph::view(g_FrameGraph, g_DepthResource);
+        depth.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depth.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depth.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depth.clearValue = depth_clear;
+        VkRenderingInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        info.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+        info.renderArea.extent.width = wd->Width;
+        info.renderArea.extent.height = wd->Height;
+        info.layerCount = 1;
+        info.colorAttachmentCount = 1;
+        info.pColorAttachments = &color;
+        info.pDepthAttachment = &depth;
+        vkCmdBeginRendering(cmd, &info);
+    } else {
         VkRenderPassBeginInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         info.renderPass = wd->RenderPass;
-        info.framebuffer = fd->Framebuffer;
+        info.framebuffer = g_GraphFrame->Framebuffer;
         info.renderArea.extent.width = wd->Width;
         info.renderArea.extent.height = wd->Height;
-        info.clearValueCount = 1;
-        info.pClearValues = &wd->ClearValue;
-        vkCmdBeginRenderPass(fd->CommandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+        const std::array<VkClearValue, 2> clear_values = {wd->ClearValue, depth_clear};
+        info.clearValueCount = static_cast<uint32_t>(clear_values.size());
+        info.pClearValues = clear_values.data();
+        vkCmdBeginRenderPass(cmd, &info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
     }
+    vkCmdExecuteCommands(cmd, static_cast<uint32_t>(g_GraphSecondaries.size()), g_GraphSecondaries.data());
+    if (g_DynamicRendering) {
+        vkCmdEndRendering(cmd);
+    } else {
+        vkCmdEndRenderPass(cmd);
+    }
+}
 
-    // Record dear imgui primitives into command buffer
-    ImGui_ImplVulkan_RenderDrawData(draw_data, fd->CommandBuffer);
+// Culling, then the main pass drawing the meshes, sprites and dear imgui, then the visible count
+// readback. The backbuffer arrives through the acquire semaphore wait at color output and leaves in
+// its present (or headless copy) layout, the shared depth buffer may still be tested by the previous frame.
+void build_frame_graph(ImGui_ImplVulkanH_Window *wd) {
+    using RenderGraph::Access;
+    RenderGraph::destroy(g_FrameGraph);
+    RenderGraph::Graph &graph = g_FrameGraph;
+    g_BackbufferResource = RenderGraph::import_image(graph, "backbuffer", VK_IMAGE_ASPECT_COLOR_BIT,
+        {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED},
+        g_Headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    g_DepthResource = RenderGraph::import_image(graph, "depth", VK_IMAGE_ASPECT_DEPTH_BIT,
+        {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED},
+        VK_IMAGE_LAYOUT_UNDEFINED);
+    g_DrawsResource = RenderGraph::import_buffer(graph, "mesh draws");
+    g_ReadbackResource = RenderGraph::import_buffer(graph, "mesh visible count");
+
+    if (Meshes::g_Enabled) {
+        RenderGraph::PassId cull = RenderGraph::add_pass(graph, "mesh culling", [](VkCommandBuffer cmd) {
+            if (Meshes::g_AsyncCullFrame != g_FrameNumber) Meshes::cull(cmd, g_FrameSlot);
+        });
+        RenderGraph::use(graph, cull, g_DrawsResource, Access::StorageWrite);
+    }
+    RenderGraph::PassId main = RenderGraph::add_pass(graph, "main", [wd](VkCommandBuffer cmd) { main_pass(cmd, wd); });
+    RenderGraph::set_render_pass(graph, main, !g_DynamicRendering);
+    RenderGraph::use(graph, main, g_BackbufferResource, Access::ColorAttachment);
+    RenderGraph::use(graph, main, g_DepthResource, Access::DepthAttachment);
+    if (Meshes::g_Enabled) RenderGraph::use(graph, main, g_DrawsResource, Access::IndirectRead);
+    if (Meshes::g_DrawIndirectCount) {
+        RenderGraph::PassId readback = RenderGraph::add_pass(graph, "mesh visible count readback",
+            [](VkCommandBuffer cmd) { Meshes::read_back(cmd, g_FrameSlot); }, true);
+        RenderGraph::use(graph, readback, g_DrawsResource, Access::TransferSrc);
+        RenderGraph::use(graph, readback, g_ReadbackResource, Access::TransferDst);
+    }
+    RenderGraph::compile(graph);
+    g_FrameGraphExtent = {static_cast<uint32_t>(wd->Width), static_cast<uint32_t>(wd->Height)};
+}
 
-    // Submit command buffer
-    vkCmdEndRenderPass(fd->CommandBuffer);
+// Returns false if the frame was dropped, in which case there is nothing to present
+static bool FrameRender(ImGui_ImplVulkanH_Window *wd, ImDrawData *draw_data) {
+    DS_PROFILE_SCOPE("FrameRender");
+    FrameContext &frame = g_Frames[g_FrameSlot];
+    Vulkan::check(vkWaitForFences(g_Device, 1, &frame.fence, VK_TRUE, Constants::no_timeout));
+    Vulkan::check(vkResetCommandPool(g_Device, frame.command_pool, Constants::no_flags));
+    Recording::reset(g_FrameSlot);
+    DeletionQueue::collect(frame.submitted_frame);
+    Memory::trim();
+    Meshes::prepare(g_FrameSlot);
+    Sprites::prepare(g_FrameSlot);
+    Assets::pump(Constants::asset_stream_budget);
+    Transfer::flush();
+    Meshes::cull_async(g_FrameSlot);
+
+    // Record the scene before acquiring, the render pass (or attachment formats) is all the secondaries
+    // need to know. They are executed in order: the depth tested meshes, then sprites and dear imgui
+    // last so it draws on top.
+    std::array<VkCommandBuffer, 3> secondaries;
+    VkCommandBufferInheritanceRenderingInfo rendering;
+    VkCommandBufferInheritanceInfo inheritance = make_inheritance(wd, rendering);
+    {
+        const std::array<Recording::Task, 2> tasks = {
+            [wd](VkCommandBuffer cmd) { Meshes::record(cmd, wd); },
+            [wd](VkCommandBuffer cmd) { Sprites::record(cmd, wd); },
+        };
+        std::span<const VkCommandBuffer> scene = Recording::record(g_FrameSlot, inheritance, tasks);
+        std::copy(scene.begin(), scene.end(), secondaries.begin());
+    }
+
+    // Acquire as late as possible
+    if (!acquire_image(wd, frame.image_acquired)) return false;
+    Vulkan::check(vkResetFences(g_Device, 1, &frame.fence));
+
+    // ImGui_ImplVulkan_RenderDrawData advances the backend's own vertex/index buffer ring, so it is
+    // only recorded for frames that will be submitted, a dropped frame would put the ring out of step
+    // with g_FrameSlot and let the next frame overwrite buffers the GPU is still reading.
+    {
+        const std::array<Recording::Task, 1> tasks = {
+            [draw_data](VkCommandBuffer cmd) { ImGui_ImplVulkan_RenderDrawData(draw_data, cmd); },
+        };
+        secondaries[2] = Recording::record(g_FrameSlot, inheritance, tasks, 1)[0];
+    }
+
+    ImGui_ImplVulkanH_Frame *fd = &wd->Frames[wd->FrameIndex];
     {
-        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VkCommandBufferBeginInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        Vulkan::check(vkBeginCommandBuffer(frame.command_buffer, &info));
+    }
+    Profiler::gpu_begin(frame.command_buffer, g_FrameSlot);
+    Vulkan::SubmitWaits waits;
+    if (!g_Headless) waits.add(frame.image_acquired, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    Transfer::acquire_for_graphics(frame.command_buffer, waits);
+    Compute::acquire_for_graphics(frame.command_buffer, waits);
+    // After the acquires, a buffer may only be copied once graphics owns it
+    Memory::defragment(frame.command_buffer, Constants::defrag_moves_per_frame);
+    {
+        DS_PROFILE_SCOPE("RenderGraph::execute");
+        if (!g_FrameGraph.compiled || g_FrameGraphExtent.width != static_cast<uint32_t>(wd->Width) ||
+            g_FrameGraphExtent.height != static_cast<uint32_t>(wd->Height)) {
+            build_frame_graph(wd);
+        }
+        RenderGraph::bind_image(g_FrameGraph, g_BackbufferResource, fd->Backbuffer, fd->BackbufferView);
+        RenderGraph::bind_image(g_FrameGraph, g_DepthResource, Depth::g_Image->image, Depth::g_View);
+        RenderGraph::bind_buffer(g_FrameGraph, g_DrawsResource, Meshes::draw_buffer(g_FrameSlot));
+        RenderGraph::bind_buffer(g_FrameGraph, g_ReadbackResource, Meshes::readback_buffer(g_FrameSlot));
+        g_GraphFrame = fd;
+        g_GraphSecondaries = secondaries;
+        RenderGraph::execute(g_FrameGraph, frame.command_buffer);
+    }
+    Profiler::gpu_end(frame.command_buffer, g_FrameSlot);
+    {
+        // Binary render-complete for present, plus the graphics timeline async compute can wait on
+        std::array<VkSemaphore, 2> signals;
+        std::array<uint64_t, 2> signal_values = {};
+        uint32_t signal_count = 0;
+        if (!g_Headless) signals[signal_count++] = wd->FrameSemaphores[wd->FrameIndex].RenderCompleteSemaphore;
+        if (Compute::graphics_timeline() != VK_NULL_HANDLE) {
+            signal_values[signal_count] = g_FrameNumber;
+            signals[signal_count++] = Compute::graphics_timeline();
+        }
+        VkTimelineSemaphoreSubmitInfo timeline = {};
+        timeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline.waitSemaphoreValueCount = waits.count;
+        timeline.pWaitSemaphoreValues = waits.values.data();
+        timeline.signalSemaphoreValueCount = signal_count;
+        timeline.pSignalSemaphoreValues = signal_values.data();
         VkSubmitInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        info.waitSemaphoreCount = 1;
-        info.pWaitSemaphores = &image_acquired_semaphore;
-        info.pWaitDstStageMask = &wait_stage;
+        info.pNext = g_TimelineSemaphores ? &timeline : nullptr;
+        info.waitSemaphoreCount = waits.count;
+        info.pWaitSemaphores = waits.semaphores.data();
+        info.pWaitDstStageMask = waits.stages.data();
         info.commandBufferCount = 1;
-        info.pCommandBuffers = &fd->CommandBuffer;
-        info.signalSemaphoreCount = 1;
-        info.pSignalSemaphores = &render_complete_semaphore;
+        info.pCommandBuffers = &frame.command_buffer;
+        info.signalSemaphoreCount = signal_count;
+        info.pSignalSemaphores = signals.data();
 
-        Vulkan::check(vkEndCommandBuffer(fd->CommandBuffer));
-        Vulkan::check(vkQueueSubmit(g_Queue, 1, &info, fd->Fence));
+        Vulkan::check(vkEndCommandBuffer(frame.command_buffer));
+        Vulkan::check(vkQueueSubmit(g_Queue, 1, &info, frame.fence));
     }
+    frame.submitted_frame = g_FrameNumber++;
+    g_FrameSlot = (g_FrameSlot + 1) % g_FramesInFlight;
+    return true;
 }
 
 static void FramePresent(ImGui_ImplVulkanH_Window *wd) {
-    if (g_SwapChainRebuild)
+    DS_PROFILE_SCOPE("FramePresent");
+    if (g_SwapChainRebuild || g_Headless)
         return;
-    VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].RenderCompleteSemaphore;
+    // Render-complete semaphores are per swapchain image, an image is never in flight twice
+    VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->FrameIndex].RenderCompleteSemaphore;
     VkPresentInfoKHR info = {};
     info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     info.waitSemaphoreCount = 1;
@@ -355,72 +801,94 @@ static void FramePresent(ImGui_ImplVulkanH_Window *wd) {
     } else {
         Vulkan::check(err);
     }
-    wd->SemaphoreIndex = (wd->SemaphoreIndex + 1) % wd->SemaphoreCount;
+    Present::record_present();
 }
 
-void setup() {
-    if (!SDL_Init(SDL_INIT_VIDEO)) {
-        if (log_setup) println("[   SDL] Error: SDL_Init(): {}", SDL_GetError());
-        abort();
-    }
+void setup_headless() {
+    if (log_setup) DS_LOG_INFO(Vulkan, "Starting Setup (headless).");
+    setup_vulkan({});
+    if (log_setup) DS_LOG_INFO(Vulkan, "Finished Setup.");
 
-    float main_scale = SDL_GetDisplayContentScale(SDL_GetPrimaryDisplay());
-    if (log_setup) println("[   SDL] Info: main_scale = {}", main_scale);
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating offscreen render targets");
+    g_WD = &g_MainWindowData;
+    setup_headless_target(g_WD, g_HeadlessWidth, g_HeadlessHeight);
+}
 
+void setup_windowed(float main_scale) {
     g_Window = SDL_CreateWindow(
         "VulkanEngine 2.0",
         static_cast<int>(Constants::window_width * main_scale),
         static_cast<int>(Constants::window_height * main_scale),
         Constants::window_flags);
     if (!g_Window) {
-        if (log_setup) println("[   SDL] Error: SDL_CreateWindow(): {}", SDL_GetError());
+        if (log_setup) DS_LOG_ERROR(SDL, "SDL_CreateWindow(): {}", SDL_GetError());
         abort();
     }
 
     std::vector<Extension> extensions = Vulkan::get_sdl_extensions();
-    if (log_setup) println("[Vulkan] Info: There are {} SDL extensions", extensions.size());
+    if (log_setup) DS_LOG_INFO(Vulkan, "There are {} SDL extensions", extensions.size());
     for (const auto &ext : extensions) {
-        if (log_setup) println("[Vulkan] Info: \t{}", ext);
+        if (log_setup) DS_LOG_INFO(Vulkan, "\t{}", ext);
     }
 
-    if (log_setup) println("[Vulkan] Info: Starting Setup.");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Starting Setup.");
     setup_vulkan(extensions);
-    if (log_setup) println("[Vulkan] Info: Finished Setup.");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Finished Setup.");
 
-    if (log_setup) println("[Vulkan] Info: Creating Window Surfaces");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating Window Surfaces");
     VkSurfaceKHR surface;
     if (SDL_Vulkan_CreateSurface(g_Window, g_Instance, g_Allocator, &surface) == 0) {
-        if (log_setup) println(stderr, "Failed to create Vulkan Surface.");
+        if (log_setup) DS_LOG_ERROR(Vulkan, "Failed to create Vulkan Surface.");
         abort();
     }
-    if (log_setup) println("[Vulkan] Info: Creating Framebuffers");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Creating Framebuffers");
     int w, h;
-    SDL_GetWindowSize(g_Window, &w, &h);
+    SDL_GetWindowSizeInPixels(g_Window, &w, &h);
     g_WD = &g_MainWindowData;
 
-    if (log_setup) println("[Vulkan] Info: Starting Window Setup");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Starting Window Setup");
     { // Vulkan Window Setup
         setup_vulkan_window(g_WD, surface, w, h);
 
         SDL_SetWindowPosition(g_Window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
         SDL_ShowWindow(g_Window);
-        if (log_setup) println("[Vulkan] Info: Finished Window Setup");
+        if (log_setup) DS_LOG_INFO(Vulkan, "Finished Window Setup");
     } // Vulkan Window Setup
+}
+
+void setup() {
+    if (log_setup) DS_LOG_INFO(Jobs, "Starting job system");
+    Jobs::setup();
 
-    if (log_setup) println("[ IMGUI] Info: Setting up Context");
+    float main_scale = 1.0f;
+    if (g_Headless) {
+        setup_headless();
+    } else {
+        if (!SDL_Init(SDL_INIT_VIDEO)) {
+            if (log_setup) DS_LOG_ERROR(SDL, "SDL_Init(): {}", SDL_GetError());
+            abort();
+        }
+
+        main_scale = SDL_GetDisplayContentScale(SDL_GetPrimaryDisplay());
+        if (log_setup) DS_LOG_INFO(SDL, "main_scale = {}", main_scale);
+
+        setup_windowed(main_scale);
+    }
+
+    if (log_setup) DS_LOG_INFO(ImGui, "Setting up Context");
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     g_IO = &ImGui::GetIO();
     g_IO->ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
     ImGui::StyleColorsDark();
 
-    if (log_setup) println("[ IMGUI] Info: Setting up scaling");
+    if (log_setup) DS_LOG_INFO(ImGui, "Setting up scaling");
     ImGuiStyle &style = ImGui::GetStyle();
     style.ScaleAllSizes(main_scale);
     style.FontScaleDpi = main_scale;
 
-    if (log_setup) println("[Render] Info: Setting up Backends");
-    ImGui_ImplSDL3_InitForVulkan(g_Window);
+    if (log_setup) DS_LOG_INFO(Render, "Setting up Backends");
+    if (!g_Headless) ImGui_ImplSDL3_InitForVulkan(g_Window);
     ImGui_ImplVulkan_InitInfo init_info{
         .ApiVersion = VK_API_VERSION_1_3,
         .Instance = g_Instance,
@@ -431,66 +899,152 @@ void setup() {
         .DescriptorPool = g_DescriptorPool,
         .RenderPass = g_WD->RenderPass,
         .MinImageCount = g_MinImageCount,
-        .ImageCount = g_WD->ImageCount,
+        .ImageCount = std::max(g_WD->ImageCount, g_FramesInFlight), // ImGui keeps one vertex buffer per frame in flight
         .MSAASamples = VK_SAMPLE_COUNT_1_BIT,
         .PipelineCache = g_PipelineCache,
         .Subpass = 0,
+        .UseDynamicRendering = g_DynamicRendering,
+        .PipelineRenderingCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &g_WD->SurfaceFormat.format,
+            .depthAttachmentFormat = Depth::g_Format,
+        },
         .Allocator = g_Allocator,
         .CheckVkResultFn = Vulkan::check,
     };
+    // ImGui_ImplVulkan_Init and the renderers' setup build the pipelines, which is what the pipeline cache speeds up
+    auto pipeline_start = std::chrono::steady_clock::now();
     ImGui_ImplVulkan_Init(&init_info);
+    Meshes::setup(g_WD);
+    Sprites::setup(g_WD);
+    ShaderRegistry::start_hot_reload();
+    double pipeline_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipeline_start).count();
+    DS_LOG_INFO(Vulkan, "Pipeline creation took {:.3f} ms ({} start)", pipeline_ms, PipelineCache::g_Warm ? "warm" : "cold");
 }
 
 void cleanup() {
     Vulkan::check(vkDeviceWaitIdle(g_Device));
     ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplSDL3_Shutdown();
+    if (!g_Headless) ImGui_ImplSDL3_Shutdown();
     ImGui::DestroyContext();
+    destroy_frames();
+    Recording::cleanup();
+    Sprites::cleanup();
+    Meshes::cleanup();
+    ShaderRegistry::cleanup();
+    RenderGraph::destroy(g_FrameGraph);
+    Assets::cleanup();
 
-    if (log_setup) println("[Vulkan] Info: Starting cleanup.");
-    {
-        auto f_vkDestroyDebugReportCallbackEXT = reinterpret_cast<PFN_vkDestroyDebugReportCallbackEXT>(
-            vkGetInstanceProcAddr(g_Instance, Vulkan::Strings::vkDestroyDebugReportCallbackEXT));
-        if (f_vkDestroyDebugReportCallbackEXT) {
-            f_vkDestroyDebugReportCallbackEXT(g_Instance, g_DebugReport, g_Allocator);
-            g_DebugReport = nullptr;
-        }
+    if (log_setup) DS_LOG_INFO(Vulkan, "Starting cleanup.");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Cleaning up vulkan window");
+    if (g_Headless) {
+        destroy_headless_target(&g_MainWindowData);
+    } else {
+        // Retired swapchains sit in the deletion queue and have to go before the surface
+        DeletionQueue::flush();
+        Swapchain::destroy(&g_MainWindowData);
     }
 
-    if (log_setup) println("[Vulkan] Info: Cleaning up vulkan window");
-    ImGui_ImplVulkanH_DestroyWindow(g_Instance, g_Device, &g_MainWindowData, g_Allocator);
-
+    DeletionQueue::flush();
+    Depth::destroy();
+    Bindless::cleanup();
+    Compute::cleanup();
+    Transfer::cleanup();
+    Memory::cleanup();
+    PipelineCache::save_and_destroy();
+    Profiler::destroy_gpu();
     vkDestroyDescriptorPool(g_Device, g_DescriptorPool, g_Allocator);
     vkDestroyDevice(g_Device, g_Allocator);
+    // Last, so leaks reported by vkDestroyDevice still reach the messenger
+    Validation::cleanup();
     vkDestroyInstance(g_Instance, g_Allocator);
-    if (log_setup) println("[Vulkan] Info: Finished cleanup.");
+    if (log_setup) DS_LOG_INFO(Vulkan, "Finished cleanup.");
 
-    if (log_setup) println("[   SDL] Info: Starting Cleanup");
+    Jobs::cleanup();
+
+    if (g_Headless) return;
+    if (log_setup) DS_LOG_INFO(SDL, "Starting Cleanup");
     SDL_DestroyWindow(g_Window);
     SDL_Quit();
-    if (log_setup) println("[   SDL] Info: FinishedCleanup");
+    if (log_setup) DS_LOG_INFO(SDL, "FinishedCleanup");
+}
+
+// The SDL backend normally feeds ImGui the display size and delta time, headless has to do it itself
+void headless_new_frame() {
+    using Clock = std::chrono::steady_clock;
+    static Clock::time_point last_time = Clock::now();
+    Clock::time_point now = Clock::now();
+    float delta_time = std::chrono::duration<float>(now - last_time).count();
+    last_time = now;
+
+    g_IO->DisplaySize = ImVec2(static_cast<float>(g_WD->Width), static_cast<float>(g_WD->Height));
+    g_IO->DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
+    g_IO->DeltaTime = delta_time > 0.0f ? delta_time : 1.0f / 60.0f;
+}
+
+// Counts rendered frames, logs frames/s once per interval in headless mode and stops the loop at g_FrameLimit
+void report_frame_rate() {
+    using Clock = std::chrono::steady_clock;
+    static const Clock::time_point start_time = Clock::now();
+    static Clock::time_point interval_start = start_time;
+    static uint64_t total_frames = 0;
+    static uint64_t interval_frames = 0;
+    ++total_frames;
+    ++interval_frames;
+
+    Clock::time_point now = Clock::now();
+    double interval_s = std::chrono::duration<double>(now - interval_start).count();
+    if (g_Headless && interval_s >= Constants::frame_rate_report_interval_s) {
+        double fps = static_cast<double>(interval_frames) / interval_s;
+        if (Sprites::g_LastCount > 0) {
+            DS_LOG_INFO(Render, "{:.1f} frames/s ({:.3f} ms/frame), {:.1f} sprites/ms", fps, 1000.0 / fps,
+                Sprites::g_LastCount * fps / 1000.0);
+        } else {
+            DS_LOG_INFO(Render, "{:.1f} frames/s ({:.3f} ms/frame)", fps, 1000.0 / fps);
+        }
+        interval_start = now;
+        interval_frames = 0;
+    }
+
+    if (g_FrameLimit != 0 && total_frames >= g_FrameLimit) {
+        double total_s = std::chrono::duration<double>(now - start_time).count();
+        DS_LOG_INFO(Render, "Rendered {} frames in {:.3f} s, average {:.1f} frames/s",
+            total_frames, total_s, static_cast<double>(total_frames) / total_s);
+        g_IsRunning = false;
+    }
 }
 
+// Rebuilds at most once per frame, driven by resize events, present mode switches and OUT_OF_DATE /
+// SUBOPTIMAL results. The old swapchain is passed as oldSwapchain and retired through the deletion
+// queue, so frames still in flight on it are not waited for.
 void recreate_swapchains_if_necessary() {
-    int fb_width, fb_height;
-    SDL_GetWindowSize(g_Window, &fb_width, &fb_height);
-    bool positive_size = (fb_width > 0) && (fb_height > 0);
-    bool window_wrong_size = g_WD->Width != fb_width || g_WD->Height != fb_height;
-    if (positive_size && (g_SwapChainRebuild || window_wrong_size)) {
-        ImGui_ImplVulkan_SetMinImageCount(g_MinImageCount);
-        ImGui_ImplVulkanH_CreateOrResizeWindow(
-            g_Instance,
-            g_PhysicalDevice,
-            g_Device,
-            &g_MainWindowData,
-            g_QueueFamily,
-            g_Allocator,
-            fb_width,
-            fb_height,
-            g_MinImageCount);
-        g_MainWindowData.FrameIndex = 0;
-        g_SwapChainRebuild = false;
+    DS_PROFILE_SCOPE("recreate_swapchains_if_necessary");
+    if (Present::g_ModeChanged) {
+        // create_or_resize picks up wd->PresentMode, so a mode switch is just a rebuild
+        g_MainWindowData.PresentMode = Present::select();
+        DS_LOG_INFO(Vulkan, "Switching PresentMode to {}", g_MainWindowData.PresentMode);
+        Present::g_ModeChanged = false;
+        Present::reset_interval();
+        g_SwapChainRebuild = true;
     }
+    if (g_ResizePending) {
+        g_ResizePending = false;
+        if (g_PendingWidth != g_WD->Width || g_PendingHeight != g_WD->Height) g_SwapChainRebuild = true;
+    }
+    if (!g_SwapChainRebuild) return;
+
+    int fb_width, fb_height;
+    SDL_GetWindowSizeInPixels(g_Window, &fb_width, &fb_height);
+    if (fb_width <= 0 || fb_height <= 0) return; // Minimized, retry once the window has a size again
+
+    auto rebuild_start = std::chrono::steady_clock::now();
+    Swapchain::create_or_resize(&g_MainWindowData, fb_width, fb_height);
+    g_SwapChainRebuild = false;
+    float rebuild_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - rebuild_start).count();
+    Present::record_rebuild(rebuild_ms);
+    DS_LOG_INFO(Vulkan, "Swapchain rebuilt at {}x{} in {:.3f} ms ({})", g_MainWindowData.Width, g_MainWindowData.Height,
+        rebuild_ms, g_DynamicRendering ? "dynamic rendering" : "render pass");
 }
 
 } // namespace DS::Engine
\ No newline at end of file
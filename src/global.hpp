@@ -20,11 +20,16 @@ using namespace DS;
 
 VkAllocationCallbacks *g_Allocator = nullptr;
 VkInstance g_Instance = VK_NULL_HANDLE;
-VkDebugReportCallbackEXT g_DebugReport = VK_NULL_HANDLE;
 VkPhysicalDevice g_PhysicalDevice = VK_NULL_HANDLE;
 VkDevice g_Device = VK_NULL_HANDLE;
 uint32_t g_QueueFamily = Constants::queue_familily_not_init;
 VkQueue g_Queue = VK_NULL_HANDLE;
+uint32_t g_TransferQueueFamily = Constants::queue_familily_not_init;
+VkQueue g_TransferQueue = VK_NULL_HANDLE; // Same as g_Queue if there is no transfer-only family
+uint32_t g_ComputeQueueFamily = Constants::queue_familily_not_init;
+VkQueue g_ComputeQueue = VK_NULL_HANDLE; // Same as g_Queue without async compute
+bool g_TimelineSemaphores = false;
+bool g_Synchronization2 = false;
 VkDescriptorPool g_DescriptorPool = VK_NULL_HANDLE;
 VkPipelineCache g_PipelineCache = VK_NULL_HANDLE;
 
@@ -34,9 +39,37 @@ ImGui_ImplVulkanH_Window g_MainWindowData;
 ImGui_ImplVulkanH_Window *g_WD = nullptr;
 constexpr uint32_t g_MinImageCount = 2;
 bool g_SwapChainRebuild = false;
+// Latest drawable size from SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED, a burst of resize events during one
+// frame collapses into a single rebuild at the last size
+bool g_ResizePending = false;
+int g_PendingWidth = 0;
+int g_PendingHeight = 0;
+// vkCmdBeginRendering instead of render passes and framebuffers, requested with --dynamic-rendering
+// and cleared again in setup_vulkan if the device doesn't support it
+bool g_DynamicRendering = false;
+
+// One slot of the frames-in-flight ring, owned by the engine rather than tied to a swapchain image.
+// The frame's contents are recorded into secondaries from the per-thread pools in DS::Recording.
+struct FrameContext {
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE; // primary, recorded after acquire
+    VkFence fence = VK_NULL_HANDLE;
+    VkSemaphore image_acquired = VK_NULL_HANDLE;
+    uint64_t submitted_frame = 0; // g_FrameNumber of the last submit that signals `fence`
+};
+std::vector<FrameContext> g_Frames;
+uint32_t g_FramesInFlight = Constants::default_frames_in_flight;
+uint32_t g_FrameSlot = 0;
+uint64_t g_FrameNumber = 1; // Frame being recorded, starts at 1 so 0 means "never submitted"
 
 ImGuiIO *g_IO;
 
 bool g_IsRunning = true;
 
+// Headless mode renders into an engine-owned ring of offscreen images instead of a swapchain
+bool g_Headless = false;
+int g_HeadlessWidth = Constants::window_width; // A replay renders at the captured size
+int g_HeadlessHeight = Constants::window_height;
+uint32_t g_FrameLimit = 0;
+
 glm::vec4 g_ClearColor{0.45f, 0.55f, 0.60f, 1.0f};
\ No newline at end of file
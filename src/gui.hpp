@@ -14,11 +14,219 @@
 #include <SDL3/SDL_version.h>
 #include <SDL3/SDL_vulkan.h>
 
+#include "assets.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "host_allocator.hpp"
+#include "memory.hpp"
+#include "meshes.hpp"
+#include "pacing.hpp"
+#include "present.hpp"
+#include "profiler.hpp"
+#include "shader_registry.hpp"
+#include "transfer.hpp"
+#include "validation.hpp"
+
 namespace DS::GUI {
+void present_mode() {
+    ImGui::SeparatorText("Presentation");
+    ImGui::Text("Present mode %s, interval %.3f ms (avg %.3f ms)",
+        present_mode_to_string(g_MainWindowData.PresentMode).data(),
+        Present::g_IntervalHistoryMs[(Present::g_IntervalHead + Present::interval_history_size - 1) % Present::interval_history_size],
+        Present::average_interval_ms());
+
+    ImGui::Text("Swapchain rebuilds %u, last %.3f ms, avg %.3f ms (%s)", Present::g_RebuildCount,
+        Present::g_LastRebuildMs, Present::average_rebuild_ms(), g_DynamicRendering ? "dynamic rendering" : "render pass");
+
+    int latency_mode = static_cast<int>(Present::g_LatencyMode);
+    if (ImGui::Combo("Latency mode", &latency_mode, Present::latency_mode_names.data(), static_cast<int>(Present::latency_mode_names.size()))) {
+        Present::request_latency_mode(static_cast<Present::LatencyMode>(latency_mode));
+    }
+    if (ImGui::BeginCombo("Present mode", present_mode_to_string(g_MainWindowData.PresentMode).data())) {
+        for (VkPresentModeKHR mode : Present::g_SupportedModes) {
+            bool selected = mode == g_MainWindowData.PresentMode;
+            if (ImGui::Selectable(present_mode_to_string(mode).data(), selected)) Present::request_mode(mode);
+        }
+        ImGui::EndCombo();
+    }
+}
+
+void pacing() {
+    ImGui::SeparatorText("Pacing");
+    if (!g_Headless) ImGui::Checkbox("Render on demand", &Pacing::g_OnDemand);
+    int target_fps = static_cast<int>(Pacing::g_TargetFps);
+    if (ImGui::SliderInt("Target FPS (0 = off)", &target_fps, 0, static_cast<int>(Constants::max_target_fps))) {
+        Pacing::g_TargetFps = static_cast<uint32_t>(target_fps);
+    }
+    ImGui::Text("%.1f draws/s, main thread idle %.1f%%", Pacing::g_DrawsPerSecond, Pacing::g_CpuIdlePercent);
+    if (Profiler::enabled && Profiler::g_QueryPool != VK_NULL_HANDLE) {
+        ImGui::SameLine();
+        ImGui::Text(", GPU idle %.1f%%", Pacing::g_GpuIdlePercent);
+    }
+}
+
+void validation() {
+    ImGui::SeparatorText("Validation");
+    if (!Validation::enabled()) {
+        ImGui::TextUnformatted("Off (--validation errors|full|sync|gpu)");
+        return;
+    }
+    ImGui::Text("Tier %s, last frame %u errors, %u warnings, %u info", Validation::tier_name(Validation::g_Tier),
+        Validation::g_MessagesLastFrame[Validation::Error], Validation::g_MessagesLastFrame[Validation::Warning],
+        Validation::g_MessagesLastFrame[Validation::Info]);
+    // Only the messenger is measured here, the layer's own checks show up in the frame time
+    const float frame_ms = 1000.0f / g_IO->Framerate;
+    ImGui::Text("Messenger %.3f ms last frame (%.1f%% of the frame)", Validation::g_CallbackMsLastFrame,
+        frame_ms > 0.0f ? static_cast<float>(Validation::g_CallbackMsLastFrame) / frame_ms * 100.0f : 0.0f);
+}
+
 void debug() {
     ImGui::Begin("Hello, Window!");
     ImGui::ColorEdit3("clear color", (float *)&g_ClearColor);
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / g_IO->Framerate, g_IO->Framerate);
+    if (Compute::async()) {
+        ImGui::Text("Async compute on queue family %u, %u submits", g_ComputeQueueFamily, Compute::g_Submits);
+    } else {
+        ImGui::Text("Compute shares the graphics queue, %u submits", Compute::g_Submits);
+    }
+    if (Meshes::g_ObjectCount > 0) {
+        if (Meshes::g_DrawIndirectCount) {
+            ImGui::Text("Meshes: %u objects, %u visible after GPU culling", Meshes::g_ObjectCount, Meshes::g_LastVisible);
+        } else {
+            ImGui::Text("Meshes: %u objects, GPU culled (no draw count, one command per object)", Meshes::g_ObjectCount);
+        }
+    }
+    if (!Assets::g_Assets.empty()) {
+        ImGui::Text("Assets: %zu streaming, %zu loaded, %.1f MiB streamed", Assets::g_Queue.size(),
+            Assets::g_Assets.size() - Assets::g_Queue.size(), static_cast<double>(Assets::g_BytesStreamed) / (1024.0 * 1024.0));
+    }
+    if (ShaderRegistry::g_HotReload) {
+        ImGui::Text("Shader hot reload: %u reloads, last %.1f ms, %u failed compiles", ShaderRegistry::g_Reloads,
+            ShaderRegistry::g_LastReloadMs, ShaderRegistry::g_Failures);
+    }
+    if (!g_Headless) present_mode();
+    pacing();
+    validation();
+    ImGui::End();
+}
+
+void profiler() {
+    ImGui::Begin("Frame Timing");
+    if constexpr (!Profiler::enabled) {
+        ImGui::TextUnformatted("Profiler compiled out (VULKANENGINE_PROFILER=OFF)");
+        ImGui::End();
+        return;
+    }
+
+    const size_t latest = Profiler::latest();
+    const float frame_ms = Profiler::g_FrameHistoryMs[latest];
+    ImGui::Text("Frame %.3f ms   GPU %.3f ms", frame_ms, Profiler::g_GpuHistoryMs[latest]);
+    ImGui::Text("CPU  p50 %.3f   p95 %.3f   p99 %.3f ms",
+        Profiler::percentile(Profiler::g_FrameHistoryMs, 0.50f),
+        Profiler::percentile(Profiler::g_FrameHistoryMs, 0.95f),
+        Profiler::percentile(Profiler::g_FrameHistoryMs, 0.99f));
+    if (Profiler::g_QueryPool != VK_NULL_HANDLE) {
+        ImGui::Text("GPU  p50 %.3f   p95 %.3f   p99 %.3f ms",
+            Profiler::percentile(Profiler::g_GpuHistoryMs, 0.50f),
+            Profiler::percentile(Profiler::g_GpuHistoryMs, 0.95f),
+            Profiler::percentile(Profiler::g_GpuHistoryMs, 0.99f));
+    }
+
+    // Raw ring, not smoothed, so spikes stay visible
+    ImGui::PlotLines("##frame_times",
+        Profiler::g_FrameHistoryMs.data(),
+        static_cast<int>(Profiler::g_HistoryCount),
+        static_cast<int>(Profiler::g_HistoryCount < Profiler::history_size ? 0 : Profiler::g_HistoryHead),
+        "frame ms", 0.0f, Profiler::percentile(Profiler::g_FrameHistoryMs, 0.99f) * 1.5f,
+        ImVec2(0.0f, 80.0f));
+
+    ImGui::SeparatorText("Scopes");
+    for (const Profiler::Scope &scope : Profiler::g_Scopes) {
+        float scope_ms = scope.history_ms[latest];
+        float fraction = frame_ms > 0.0f ? scope_ms / frame_ms : 0.0f;
+        std::string label = std::format("{} {:.3f} ms", scope.name, scope_ms);
+        ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), label.c_str());
+    }
+    ImGui::End();
+}
+void memory() {
+    ImGui::Begin("Memory");
+    ImGui::Text("vkAllocateMemory calls live: %u / %u", Memory::g_DeviceAllocationCount, Memory::g_MaxDeviceAllocationCount);
+    ImGui::Text("Defragmentation moves: %u", Memory::g_DefragMoves);
+    ImGui::Text("Uploads: %.2f MiB in %u batches on queue family %u, staging ring %.1f / %.1f MiB in use",
+        static_cast<float>(Transfer::g_BytesUploaded) / (1024.0f * 1024.0f), Transfer::g_BatchesSubmitted, g_TransferQueueFamily,
+        static_cast<float>(Transfer::g_RingHead - Transfer::g_RingTail) / (1024.0f * 1024.0f),
+        static_cast<float>(Transfer::g_RingSize) / (1024.0f * 1024.0f));
+
+    constexpr float mib = 1024.0f * 1024.0f;
+    std::vector<Memory::HeapStats> stats = Memory::heap_stats();
+    if (ImGui::BeginTable("heaps", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Heap");
+        ImGui::TableSetupColumn("Size MiB");
+        ImGui::TableSetupColumn("Blocks");
+        ImGui::TableSetupColumn("Used / Reserved MiB");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableSetupColumn("Dedicated MiB");
+        ImGui::TableHeadersRow();
+        for (size_t heap = 0; heap < stats.size(); ++heap) {
+            const Memory::HeapStats &h = stats[heap];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu%s", heap, (h.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device)" : "");
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f", static_cast<float>(h.heap_size) / mib);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", h.block_count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f / %.2f", static_cast<float>(h.used_bytes) / mib, static_cast<float>(h.block_bytes) / mib);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", h.allocation_count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f (%u)", static_cast<float>(h.dedicated_bytes) / mib, h.dedicated_count);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText("Bindless descriptors");
+    if (!Bindless::g_Enabled) {
+        ImGui::TextUnformatted("Descriptor indexing not supported");
+    } else {
+        for (uint32_t i = 0; i < Bindless::kind_count; ++i) {
+            const Bindless::Table &t = Bindless::g_Tables[i];
+            ImGui::Text("%s: %u live, %u / %u slots touched", Bindless::kind_names[i], t.live, t.next_unused, t.capacity);
+        }
+    }
+
+    ImGui::SeparatorText("Host allocations (g_Allocator)");
+    if (HostAllocator::g_Mode == HostAllocator::Mode::Default) {
+        ImGui::TextUnformatted("Driver allocator, not tracked (--host-allocator tracking|pooled)");
+    } else {
+        constexpr float kib = 1024.0f;
+        ImGui::Text("Live %.1f KiB, peak %.1f KiB, driver internal %.1f KiB",
+            static_cast<float>(HostAllocator::g_LiveBytes.load()) / kib,
+            static_cast<float>(HostAllocator::g_PeakBytes.load()) / kib,
+            static_cast<float>(HostAllocator::g_InternalBytes.load()) / kib);
+        if (ImGui::BeginTable("host_scopes", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("Live KiB");
+            ImGui::TableSetupColumn("Allocs/frame");
+            ImGui::TableSetupColumn("Total allocs");
+            ImGui::TableHeadersRow();
+            for (uint32_t scope = 0; scope < HostAllocator::scope_count; ++scope) {
+                HostAllocator::ScopeStats stats = HostAllocator::scope_stats(scope);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(HostAllocator::scope_names[scope]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", static_cast<float>(stats.live_bytes) / kib);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(stats.allocations_last_frame));
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(stats.total_allocations));
+            }
+            ImGui::EndTable();
+        }
+    }
     ImGui::End();
 }
 } // namespace DS::GUI
\ No newline at end of file
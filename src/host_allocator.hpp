@@ -0,0 +1,230 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <optional>
+#include <print>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "global.hpp"
+#include "log.hpp"
+#include "util.hpp"
+
+using std::println, std::print;
+
+namespace DS::HostAllocator {
+// Backs g_Allocator. Every allocation carries a small header so frees and reallocations can be
+// attributed to their VkSystemAllocationScope without the driver telling us the size.
+enum class Mode {
+    Default,  // g_Allocator stays nullptr, the driver uses its own allocator
+    Tracking, // malloc/free with per-scope accounting
+    Pooled,   // Tracking, plus COMMAND and OBJECT scope served from thread-local size-class pools
+};
+
+constexpr uint32_t scope_count = 5; // VK_SYSTEM_ALLOCATION_SCOPE_COMMAND ... INSTANCE
+constexpr auto scope_names = std::to_array<const char *>({"Command", "Object", "Cache", "Device", "Instance"});
+
+constexpr size_t header_alignment = 16;
+constexpr auto size_classes = std::to_array<size_t>({32, 64, 128, 256, 512, 1024, 2048});
+constexpr uint16_t no_size_class = std::numeric_limits<uint16_t>::max();
+constexpr size_t slab_size = 64 * 1024;
+
+struct alignas(header_alignment) Header {
+    uint64_t size;       // Size the driver asked for
+    uint32_t offset;     // Distance from the malloc'd base to the user pointer
+    uint16_t scope;
+    uint16_t size_class; // no_size_class if not served from a pool
+};
+static_assert(sizeof(Header) == header_alignment);
+
+struct ScopeCounters {
+    std::atomic<int64_t> live_bytes{0};
+    std::atomic<uint64_t> total_allocations{0};
+    std::atomic<uint64_t> frame_allocations{0};
+};
+
+struct ScopeStats {
+    int64_t live_bytes;
+    uint64_t total_allocations;
+    uint64_t allocations_last_frame;
+};
+
+Mode g_Mode = Mode::Tracking;
+VkAllocationCallbacks g_Callbacks = {};
+std::array<ScopeCounters, scope_count> g_Scopes;
+std::atomic<int64_t> g_LiveBytes{0};
+std::atomic<int64_t> g_PeakBytes{0};
+std::atomic<int64_t> g_InternalBytes{0};
+std::array<uint64_t, scope_count> g_AllocationsLastFrame = {};
+
+// Freed chunks go onto the freeing thread's list; slabs are never returned to the system, which is
+// the point: steady-state COMMAND/OBJECT churn never reaches malloc.
+struct ThreadPool {
+    std::array<void *, size_classes.size()> free_lists = {};
+    uint8_t *slab = nullptr;
+    size_t slab_used = slab_size;
+};
+thread_local ThreadPool t_Pool;
+
+std::optional<uint16_t> size_class_for(size_t total) {
+    for (size_t i = 0; i < size_classes.size(); ++i) {
+        if (total <= size_classes[i]) return static_cast<uint16_t>(i);
+    }
+    return std::nullopt;
+}
+
+void *pool_allocate(uint16_t size_class) {
+    ThreadPool &pool = t_Pool;
+    if (void *chunk = pool.free_lists[size_class]) {
+        pool.free_lists[size_class] = *static_cast<void **>(chunk);
+        return chunk;
+    }
+    size_t chunk_size = size_classes[size_class];
+    if (pool.slab_used + chunk_size > slab_size) {
+        pool.slab = static_cast<uint8_t *>(std::malloc(slab_size));
+        if (!pool.slab) return nullptr;
+        pool.slab_used = 0;
+    }
+    void *chunk = pool.slab + pool.slab_used;
+    pool.slab_used += chunk_size;
+    return chunk;
+}
+
+void pool_free(void *chunk, uint16_t size_class) {
+    ThreadPool &pool = t_Pool;
+    *static_cast<void **>(chunk) = pool.free_lists[size_class];
+    pool.free_lists[size_class] = chunk;
+}
+
+Header *header_of(void *memory) {
+    return reinterpret_cast<Header *>(static_cast<uint8_t *>(memory) - sizeof(Header));
+}
+
+void account(uint32_t scope, int64_t bytes, bool is_allocation) {
+    g_Scopes[scope].live_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    int64_t live = g_LiveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (!is_allocation) return;
+    g_Scopes[scope].total_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_Scopes[scope].frame_allocations.fetch_add(1, std::memory_order_relaxed);
+    int64_t peak = g_PeakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !g_PeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+VKAPI_ATTR void *VKAPI_CALL allocate(void *user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    (void)user_data;
+    if (size == 0) return nullptr;
+    alignment = std::max(alignment, header_alignment);
+    uint32_t scope_index = std::min(static_cast<uint32_t>(scope), scope_count - 1);
+
+    uint8_t *base = nullptr;
+    uint16_t size_class = no_size_class;
+    bool poolable = g_Mode == Mode::Pooled && alignment == header_alignment &&
+                    (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND || scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (poolable) {
+        if (auto found = size_class_for(size + sizeof(Header))) {
+            size_class = *found;
+            base = static_cast<uint8_t *>(pool_allocate(size_class));
+        }
+    }
+    if (!base) {
+        size_class = no_size_class;
+        base = static_cast<uint8_t *>(std::malloc(size + sizeof(Header) + alignment));
+    }
+    if (!base) return nullptr;
+
+    uintptr_t user = (reinterpret_cast<uintptr_t>(base) + sizeof(Header) + alignment - 1) & ~(alignment - 1);
+    Header *header = reinterpret_cast<Header *>(user - sizeof(Header));
+    header->size = size;
+    header->offset = static_cast<uint32_t>(user - reinterpret_cast<uintptr_t>(base));
+    header->scope = static_cast<uint16_t>(scope_index);
+    header->size_class = size_class;
+    account(scope_index, static_cast<int64_t>(size), true);
+    return reinterpret_cast<void *>(user);
+}
+
+VKAPI_ATTR void VKAPI_CALL deallocate(void *user_data, void *memory) {
+    (void)user_data;
+    if (!memory) return;
+    Header *header = header_of(memory);
+    account(header->scope, -static_cast<int64_t>(header->size), false);
+    uint8_t *base = static_cast<uint8_t *>(memory) - header->offset;
+    if (header->size_class != no_size_class) {
+        pool_free(base, header->size_class);
+    } else {
+        std::free(base);
+    }
+}
+
+// The spec requires the same alignment as the original allocation, so a fresh allocation + copy is fine
+VKAPI_ATTR void *VKAPI_CALL reallocate(void *user_data, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    if (!original) return allocate(user_data, size, alignment, scope);
+    if (size == 0) {
+        deallocate(user_data, original);
+        return nullptr;
+    }
+    void *memory = allocate(user_data, size, alignment, scope);
+    if (!memory) return nullptr;
+    std::memcpy(memory, original, std::min<size_t>(size, header_of(original)->size));
+    deallocate(user_data, original);
+    return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL internal_allocation(void *user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope) {
+    (void)user_data, (void)type, (void)scope;
+    g_InternalBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL internal_free(void *user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope) {
+    (void)user_data, (void)type, (void)scope;
+    g_InternalBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+// Must run before the instance is created: objects have to be destroyed with the callbacks they
+// were created with, so the mode can't change afterwards.
+void install() {
+    if (g_Mode == Mode::Default) {
+        g_Allocator = nullptr;
+        DS_LOG_INFO(Vulkan, "Using the driver's host allocator");
+        return;
+    }
+    g_Callbacks.pUserData = nullptr;
+    g_Callbacks.pfnAllocation = allocate;
+    g_Callbacks.pfnReallocation = reallocate;
+    g_Callbacks.pfnFree = deallocate;
+    g_Callbacks.pfnInternalAllocation = internal_allocation;
+    g_Callbacks.pfnInternalFree = internal_free;
+    g_Allocator = &g_Callbacks;
+    DS_LOG_INFO(Vulkan, "Using the {} host allocator", g_Mode == Mode::Pooled ? "pooled" : "tracking");
+}
+
+// Call once per frame, rolls the per-frame allocation counters
+void begin_frame() {
+    if (g_Mode == Mode::Default) return;
+    for (uint32_t scope = 0; scope < scope_count; ++scope) {
+        g_AllocationsLastFrame[scope] = g_Scopes[scope].frame_allocations.exchange(0, std::memory_order_relaxed);
+    }
+}
+
+ScopeStats scope_stats(uint32_t scope) {
+    return {
+        .live_bytes = g_Scopes[scope].live_bytes.load(std::memory_order_relaxed),
+        .total_allocations = g_Scopes[scope].total_allocations.load(std::memory_order_relaxed),
+        .allocations_last_frame = g_AllocationsLastFrame[scope]};
+}
+
+std::optional<Mode> parse_mode(std::string_view name) {
+    if (name == "default") return Mode::Default;
+    if (name == "tracking") return Mode::Tracking;
+    if (name == "pooled") return Mode::Pooled;
+    return std::nullopt;
+}
+} // namespace DS::HostAllocator
@@ -16,29 +16,35 @@
 
 #include <vulkan/vulkan.h>
 
+#include "log.hpp"
+
 namespace DS::IO {
 void handle_event(SDL_Event &event) {
     ImGui_ImplSDL3_ProcessEvent(&event);
     if (event.type == SDL_EVENT_QUIT) {
-        println("[   SDL] Info: Got SDL_EVENT_QUIT event");
+        DS_LOG_INFO(SDL, "Got SDL_EVENT_QUIT event");
         g_IsRunning = false;
     }
     SDL_WindowID window_id = SDL_GetWindowID(g_Window);
     if (event.type == SDL_EVENT_WINDOW_CLOSE_REQUESTED && event.window.windowID == window_id) {
-        println(
-            "[   SDL] Info: Get SDL_EVENT_WINDOW_CLOSE_REQUESTED on current window ({})",
+        DS_LOG_INFO(SDL, "Get SDL_EVENT_WINDOW_CLOSE_REQUESTED on current window ({})",
             window_id);
         g_IsRunning = false;
     }
+    if (event.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED && event.window.windowID == window_id) {
+        g_ResizePending = true;
+        g_PendingWidth = event.window.data1;
+        g_PendingHeight = event.window.data2;
+    }
 
     if (event.type == SDL_EVENT_KEY_DOWN) {
         switch (event.key.key) {
         case SDLK_ESCAPE:
-            println("[   SDL] Info: ESC pressed, closing window");
+            DS_LOG_INFO(SDL, "ESC pressed, closing window");
             g_IsRunning = false;
             break;
         default:
-            // println("[   SDL] Info: Unknown key (keycode={}) pressed", event.key.key);
+            // DS_LOG_INFO(SDL, "Unknown key (keycode={}) pressed", event.key.key);
             break;
         }
     }
@@ -0,0 +1,440 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <limits>
+#include <format>
+#include <mutex>
+#include <new>
+#include <print>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "log.hpp"
+#include "util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Jobs {
+// Work-stealing job system. Every thread (the main thread is thread 0) owns a Chase-Lev deque: it
+// pushes and pops its own jobs at the bottom, idle threads steal from the top of the others.
+// Jobs live in a frame-scoped arena with their functor stored inline, so spawning never touches
+// the heap; the arena is rewound by begin_frame(), so jobs must not outlive the frame.
+// Waiting is continuation based: wait() keeps executing other jobs until the counter drops to zero
+// instead of blocking the thread, and then() schedules a job to run once a counter reaches zero.
+// Main-thread-only jobs (anything touching SDL or ImGui state) go to a separate queue that only
+// thread 0 drains, from wait() and run_main_thread_jobs().
+struct Job;
+
+// Number of unfinished jobs attached to it, plus the jobs to start once it reaches zero. The final
+// decrement happens under `lock`, so a waiter that has seen zero and taken the lock once knows the
+// finishing thread is done with the counter and it may go out of scope.
+struct Counter {
+    std::atomic<int32_t> value{0};
+    std::atomic_flag lock;
+    Job *continuations = nullptr;
+};
+
+struct alignas(64) Job {
+    void (*invoke)(Job *job) = nullptr;
+    Counter *counter = nullptr;
+    Job *next = nullptr; // Link in a counter's continuation list
+    bool main_thread = false;
+    alignas(16) std::byte payload[Constants::job_payload_size];
+};
+
+// Fixed-capacity Chase-Lev deque (Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models")
+struct Deque {
+    static constexpr int64_t capacity = Constants::job_deque_capacity;
+    static_assert((capacity & (capacity - 1)) == 0, "job_deque_capacity must be a power of two");
+
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::array<std::atomic<Job *>, capacity> jobs = {};
+
+    // Owner only, false if full
+    bool push(Job *job) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= capacity) return false;
+        jobs[b & (capacity - 1)].store(job, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner only, LIFO
+    Job *pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job *job = jobs[b & (capacity - 1)].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last job, race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // Any thread, FIFO
+    Job *steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+        Job *job = jobs[t & (capacity - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+        return job;
+    }
+};
+
+constexpr uint32_t not_a_worker = std::numeric_limits<uint32_t>::max();
+
+uint32_t g_ThreadCount = 0; // 0 picks the hardware concurrency at setup
+std::vector<Deque *> g_Deques;
+std::vector<std::thread> g_Threads;
+thread_local uint32_t t_ThreadIndex = not_a_worker;
+
+std::mutex g_MainMutex;
+std::deque<Job *> g_MainJobs;
+std::atomic<uint32_t> g_MainJobCount{0};
+
+std::atomic<uint32_t> g_Signal{0}; // Bumped on every submit, idle workers sleep on it
+std::atomic<uint32_t> g_Sleepers{0};
+std::atomic<bool> g_Quit{false};
+
+std::byte *g_Arena = nullptr;
+std::atomic<size_t> g_ArenaHead{0};
+std::atomic<int64_t> g_Outstanding{0}; // Jobs created but not finished, begin_frame() requires zero
+
+bool g_Benchmark = false;
+
+uint32_t thread_index() {
+    return t_ThreadIndex;
+}
+
+void wake() {
+    g_Signal.fetch_add(1, std::memory_order_seq_cst);
+    if (g_Sleepers.load(std::memory_order_seq_cst) > 0) g_Signal.notify_all();
+}
+
+Job *allocate_job() {
+    size_t offset = g_ArenaHead.fetch_add(sizeof(Job), std::memory_order_relaxed);
+    if (offset + sizeof(Job) > Constants::job_arena_size) {
+        DS_LOG_ERROR(Jobs, "Job arena exhausted ({} bytes), too many jobs in one frame", Constants::job_arena_size);
+        abort();
+    }
+    return new (g_Arena + offset) Job();
+}
+
+template <typename F>
+Job *create(F &&function, Counter *counter, bool main_thread) {
+    using Functor = std::decay_t<F>;
+    static_assert(sizeof(Functor) <= Constants::job_payload_size, "Job functor too large, capture a pointer to the data instead");
+    static_assert(alignof(Functor) <= 16);
+    static_assert(std::is_trivially_destructible_v<Functor>, "Jobs are never destroyed, captures must be trivially destructible");
+    Job *job = allocate_job();
+    new (job->payload) Functor(std::forward<F>(function));
+    job->invoke = [](Job *self) { (*std::launder(reinterpret_cast<Functor *>(self->payload)))(); };
+    job->counter = counter;
+    job->main_thread = main_thread;
+    if (counter) counter->value.fetch_add(1, std::memory_order_relaxed);
+    g_Outstanding.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+void lock_counter(Counter &counter) {
+    while (counter.lock.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void unlock_counter(Counter &counter) {
+    counter.lock.clear(std::memory_order_release);
+}
+
+void submit(Job *job);
+
+// True once the counter reached zero and the thread that got it there has let go of it
+bool done(Counter &counter) {
+    if (counter.value.load(std::memory_order_acquire) != 0) return false;
+    lock_counter(counter);
+    unlock_counter(counter);
+    return true;
+}
+
+void decrement(Counter &counter) {
+    int32_t value = counter.value.load(std::memory_order_relaxed);
+    for (;;) {
+        if (value != 1) {
+            if (counter.value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel)) return;
+            continue;
+        }
+        lock_counter(counter);
+        if (!counter.value.compare_exchange_strong(value, 0, std::memory_order_acq_rel)) {
+            unlock_counter(counter);
+            continue;
+        }
+        Job *continuation = counter.continuations;
+        counter.continuations = nullptr;
+        unlock_counter(counter);
+        while (continuation) {
+            Job *next = continuation->next;
+            submit(continuation);
+            continuation = next;
+        }
+        return;
+    }
+}
+
+void execute(Job *job) {
+    job->invoke(job);
+    if (job->counter) decrement(*job->counter);
+    g_Outstanding.fetch_sub(1, std::memory_order_release);
+}
+
+void submit(Job *job) {
+    if (job->main_thread) {
+        {
+            std::lock_guard lock(g_MainMutex);
+            g_MainJobs.push_back(job);
+        }
+        g_MainJobCount.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    if (t_ThreadIndex == not_a_worker) {
+        DS_LOG_ERROR(Jobs, "Jobs can only be spawned from the main thread or a worker");
+        abort();
+    }
+    if (!g_Deques[t_ThreadIndex]->push(job)) {
+        // Deque full: run it right away rather than fail, the job is still correct, just not parallel
+        execute(job);
+        return;
+    }
+    wake();
+}
+
+Job *pop_main_job() {
+    if (g_MainJobCount.load(std::memory_order_acquire) == 0) return nullptr;
+    std::lock_guard lock(g_MainMutex);
+    if (g_MainJobs.empty()) return nullptr;
+    Job *job = g_MainJobs.front();
+    g_MainJobs.pop_front();
+    g_MainJobCount.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+Job *find_job() {
+    uint32_t self = t_ThreadIndex;
+    if (self == 0) {
+        if (Job *job = pop_main_job()) return job;
+    }
+    if (Job *job = g_Deques[self]->pop()) return job;
+    for (uint32_t i = 1; i < g_ThreadCount; ++i) {
+        uint32_t victim = (self + i) % g_ThreadCount;
+        if (Job *job = g_Deques[victim]->steal()) return job;
+    }
+    return nullptr;
+}
+
+void worker_main(uint32_t index) {
+    t_ThreadIndex = index;
+    uint32_t idle_spins = 0;
+    while (!g_Quit.load(std::memory_order_acquire)) {
+        if (Job *job = find_job()) {
+            execute(job);
+            idle_spins = 0;
+            continue;
+        }
+        if (++idle_spins < Constants::job_idle_spins) {
+            std::this_thread::yield();
+            continue;
+        }
+        // Anything submitted after `seen` was read bumps g_Signal, so the wait can't miss it
+        uint32_t seen = g_Signal.load(std::memory_order_seq_cst);
+        if (Job *job = find_job()) {
+            execute(job);
+            idle_spins = 0;
+            continue;
+        }
+        g_Sleepers.fetch_add(1, std::memory_order_seq_cst);
+        if (!g_Quit.load(std::memory_order_acquire)) g_Signal.wait(seen, std::memory_order_seq_cst);
+        g_Sleepers.fetch_sub(1, std::memory_order_seq_cst);
+        idle_spins = 0;
+    }
+}
+
+// Spawns `function` as a job, `counter` (optional) is incremented now and decremented when it finishes
+template <typename F>
+void run(F &&function, Counter *counter = nullptr) {
+    submit(create(std::forward<F>(function), counter, false));
+}
+
+// Like run(), but only the main thread will execute it
+template <typename F>
+void run_on_main(F &&function, Counter *counter = nullptr) {
+    submit(create(std::forward<F>(function), counter, true));
+}
+
+// Runs `function` as a job once `dependency` reaches zero, immediately if it already has
+template <typename F>
+void then(Counter &dependency, F &&function, Counter *counter = nullptr, bool main_thread = false) {
+    Job *job = create(std::forward<F>(function), counter, main_thread);
+    lock_counter(dependency);
+    if (dependency.value.load(std::memory_order_acquire) != 0) {
+        job->next = dependency.continuations;
+        dependency.continuations = job;
+        unlock_counter(dependency);
+        return;
+    }
+    unlock_counter(dependency);
+    submit(job);
+}
+
+// Executes other jobs until `counter` reaches zero, the calling thread never blocks
+void wait(Counter &counter) {
+    while (!done(counter)) {
+        if (Job *job = find_job()) {
+            execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Splits [0, count) into batches of `batch_size` and calls function(begin, end) for each in parallel
+template <typename F>
+void parallel_for(uint32_t count, uint32_t batch_size, F function) {
+    Counter counter;
+    for (uint32_t begin = 0; begin < count; begin += batch_size) {
+        uint32_t end = std::min(count, begin + batch_size);
+        run([=] { function(begin, end); }, &counter);
+    }
+    wait(counter);
+}
+
+// Main thread: runs queued main-thread-only jobs without waiting on anything
+void run_main_thread_jobs() {
+    while (Job *job = pop_main_job()) execute(job);
+}
+
+void setup() {
+    if (g_ThreadCount == 0) {
+        g_ThreadCount = std::clamp(std::thread::hardware_concurrency(), 1u, Constants::max_job_threads);
+    }
+    g_Arena = static_cast<std::byte *>(::operator new(Constants::job_arena_size, std::align_val_t{alignof(Job)}));
+    g_ArenaHead = 0;
+    for (uint32_t i = 0; i < g_ThreadCount; ++i) g_Deques.push_back(new Deque());
+    t_ThreadIndex = 0;
+    g_Quit = false;
+    for (uint32_t i = 1; i < g_ThreadCount; ++i) g_Threads.emplace_back(worker_main, i);
+    DS_LOG_INFO(Jobs, "Started job system with {} threads", g_ThreadCount);
+}
+
+void cleanup() {
+    g_Quit.store(true, std::memory_order_release);
+    g_Signal.fetch_add(1, std::memory_order_seq_cst);
+    g_Signal.notify_all();
+    for (std::thread &thread : g_Threads) thread.join();
+    g_Threads.clear();
+    for (Deque *deque : g_Deques) delete deque;
+    g_Deques.clear();
+    ::operator delete(g_Arena, std::align_val_t{alignof(Job)});
+    g_Arena = nullptr;
+}
+
+// Main thread, once per frame: finishes stragglers and rewinds the job arena
+void begin_frame() {
+    while (g_Outstanding.load(std::memory_order_acquire) > 0) {
+        if (Job *job = find_job()) {
+            execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    g_ArenaHead.store(0, std::memory_order_relaxed);
+}
+
+// Micro-benchmarks with every worker running: spawn cost on the main thread, how long a job pushed
+// by the main thread waits before another thread steals it, and how long wait() takes to return
+// after the last job of a contended batch finishes.
+void benchmark() {
+    using Clock = std::chrono::steady_clock;
+    auto ns_since = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    };
+    const uint32_t jobs = Constants::bench_jobs_per_round;
+    DS_LOG_INFO(Jobs, "Job system benchmark, {} threads, {} jobs per round, best of {} rounds",
+        g_ThreadCount, jobs, Constants::bench_jobs_rounds);
+
+    double best_spawn_ns = std::numeric_limits<double>::max();
+    double best_steal_ns = std::numeric_limits<double>::max();
+    double best_wait_ns = std::numeric_limits<double>::max();
+    for (uint32_t round = 0; round < Constants::bench_jobs_rounds; ++round) {
+        { // Spawn: create and push empty jobs
+            begin_frame();
+            Counter counter;
+            auto start = Clock::now();
+            for (uint32_t i = 0; i < jobs; ++i) run([] {}, &counter);
+            best_spawn_ns = std::min(best_spawn_ns, ns_since(start) / jobs);
+            wait(counter);
+        }
+        if (g_ThreadCount > 1) { // Steal: the main thread only pushes, every job is stolen
+            begin_frame();
+            Counter counter;
+            std::atomic<int64_t> total_ns{0};
+            std::atomic<uint32_t> stolen{0};
+            for (uint32_t i = 0; i < jobs; ++i) {
+                auto pushed = Clock::now();
+                run([pushed, &total_ns, &stolen] {
+                    if (thread_index() == 0) return;
+                    total_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - pushed).count(), std::memory_order_relaxed);
+                    stolen.fetch_add(1, std::memory_order_relaxed);
+                },
+                    &counter);
+            }
+            while (!done(counter)) std::this_thread::yield();
+            uint32_t count = stolen.load();
+            if (count > 0) best_steal_ns = std::min(best_steal_ns, static_cast<double>(total_ns.load()) / count);
+        }
+        { // Wait: every thread spawns nested jobs against one counter, time from the last finish to wait() returning
+            begin_frame();
+            Counter counter;
+            std::atomic<int64_t> last_finish{0};
+            auto stamp = [&last_finish] {
+                int64_t now = Clock::now().time_since_epoch().count();
+                int64_t previous = last_finish.load(std::memory_order_relaxed);
+                while (now > previous && !last_finish.compare_exchange_weak(previous, now, std::memory_order_relaxed)) {
+                }
+            };
+            for (uint32_t i = 0; i < g_ThreadCount; ++i) {
+                run([&counter, stamp, jobs, threads = g_ThreadCount] {
+                    for (uint32_t j = 0; j < jobs / threads; ++j) run(stamp, &counter);
+                    stamp();
+                },
+                    &counter);
+            }
+            wait(counter);
+            int64_t returned = Clock::now().time_since_epoch().count();
+            auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::duration(returned - last_finish.load()));
+            best_wait_ns = std::min(best_wait_ns, static_cast<double>(latency.count()));
+        }
+    }
+    begin_frame();
+    DS_LOG_INFO(Jobs, "\tspawn {:10.1f} ns/job", best_spawn_ns);
+    if (g_ThreadCount > 1) DS_LOG_INFO(Jobs, "\tsteal {:10.1f} ns from push to start on a thief", best_steal_ns);
+    DS_LOG_INFO(Jobs, "\twait  {:10.1f} ns from last completion to wait() returning", best_wait_ns);
+}
+} // namespace DS::Jobs
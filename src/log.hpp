@@ -0,0 +1,409 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+#include "util.hpp"
+
+// Lowest level compiled in: 0 debug, 1 info, 2 warning, 3 error. See VULKANENGINE_LOG_LEVEL in CMakeLists.txt
+#ifndef DS_LOG_LEVEL
+#define DS_LOG_LEVEL 1
+#endif
+
+namespace DS::Log {
+// Asynchronous logger behind the DS_LOG_* macros. A log site doesn't format: it copies its arguments
+// (strings by value) into a slot of a lock-free multi-producer ring, and a writer thread formats and
+// writes them. Levels below DS_LOG_LEVEL compile to nothing, every site is limited to a burst of
+// messages per second, and the writer folds identical consecutive lines into a repeat count.
+// DS_LOG_ERROR waits until the message is written, it is often followed by abort(); DS_LOG_ERROR_ASYNC
+// doesn't. Errors are written inline rather than dropped when the ring is full. Before start() and after stop() messages are written inline.
+enum class Level : uint8_t {
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+constexpr Level compiled_level = static_cast<Level>(DS_LOG_LEVEL);
+
+// Named after the log prefixes, which are padded to six characters
+enum class Channel : uint8_t {
+    Vulkan,
+    SDL,
+    ImGui,
+    Render,
+    Shader,
+    Assets,
+    Jobs,
+    CLI,
+    Replay,
+    Global,
+    Bench,
+};
+
+constexpr std::string_view channel_prefix(Channel channel) {
+    switch (channel) {
+    case Channel::Vulkan:
+        return "Vulkan";
+    case Channel::SDL:
+        return "   SDL";
+    case Channel::ImGui:
+        return " ImGui";
+    case Channel::Render:
+        return "Render";
+    case Channel::Shader:
+        return "Shader";
+    case Channel::Assets:
+        return "Assets";
+    case Channel::Jobs:
+        return "  Jobs";
+    case Channel::CLI:
+        return "   CLI";
+    case Channel::Replay:
+        return "Replay";
+    case Channel::Global:
+        return "Global";
+    case Channel::Bench:
+        return " Bench";
+    }
+    return "   Log";
+}
+
+constexpr std::string_view level_name(Level level) {
+    switch (level) {
+    case Level::Debug:
+        return "Debug";
+    case Level::Info:
+        return "Info";
+    case Level::Warning:
+        return "Warning";
+    case Level::Error:
+        return "Error";
+    }
+    return "?";
+}
+
+// Turns a slot's payload back into text, one instantiation per combination of argument types
+using FormatFn = void (*)(std::string &out, std::string_view format, const std::byte *payload);
+
+struct Slot {
+    std::atomic<uint64_t> sequence; // Ring position + 1 once published, + capacity once consumed
+    FormatFn format_fn;
+    const char *format; // The site's format string literal
+    uint32_t format_size;
+    Level level;
+    Channel channel;
+    alignas(8) std::array<std::byte, Constants::log_payload_size> payload;
+};
+
+// Per site rate limit state, a static in every DS_LOG expansion
+struct Site {
+    std::atomic<int64_t> window{-1}; // Second the count belongs to
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> suppressed{0};
+};
+
+std::unique_ptr<Slot[]> g_Slots;
+std::atomic<uint64_t> g_EnqueuePos{0};
+uint64_t g_DequeuePos = 0;           // Writer only
+std::atomic<uint64_t> g_Written{0};  // Records written, DS_LOG_ERROR waits on it
+std::atomic<uint64_t> g_Dropped{0};  // Ring full, below Error the hot thread never waits for room
+std::atomic<uint64_t> g_Suppressed{0}; // By the rate limit over the whole run
+std::atomic<bool> g_Running{false};
+std::atomic<bool> g_Stop{false};
+std::thread g_Writer;
+std::mutex g_InlineMutex;
+
+// Writer state: the last line and how often it repeated since
+std::string g_LastLine;
+FILE *g_LastStream = nullptr;
+uint64_t g_Repeats = 0;
+
+FILE *stream(Level level) {
+    return level >= Level::Warning ? stderr : stdout;
+}
+
+void append_prefix(std::string &line, Level level, Channel channel) {
+    std::format_to(std::back_inserter(line), "[{}] {}: ", channel_prefix(channel), level_name(level));
+}
+
+void write_inline(Level level, Channel channel, std::string_view text) {
+    std::string line;
+    append_prefix(line, level, channel);
+    line += text;
+    line += '\n';
+    std::lock_guard lock(g_InlineMutex);
+    std::fwrite(line.data(), 1, line.size(), stream(level));
+}
+
+// Arguments are stored as their bytes, strings as a length and their characters, so nothing a site
+// passes has to outlive the call. Anything else is formatted by the site itself.
+template <typename T>
+constexpr bool is_text = std::is_same_v<T, const char *> || std::is_same_v<T, char *> ||
+                         std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+
+template <typename T>
+constexpr bool is_deferrable = is_text<T> || (std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>) ||
+                               std::is_same_v<T, const void *> || std::is_same_v<T, void *>;
+
+template <typename T>
+using Stored = std::conditional_t<is_text<T>, std::string_view, T>;
+
+template <typename T>
+size_t encoded_size(const T &value) {
+    if constexpr (is_text<T>) {
+        return sizeof(uint32_t) + std::string_view(value).size();
+    } else {
+        return sizeof(T);
+    }
+}
+
+template <typename T>
+void encode(std::byte *&cursor, const T &value) {
+    if constexpr (is_text<T>) {
+        std::string_view text(value);
+        uint32_t size = static_cast<uint32_t>(text.size());
+        std::memcpy(cursor, &size, sizeof(size));
+        std::memcpy(cursor + sizeof(size), text.data(), size);
+        cursor += sizeof(size) + size;
+    } else {
+        std::memcpy(cursor, &value, sizeof(T));
+        cursor += sizeof(T);
+    }
+}
+
+template <typename T>
+T decode(const std::byte *&cursor) {
+    if constexpr (std::is_same_v<T, std::string_view>) {
+        uint32_t size;
+        std::memcpy(&size, cursor, sizeof(size));
+        std::string_view text(reinterpret_cast<const char *>(cursor + sizeof(size)), size);
+        cursor += sizeof(size) + size;
+        return text;
+    } else {
+        std::array<std::byte, sizeof(T)> bytes;
+        std::memcpy(bytes.data(), cursor, sizeof(T));
+        cursor += sizeof(T);
+        return std::bit_cast<T>(bytes);
+    }
+}
+
+template <typename... Args>
+void format_deferred(std::string &out, std::string_view format, const std::byte *payload) {
+    const std::byte *cursor = payload;
+    std::tuple<Stored<Args>...> values{decode<Stored<Args>>(cursor)...}; // Braced init evaluates in order
+    std::apply([&](const auto &...value) { std::vformat_to(std::back_inserter(out), format, std::make_format_args(value...)); },
+        values);
+}
+
+// Messages too large for a slot, or with arguments that can't be copied as bytes, were formatted at
+// the site and travel as an owned string
+void format_owned(std::string &out, std::string_view, const std::byte *payload) {
+    std::string *text;
+    std::memcpy(&text, payload, sizeof(text));
+    out += *text;
+    delete text;
+}
+
+Slot *acquire(uint64_t &position) {
+    uint64_t pos = g_EnqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = g_Slots[pos & (Constants::log_ring_capacity - 1)];
+        int64_t diff = static_cast<int64_t>(slot.sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (g_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                position = pos;
+                return &slot;
+            }
+        } else if (diff < 0) {
+            return nullptr;
+        } else {
+            pos = g_EnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void wait_written(uint64_t position) {
+    while (g_Written.load(std::memory_order_acquire) <= position && g_Running.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+// `wait` makes the caller block until the message is written, for errors that may precede abort()
+template <typename... Args>
+void push(Level level, Channel channel, bool wait, std::format_string<Args...> format, Args &&...args) {
+    if (!g_Running.load(std::memory_order_acquire)) {
+        write_inline(level, channel, std::format(format, std::forward<Args>(args)...));
+        return;
+    }
+    uint64_t position;
+    Slot *slot = acquire(position);
+    if (!slot) {
+        // An error is often the last thing before abort(), it bypasses the full ring instead
+        if (level >= Level::Error) {
+            write_inline(level, channel, std::format(format, std::forward<Args>(args)...));
+            return;
+        }
+        g_Dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    slot->level = level;
+    slot->channel = channel;
+    slot->format = format.get().data();
+    slot->format_size = static_cast<uint32_t>(format.get().size());
+
+    bool deferred = false;
+    if constexpr ((is_deferrable<std::decay_t<Args>> && ...)) {
+        if ((size_t{0} + ... + encoded_size<std::decay_t<Args>>(args)) <= Constants::log_payload_size) {
+            std::byte *cursor = slot->payload.data();
+            (encode<std::decay_t<Args>>(cursor, args), ...);
+            slot->format_fn = &format_deferred<std::decay_t<Args>...>;
+            deferred = true;
+        }
+    }
+    if (!deferred) {
+        auto *text = new std::string(std::format(format, std::forward<Args>(args)...));
+        std::memcpy(slot->payload.data(), &text, sizeof(text));
+        slot->format_fn = &format_owned;
+    }
+    slot->sequence.store(position + 1, std::memory_order_release);
+    if (wait) wait_written(position);
+}
+
+// Lets a site through unless it already logged its burst this second. The first message of a new
+// second reports how many of the previous one were suppressed.
+bool admit(Site &site, Level level, Channel channel) {
+    using namespace std::chrono;
+    int64_t second = duration_cast<seconds>(steady_clock::now().time_since_epoch()).count();
+    int64_t window = site.window.load(std::memory_order_relaxed);
+    if (window != second && site.window.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+        site.count.store(0, std::memory_order_relaxed);
+        uint32_t suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+        if (suppressed > 0) push(level, channel, false, "{} similar messages suppressed", suppressed);
+    }
+    if (site.count.fetch_add(1, std::memory_order_relaxed) < Constants::log_site_burst) return true;
+    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+    g_Suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+template <Level level, bool wait, typename... Args>
+void write(Site &site, Channel channel, std::format_string<Args...> format, Args &&...args) {
+    if (!admit(site, level, channel)) return;
+    push(level, channel, wait, format, std::forward<Args>(args)...);
+}
+
+void flush_repeats() {
+    if (g_Repeats == 0) return;
+    std::string line = std::format("{} (repeated {} more times)\n", std::string_view(g_LastLine).substr(0, g_LastLine.size() - 1), g_Repeats);
+    std::fwrite(line.data(), 1, line.size(), g_LastStream);
+    g_Repeats = 0;
+}
+
+// Writes everything published so far, returns how many records that was
+size_t drain() {
+    size_t count = 0;
+    std::string line;
+    for (;;) {
+        Slot &slot = g_Slots[g_DequeuePos & (Constants::log_ring_capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != g_DequeuePos + 1) break;
+        line.clear();
+        append_prefix(line, slot.level, slot.channel);
+        slot.format_fn(line, std::string_view(slot.format, slot.format_size), slot.payload.data());
+        line += '\n';
+        FILE *out = stream(slot.level);
+        slot.sequence.store(g_DequeuePos + Constants::log_ring_capacity, std::memory_order_release);
+        ++g_DequeuePos;
+
+        if (line == g_LastLine && out == g_LastStream) {
+            ++g_Repeats;
+        } else {
+            flush_repeats();
+            std::fwrite(line.data(), 1, line.size(), out);
+            g_LastLine = line;
+            g_LastStream = out;
+        }
+        g_Written.store(g_DequeuePos, std::memory_order_release);
+        ++count;
+    }
+    if (uint64_t dropped = g_Dropped.exchange(0, std::memory_order_relaxed); dropped > 0) {
+        flush_repeats();
+        std::println(stderr, "[{}] Warning: Log ring full, dropped {} messages", channel_prefix(Channel::Global), dropped);
+        g_LastLine.clear();
+    }
+    if (count > 0) {
+        std::fflush(stdout);
+        std::fflush(stderr);
+    }
+    return count;
+}
+
+void writer_main() {
+    for (;;) {
+        bool stopping = g_Stop.load(std::memory_order_acquire);
+        if (drain() > 0) continue;
+        flush_repeats(); // A repeat count shows up once the repeats stop
+        if (stopping) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(Constants::log_writer_sleep_ms));
+    }
+    std::fflush(stdout);
+    std::fflush(stderr);
+}
+
+void stop() {
+    if (!g_Running.load(std::memory_order_acquire)) return;
+    g_Stop.store(true, std::memory_order_release);
+    g_Writer.join();
+    g_Running.store(false, std::memory_order_release);
+    drain(); // Anything published while the writer was exiting
+    flush_repeats();
+    if (uint64_t suppressed = g_Suppressed.load(std::memory_order_relaxed); suppressed > 0) {
+        write_inline(Level::Info, Channel::Global, std::format("Rate limiting suppressed {} messages in total", suppressed));
+    }
+}
+
+// First thing in main, stop() runs from atexit so exit() after an error still writes everything
+void start() {
+    static_assert(std::has_single_bit(Constants::log_ring_capacity));
+    g_Slots = std::make_unique<Slot[]>(Constants::log_ring_capacity);
+    for (uint64_t i = 0; i < Constants::log_ring_capacity; ++i) g_Slots[i].sequence.store(i, std::memory_order_relaxed);
+    g_Stop.store(false, std::memory_order_relaxed);
+    g_Running.store(true, std::memory_order_release);
+    g_Writer = std::thread(writer_main);
+    static bool registered = false;
+    if (!registered) std::atexit(stop);
+    registered = true;
+}
+} // namespace DS::Log
+
+#define DS_LOG_SEND(level, wait, channel, ...)                                                                \
+    do {                                                                                                        \
+        if constexpr (DS::Log::Level::level >= DS::Log::compiled_level) {                                       \
+            static DS::Log::Site ds_log_site;                                                                   \
+            DS::Log::write<DS::Log::Level::level, wait>(ds_log_site, DS::Log::Channel::channel, __VA_ARGS__);   \
+        }                                                                                                       \
+    } while (false)
+
+#define DS_LOG(level, channel, ...) DS_LOG_SEND(level, false, channel, __VA_ARGS__)
+
+#define DS_LOG_DEBUG(channel, ...) DS_LOG(Debug, channel, __VA_ARGS__)
+#define DS_LOG_INFO(channel, ...) DS_LOG(Info, channel, __VA_ARGS__)
+#define DS_LOG_WARNING(channel, ...) DS_LOG(Warning, channel, __VA_ARGS__)
+#define DS_LOG_ERROR(channel, ...) DS_LOG_SEND(Error, true, channel, __VA_ARGS__)
+// An error that doesn't hold up the calling thread, for sites that carry on afterwards (the
+// validation messenger runs inside the offending Vulkan call)
+#define DS_LOG_ERROR_ASYNC(channel, ...) DS_LOG_SEND(Error, false, channel, __VA_ARGS__)
@@ -24,11 +24,24 @@
 #define VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR 0x00000001
 #endif
 
+#include "assets.hpp"
+#include "capture.hpp"
+#include "cli.hpp"
 #include "engine.hpp"
 #include "global.hpp"
 #include "gui.hpp"
+#include "host_allocator.hpp"
 #include "io.hpp"
+#include "jobs.hpp"
+#include "log.hpp"
+#include "meshes.hpp"
+#include "pacing.hpp"
+#include "profiler.hpp"
+#include "recording.hpp"
+#include "shader_registry.hpp"
+#include "sprites.hpp"
 #include "util.hpp"
+#include "validation.hpp"
 #include "vulkan_util.hpp"
 
 using std::println, std::print;
@@ -38,43 +51,101 @@ using namespace DS;
 using Vulkan::Extension;
 using Vulkan::ValidationLayer;
 
-int main() {
+int main(int argc, char **argv) {
+    Log::start();
+    CLI::parse(argc, argv);
     if (Constants::print_version) Util::print_versions();
+    if (!Capture::g_ReplayPath.empty()) {
+        Capture::open_replay();
+        Pacing::g_TargetFps = 0; // As fast as possible
+    }
 
     Engine::setup();
+    if (Jobs::g_Benchmark) {
+        Jobs::benchmark();
+        g_IsRunning = false;
+    }
+    if (Recording::g_Benchmark) {
+        VkCommandBufferInheritanceRenderingInfo rendering;
+        Recording::benchmark(Engine::make_inheritance(g_WD, rendering));
+        g_IsRunning = false;
+    }
+    if (Sprites::g_Benchmark) {
+        Sprites::benchmark();
+        g_IsRunning = false;
+    }
+    if (!Assets::g_BenchPath.empty()) {
+        Assets::benchmark();
+        g_IsRunning = false;
+    }
+
+    if (Meshes::g_DemoCount > 0) Meshes::demo_scene(Meshes::g_DemoCount);
+    if (!Assets::g_LoadPath.empty()) Assets::load_all(Assets::open(Assets::g_LoadPath));
+    if (!Capture::g_CapturePath.empty() && g_IsRunning) Capture::start_capture();
 
     bool show_demo_window = true;
 
     while (g_IsRunning) {
-        SDL_Event event;
-        while (SDL_PollEvent(&event)) {
-            IO::handle_event(event);
+        if (Capture::g_Replaying && !Capture::next_frame()) break;
+        Pacing::update_stats();
+        if (ShaderRegistry::update()) Pacing::request_redraw();
+        // Blocks before the frame starts, an iteration that only waited is not a frame
+        if (!g_Headless) {
+            Pacing::wait_for_events();
+            if ((SDL_GetWindowFlags(g_Window) & SDL_WINDOW_MINIMIZED) || !Pacing::redraw_due()) continue;
         }
-        if (SDL_GetWindowFlags(g_Window) & SDL_WINDOW_MINIMIZED) {
-            SDL_Delay(10);
-            continue;
+        Profiler::begin_frame();
+        Jobs::begin_frame();
+        HostAllocator::begin_frame();
+        Validation::begin_frame();
+        Sprites::begin_frame();
+        if (!g_Headless) {
+            Pacing::poll_events();
+            Engine::recreate_swapchains_if_necessary();
         }
-        Engine::recreate_swapchains_if_necessary();
 
         // Reset Frame
         ImGui_ImplVulkan_NewFrame();
-        ImGui_ImplSDL3_NewFrame();
+        if (g_Headless) {
+            Engine::headless_new_frame();
+        } else {
+            ImGui_ImplSDL3_NewFrame();
+        }
+
+        const float time = static_cast<float>(Capture::frame_time(ImGui::GetTime()));
+        Meshes::animate(g_WD, time);
+        if (Sprites::g_DemoCount > 0) Sprites::demo(g_WD, time);
 
-        // GUI
+        // GUI, a replay only runs an empty frame for the font atlas updates and draws the captured lists
         ImGui::NewFrame();
-        GUI::debug();
-        ImGui::Render();
+        if (!Capture::g_Replaying) {
+            GUI::debug();
+            GUI::profiler();
+            GUI::memory();
+        }
+        Pacing::check_animations();
+        {
+            DS_PROFILE_SCOPE("ImGui::Render");
+            ImGui::Render();
+        }
 
-        ImDrawData *draw_data = ImGui::GetDrawData();
+        ImDrawData *draw_data = Capture::g_Replaying ? Capture::replay_draw_data(ImGui::GetDrawData()) : ImGui::GetDrawData();
+        Capture::write_frame(draw_data);
         const bool is_minimized = (draw_data->DisplaySize.x <= 0.0f || draw_data->DisplaySize.y <= 0.0f);
         if (!is_minimized) {
             g_MainWindowData.ClearValue.color.float32[0] = g_ClearColor.x * g_ClearColor.w;
             g_MainWindowData.ClearValue.color.float32[1] = g_ClearColor.y * g_ClearColor.w;
             g_MainWindowData.ClearValue.color.float32[2] = g_ClearColor.z * g_ClearColor.w;
             g_MainWindowData.ClearValue.color.float32[3] = g_ClearColor.w;
-            Engine::FrameRender(&g_MainWindowData, draw_data);
-            Engine::FramePresent(&g_MainWindowData);
+            if (Engine::FrameRender(&g_MainWindowData, draw_data)) {
+                Engine::FramePresent(&g_MainWindowData);
+                Engine::report_frame_rate();
+                Pacing::frame_drawn();
+            }
+            Pacing::limit();
         }
+        Profiler::end_frame();
     }
+    Capture::cleanup();
     Engine::cleanup();
 }
\ No newline at end of file
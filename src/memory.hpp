@@ -0,0 +1,506 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <memory>
+#include <print>
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "deletion_queue.hpp"
+#include "global.hpp"
+#include "log.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Memory {
+// Device memory is handed out from large per-memory-type blocks with a buddy allocator. Resources
+// above half a block get their own dedicated vkAllocateMemory, host visible blocks stay mapped for
+// their whole lifetime. Buffers/linear images and optimal images never share a block, which makes
+// bufferImageGranularity a non-issue without tracking neighbours.
+enum class Usage {
+    GpuOnly,  // DEVICE_LOCAL
+    Upload,   // HOST_VISIBLE | HOST_COHERENT, CPU writes and GPU reads
+    Readback, // HOST_VISIBLE, preferably HOST_CACHED
+};
+
+enum class ResourceKind : uint32_t {
+    Linear,
+    Optimal,
+};
+constexpr uint32_t resource_kind_count = 2;
+
+struct Block;
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr; // Persistently mapped pointer to `offset`, nullptr if not host visible
+    Block *block = nullptr; // nullptr for dedicated allocations
+    uint32_t memory_type = 0;
+    uint32_t order = 0;
+};
+
+// Handles are heap allocated and stable, so defragmentation can swap `buffer`/`allocation` in place.
+// Movable buffers must only be written through Transfer, the GPU reads them. Owners re-read `buffer`
+// every frame and rebuild anything else derived from it (bindless descriptors) in `on_move`. Work
+// recorded before the move keeps reading the old copy, which stays intact until that frame retires.
+struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation allocation;
+    VkDeviceSize size = 0;
+    VkBufferUsageFlags usage = 0;
+    bool movable = false;
+    bool shared = false; // VK_SHARING_MODE_CONCURRENT across the graphics, compute and transfer families
+    uint64_t last_write_frame = 0; // g_FrameNumber of the last Transfer upload or defragmentation copy into it
+    std::function<void(Buffer &)> on_move;
+};
+
+struct Image {
+    VkImage image = VK_NULL_HANDLE;
+    Allocation allocation;
+};
+
+struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = nullptr;
+    VkDeviceSize size = 0;
+    VkDeviceSize used = 0;
+    uint32_t allocation_count = 0;
+    std::vector<std::set<VkDeviceSize>> free_lists; // Free offsets, indexed by buddy order
+    std::unordered_set<Buffer *> movable;
+};
+
+struct Pool {
+    uint32_t memory_type = 0;
+    ResourceKind kind = ResourceKind::Linear;
+    VkDeviceSize block_size = 0;
+    uint32_t max_order = 0;
+    std::vector<std::unique_ptr<Block>> blocks;
+};
+
+struct HeapStats {
+    VkDeviceSize heap_size = 0;
+    VkMemoryHeapFlags flags = 0;
+    VkDeviceSize block_bytes = 0;
+    VkDeviceSize used_bytes = 0;
+    VkDeviceSize dedicated_bytes = 0;
+    uint32_t block_count = 0;
+    uint32_t allocation_count = 0;
+    uint32_t dedicated_count = 0;
+};
+
+VkPhysicalDeviceMemoryProperties g_MemoryProperties;
+std::array<Pool, VK_MAX_MEMORY_TYPES * resource_kind_count> g_Pools;
+std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> g_DedicatedBytes = {};
+std::array<uint32_t, VK_MAX_MEMORY_TYPES> g_DedicatedCount = {};
+uint32_t g_DeviceAllocationCount = 0;
+uint32_t g_MaxDeviceAllocationCount = 0;
+uint32_t g_DefragMoves = 0;
+
+uint32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0) {
+    for (VkMemoryPropertyFlags wanted : {required | preferred, required}) {
+        for (uint32_t i = 0; i < g_MemoryProperties.memoryTypeCount; ++i) {
+            bool allowed = (type_bits & (1u << i)) != 0;
+            bool matches = (g_MemoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted;
+            if (allowed && matches) return i;
+        }
+    }
+    DS_LOG_ERROR(Vulkan, "No memory type matches bits {:#x} with properties {:#x}", type_bits, required);
+    abort();
+}
+
+uint32_t find_memory_type(uint32_t type_bits, Usage usage) {
+    switch (usage) {
+    case Usage::Upload:
+        return find_memory_type(type_bits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    case Usage::Readback:
+        return find_memory_type(type_bits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    case Usage::GpuOnly:
+    default:
+        return find_memory_type(type_bits, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+}
+
+bool is_host_visible(uint32_t memory_type) {
+    return (g_MemoryProperties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+Pool &pool_for(uint32_t memory_type, ResourceKind kind) {
+    return g_Pools[memory_type * resource_kind_count + Util::enum_to_number(kind)];
+}
+
+void setup() {
+    vkGetPhysicalDeviceMemoryProperties(g_PhysicalDevice, &g_MemoryProperties);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+    g_MaxDeviceAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+    for (uint32_t type = 0; type < g_MemoryProperties.memoryTypeCount; ++type) {
+        // Small heaps (integrated GPUs, BAR windows) get smaller blocks so one block can't eat the heap
+        VkDeviceSize heap_size = g_MemoryProperties.memoryHeaps[g_MemoryProperties.memoryTypes[type].heapIndex].size;
+        VkDeviceSize block_size = std::min(Constants::memory_block_size, std::bit_floor(heap_size / 8));
+        block_size = std::max(block_size, Constants::memory_min_block_size);
+        for (uint32_t kind = 0; kind < resource_kind_count; ++kind) {
+            Pool &pool = pool_for(type, static_cast<ResourceKind>(kind));
+            pool.memory_type = type;
+            pool.kind = static_cast<ResourceKind>(kind);
+            pool.block_size = block_size;
+            pool.max_order = static_cast<uint32_t>(std::countr_zero(block_size / Constants::memory_min_allocation));
+        }
+    }
+    DS_LOG_INFO(Vulkan, "{} memory heaps, {} memory types, maxMemoryAllocationCount = {}",
+        g_MemoryProperties.memoryHeapCount, g_MemoryProperties.memoryTypeCount, g_MaxDeviceAllocationCount);
+}
+
+VkDeviceMemory allocate_device_memory(VkDeviceSize size, uint32_t memory_type, void **mapped) {
+    if (g_DeviceAllocationCount >= g_MaxDeviceAllocationCount) {
+        DS_LOG_ERROR(Vulkan, "maxMemoryAllocationCount ({}) reached", g_MaxDeviceAllocationCount);
+        abort();
+    }
+    VkMemoryAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.allocationSize = size;
+    info.memoryTypeIndex = memory_type;
+    VkDeviceMemory memory;
+    Vulkan::check(vkAllocateMemory(g_Device, &info, g_Allocator, &memory));
+    ++g_DeviceAllocationCount;
+
+    *mapped = nullptr;
+    if (is_host_visible(memory_type)) {
+        Vulkan::check(vkMapMemory(g_Device, memory, 0, VK_WHOLE_SIZE, Constants::no_flags, mapped));
+    }
+    return memory;
+}
+
+void free_device_memory(VkDeviceMemory memory) {
+    // Freeing implicitly unmaps
+    vkFreeMemory(g_Device, memory, g_Allocator);
+    --g_DeviceAllocationCount;
+}
+
+uint32_t order_for(VkDeviceSize size) {
+    VkDeviceSize units = (size + Constants::memory_min_allocation - 1) / Constants::memory_min_allocation;
+    return static_cast<uint32_t>(std::countr_zero(std::bit_ceil(units)));
+}
+
+VkDeviceSize order_size(uint32_t order) {
+    return Constants::memory_min_allocation << order;
+}
+
+Block *create_block(Pool &pool) {
+    auto block = std::make_unique<Block>();
+    block->size = pool.block_size;
+    block->memory = allocate_device_memory(pool.block_size, pool.memory_type, &block->mapped);
+    block->free_lists.resize(pool.max_order + 1);
+    block->free_lists[pool.max_order].insert(0);
+    pool.blocks.push_back(std::move(block));
+    return pool.blocks.back().get();
+}
+
+bool buddy_allocate(Block &block, uint32_t order, VkDeviceSize &offset) {
+    uint32_t found = order;
+    while (found < block.free_lists.size() && block.free_lists[found].empty()) ++found;
+    if (found >= block.free_lists.size()) return false;
+
+    offset = *block.free_lists[found].begin();
+    block.free_lists[found].erase(block.free_lists[found].begin());
+    // Split down, handing the upper halves back to the free lists
+    while (found > order) {
+        --found;
+        block.free_lists[found].insert(offset + order_size(found));
+    }
+    block.used += order_size(order);
+    ++block.allocation_count;
+    return true;
+}
+
+void buddy_free(Block &block, VkDeviceSize offset, uint32_t order) {
+    block.used -= order_size(order);
+    --block.allocation_count;
+    // Merge with the buddy as long as it is free too
+    while (order + 1 < block.free_lists.size()) {
+        VkDeviceSize buddy = offset ^ order_size(order);
+        auto it = block.free_lists[order].find(buddy);
+        if (it == block.free_lists[order].end()) break;
+        block.free_lists[order].erase(it);
+        offset = std::min(offset, buddy);
+        ++order;
+    }
+    block.free_lists[order].insert(offset);
+}
+
+// `exclude` keeps defragmentation from allocating back into the block it is emptying
+Allocation allocate(const VkMemoryRequirements &requirements, Usage usage, ResourceKind kind, const Block *exclude = nullptr) {
+    Allocation allocation;
+    allocation.memory_type = find_memory_type(requirements.memoryTypeBits, usage);
+    allocation.size = requirements.size;
+    Pool &pool = pool_for(allocation.memory_type, kind);
+
+    // Buddy nodes are aligned to their own size, so rounding up to the alignment is enough
+    VkDeviceSize needed = std::max(requirements.size, requirements.alignment);
+    if (needed > pool.block_size / 2) {
+        allocation.memory = allocate_device_memory(requirements.size, allocation.memory_type, &allocation.mapped);
+        g_DedicatedBytes[allocation.memory_type] += requirements.size;
+        ++g_DedicatedCount[allocation.memory_type];
+        return allocation;
+    }
+
+    allocation.order = order_for(needed);
+    Block *target = nullptr;
+    for (auto &block : pool.blocks) {
+        if (block.get() == exclude) continue;
+        if (exclude && block->allocation_count == 0) continue; // Moving into the spare block gains nothing
+        if (buddy_allocate(*block, allocation.order, allocation.offset)) {
+            target = block.get();
+            break;
+        }
+    }
+    if (!target) {
+        if (exclude) return {}; // Defragmentation never grows the pool
+        target = create_block(pool);
+        buddy_allocate(*target, allocation.order, allocation.offset);
+    }
+    allocation.block = target;
+    allocation.memory = target->memory;
+    if (target->mapped) allocation.mapped = static_cast<uint8_t *>(target->mapped) + allocation.offset;
+    return allocation;
+}
+
+void free_allocation(const Allocation &allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) return;
+    if (!allocation.block) {
+        g_DedicatedBytes[allocation.memory_type] -= allocation.size;
+        --g_DedicatedCount[allocation.memory_type];
+        free_device_memory(allocation.memory);
+        return;
+    }
+    buddy_free(*allocation.block, allocation.offset, allocation.order);
+}
+
+// Distinct queue families a shared buffer is created for, a single one means exclusive is enough
+std::vector<uint32_t> shared_families() {
+    std::vector<uint32_t> families;
+    for (uint32_t family : {g_QueueFamily, g_ComputeQueueFamily, g_TransferQueueFamily}) {
+        if (std::find(families.begin(), families.end(), family) == families.end()) families.push_back(family);
+    }
+    return families;
+}
+
+void set_sharing(VkBufferCreateInfo &info, bool shared, const std::vector<uint32_t> &families) {
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (!shared || families.size() < 2) return;
+    info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    info.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+    info.pQueueFamilyIndices = families.data();
+}
+
+// Movable buffers must be GpuOnly; TRANSFER_SRC/DST are added so defragmentation can copy them.
+// Shared buffers are read on more than one queue family without ownership transfers.
+Buffer *create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, Usage memory_usage, bool movable = false, bool shared = false) {
+    auto *buffer = new Buffer();
+    buffer->size = size;
+    buffer->movable = movable && memory_usage == Usage::GpuOnly;
+    buffer->usage = usage;
+    if (buffer->movable) buffer->usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    std::vector<uint32_t> families = shared_families();
+    buffer->shared = shared && families.size() > 1;
+
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    info.usage = buffer->usage;
+    set_sharing(info, buffer->shared, families);
+    Vulkan::check(vkCreateBuffer(g_Device, &info, g_Allocator, &buffer->buffer));
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(g_Device, buffer->buffer, &requirements);
+    buffer->allocation = allocate(requirements, memory_usage, ResourceKind::Linear);
+    Vulkan::check(vkBindBufferMemory(g_Device, buffer->buffer, buffer->allocation.memory, buffer->allocation.offset));
+    if (buffer->movable && buffer->allocation.block) buffer->allocation.block->movable.insert(buffer);
+    return buffer;
+}
+
+// Immediate, the caller guarantees the GPU is done with it (see destroy_buffer_deferred)
+void destroy_buffer(Buffer *buffer) {
+    if (!buffer) return;
+    if (buffer->movable && buffer->allocation.block) buffer->allocation.block->movable.erase(buffer);
+    vkDestroyBuffer(g_Device, buffer->buffer, g_Allocator);
+    free_allocation(buffer->allocation);
+    delete buffer;
+}
+
+void destroy_buffer_deferred(Buffer *buffer) {
+    if (!buffer) return;
+    // Unregister now so defragmentation doesn't move a buffer that is on its way out
+    if (buffer->movable && buffer->allocation.block) buffer->allocation.block->movable.erase(buffer);
+    buffer->movable = false;
+    DeletionQueue::push([buffer] { destroy_buffer(buffer); });
+}
+
+Image *create_image(const VkImageCreateInfo &info, Usage memory_usage) {
+    auto *image = new Image();
+    Vulkan::check(vkCreateImage(g_Device, &info, g_Allocator, &image->image));
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(g_Device, image->image, &requirements);
+    ResourceKind kind = info.tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::Optimal : ResourceKind::Linear;
+    image->allocation = allocate(requirements, memory_usage, kind);
+    Vulkan::check(vkBindImageMemory(g_Device, image->image, image->allocation.memory, image->allocation.offset));
+    return image;
+}
+
+void destroy_image(Image *image) {
+    if (!image) return;
+    vkDestroyImage(g_Device, image->image, g_Allocator);
+    free_allocation(image->allocation);
+    delete image;
+}
+
+void destroy_image_deferred(Image *image) {
+    if (!image) return;
+    DeletionQueue::push([image] { destroy_image(image); });
+}
+
+// Incremental defragmentation: per call, moves at most `max_moves` movable buffers out of the
+// emptiest block of each fragmented pool into the other blocks, recording the copies into `cmd`
+// (outside a render pass, after the frame's Transfer acquires). Old buffers are retired through the
+// deletion queue, so nothing stalls. Blocks left empty are released the same way, keeping one spare
+// per pool. A buffer uploaded to this frame may still have its copy pending and is left alone.
+void defragment(VkCommandBuffer cmd, uint32_t max_moves) {
+    struct Move {
+        Buffer *buffer;
+        VkBuffer new_buffer;
+        Allocation new_allocation;
+    };
+    std::vector<Move> moves;
+
+    for (Pool &pool : g_Pools) {
+        if (pool.blocks.size() < 2 || moves.size() >= max_moves) continue;
+
+        Block *source = nullptr;
+        for (auto &block : pool.blocks) {
+            if (block->movable.empty()) continue;
+            if (!source || block->used < source->used) source = block.get();
+        }
+        if (!source || source->used * 2 > source->size) continue;
+
+        std::vector<Buffer *> candidates(source->movable.begin(), source->movable.end());
+        for (Buffer *buffer : candidates) {
+            if (moves.size() >= max_moves) break;
+            if (buffer->last_write_frame >= g_FrameNumber) continue;
+            VkBufferCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            info.size = buffer->size;
+            info.usage = buffer->usage;
+            std::vector<uint32_t> families = shared_families();
+            set_sharing(info, buffer->shared, families);
+            VkBuffer new_buffer;
+            Vulkan::check(vkCreateBuffer(g_Device, &info, g_Allocator, &new_buffer));
+            VkMemoryRequirements requirements;
+            vkGetBufferMemoryRequirements(g_Device, new_buffer, &requirements);
+            Allocation new_allocation = allocate(requirements, Usage::GpuOnly, ResourceKind::Linear, source);
+            if (new_allocation.memory == VK_NULL_HANDLE) {
+                vkDestroyBuffer(g_Device, new_buffer, g_Allocator);
+                break; // The other blocks are full, try again once something is freed
+            }
+            Vulkan::check(vkBindBufferMemory(g_Device, new_buffer, new_allocation.memory, new_allocation.offset));
+            moves.push_back({.buffer = buffer, .new_buffer = new_buffer, .new_allocation = new_allocation});
+        }
+    }
+    if (moves.empty()) return;
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, Constants::no_flags, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    for (Move &move : moves) {
+        Buffer *buffer = move.buffer;
+        VkBufferCopy region = {0, 0, buffer->size};
+        vkCmdCopyBuffer(cmd, buffer->buffer, move.new_buffer, 1, &region);
+
+        buffer->allocation.block->movable.erase(buffer);
+        VkBuffer old_buffer = buffer->buffer;
+        Allocation old_allocation = buffer->allocation;
+        DeletionQueue::push([old_buffer, old_allocation] {
+            vkDestroyBuffer(g_Device, old_buffer, g_Allocator);
+            free_allocation(old_allocation);
+        });
+        buffer->buffer = move.new_buffer;
+        buffer->allocation = move.new_allocation;
+        buffer->allocation.block->movable.insert(buffer);
+        buffer->last_write_frame = g_FrameNumber; // Written by this frame's graphics submit now
+        if (buffer->on_move) buffer->on_move(*buffer);
+        ++g_DefragMoves;
+    }
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, Constants::no_flags, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// Releases empty blocks beyond one spare per pool. A block only becomes empty once the deletion
+// queue has freed its last allocation, so it is no longer referenced by the GPU at that point.
+void trim() {
+    for (Pool &pool : g_Pools) {
+        bool kept_spare = false;
+        std::erase_if(pool.blocks, [&](const std::unique_ptr<Block> &block) {
+            if (block->allocation_count != 0) return false;
+            if (!kept_spare) {
+                kept_spare = true;
+                return false;
+            }
+            free_device_memory(block->memory);
+            return true;
+        });
+    }
+}
+
+std::vector<HeapStats> heap_stats() {
+    std::vector<HeapStats> stats(g_MemoryProperties.memoryHeapCount);
+    for (uint32_t heap = 0; heap < g_MemoryProperties.memoryHeapCount; ++heap) {
+        stats[heap].heap_size = g_MemoryProperties.memoryHeaps[heap].size;
+        stats[heap].flags = g_MemoryProperties.memoryHeaps[heap].flags;
+    }
+    for (const Pool &pool : g_Pools) {
+        if (pool.block_size == 0) continue;
+        HeapStats &heap = stats[g_MemoryProperties.memoryTypes[pool.memory_type].heapIndex];
+        for (const auto &block : pool.blocks) {
+            heap.block_bytes += block->size;
+            heap.used_bytes += block->used;
+            heap.allocation_count += block->allocation_count;
+            ++heap.block_count;
+        }
+    }
+    for (uint32_t type = 0; type < g_MemoryProperties.memoryTypeCount; ++type) {
+        HeapStats &heap = stats[g_MemoryProperties.memoryTypes[type].heapIndex];
+        heap.dedicated_bytes += g_DedicatedBytes[type];
+        heap.dedicated_count += g_DedicatedCount[type];
+    }
+    return stats;
+}
+
+// Only valid once every resource has been destroyed and the device is idle
+void cleanup() {
+    for (Pool &pool : g_Pools) {
+        for (auto &block : pool.blocks) {
+            if (block->allocation_count != 0) {
+                DS_LOG_WARNING(Vulkan, "Leaking {} allocations in memory type {}", block->allocation_count, pool.memory_type);
+            }
+            free_device_memory(block->memory);
+        }
+        pool.blocks.clear();
+    }
+}
+} // namespace DS::Memory
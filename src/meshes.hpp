@@ -0,0 +1,552 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <print>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <imgui.h>
+#include <imgui_impl_vulkan.h>
+
+#include <vulkan/vulkan.h>
+
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "depth.hpp"
+#include "global.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+#include "profiler.hpp"
+#include "shader_registry.hpp"
+#include "transfer.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Meshes {
+// GPU-driven meshes. Object transforms and the mesh table live in storage buffers that are only
+// written when the scene changes. Every frame cull() dispatches shaders/cull.comp, which tests each
+// object's bounding sphere against the frustum and writes one VkDrawIndexedIndirectCommand per
+// visible object (firstInstance = object index) plus the draw count. cull_async() submits it on the
+// compute queue (async where there is one) ahead of the graphics submit, which waits for it on the
+// compute timeline; only while freshly uploaded or moved inputs haven't reached a submitted graphics
+// frame does the frame graph's culling pass record it on the graphics queue instead. record() then draws the whole scene with a single vkCmdDrawIndexedIndirectCount, so the CPU
+// cost per frame does not depend on the object count. Without drawIndirectCount the shader writes a
+// command for every object with instanceCount 0 or 1 instead of compacting.
+// All meshes share one vertex and index buffer; needs bindless descriptors, multiDrawIndirect and
+// drawIndirectFirstInstance.
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+// Matches shaders/cull.comp and shaders/mesh.vert (std430)
+struct Mesh {
+    uint32_t first_index;
+    uint32_t index_count;
+    int32_t vertex_offset;
+    float radius; // Bounding sphere around the origin
+};
+static_assert(sizeof(Mesh) == 16);
+
+struct Object {
+    glm::vec4 position_scale; // xyz position, w uniform scale
+    glm::vec4 rotation;       // Quaternion, xyzw
+    uint32_t mesh;
+    uint32_t color; // RGBA8, packed like IM_COL32
+    uint32_t pad[2];
+};
+static_assert(sizeof(Object) == 48);
+
+struct PushConstants {
+    glm::mat4 view_proj;
+    glm::vec4 light; // xyz direction towards the light, w ambient
+    uint32_t objects;
+    uint32_t meshes;
+    uint32_t draws;
+    uint32_t object_count;
+    uint32_t compact;
+};
+static_assert(sizeof(PushConstants) <= Constants::bindless_push_constant_size);
+
+// Layout of a frame slot's draw buffer: the count, then the commands. Also the offset the
+// indirect draw reads the commands from.
+constexpr VkDeviceSize draw_commands_offset = 16;
+constexpr uint32_t cull_group_size = 64; // local_size_x of shaders/cull.comp
+static_assert(Constants::mesh_max_objects <= 65'535 * cull_group_size, "One dispatch within the guaranteed group count");
+
+enum class BuiltinMesh : uint32_t {
+    Cube,
+    Octahedron,
+};
+constexpr uint32_t builtin_mesh_count = 2;
+
+struct FrameBuffers {
+    Memory::Buffer *draws = nullptr;
+    Memory::Buffer *readback = nullptr; // Visible count, read once the slot retires
+    Bindless::BufferHandle handle;
+};
+
+bool g_Supported = false;
+bool g_DrawIndirectCount = false;
+bool g_Enabled = false;
+uint32_t g_MaxObjects = 0;
+VkPipeline g_Pipeline = VK_NULL_HANDLE;
+VkPipeline g_CullPipeline = VK_NULL_HANDLE;
+Memory::Buffer *g_Vertices = nullptr;
+Memory::Buffer *g_Indices = nullptr;
+Memory::Buffer *g_MeshTable = nullptr;
+Memory::Buffer *g_Objects = nullptr;
+Bindless::BufferHandle g_MeshTableHandle;
+Bindless::BufferHandle g_ObjectsHandle;
+std::vector<FrameBuffers> g_Buffers; // One per frame in flight, sized for g_Capacity objects
+uint32_t g_Capacity = 0;
+uint32_t g_ObjectCount = 0;
+uint32_t g_LastVisible = 0;
+uint64_t g_AsyncCullFrame = 0; // g_FrameNumber whose culling went to the compute queue
+glm::mat4 g_ViewProj = glm::mat4(1.0f);
+glm::vec4 g_Light = {0.4f, 0.8f, 0.45f, 0.2f};
+float g_SceneRadius = 4.0f; // Half extent, the camera orbits outside it
+
+uint32_t g_DemoCount = 0;
+
+// The features enable_features() turns on, queried alongside the other device features
+void check_support(const VkPhysicalDeviceFeatures &features, const VkPhysicalDeviceVulkan12Features &features12) {
+    g_Supported = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+    g_DrawIndirectCount = g_Supported && features12.drawIndirectCount;
+}
+
+void enable_features(VkPhysicalDeviceFeatures &features, VkPhysicalDeviceVulkan12Features &features12) {
+    if (!g_Supported) return;
+    features.multiDrawIndirect = VK_TRUE;
+    features.drawIndirectFirstInstance = VK_TRUE;
+    if (g_DrawIndirectCount) features12.drawIndirectCount = VK_TRUE;
+}
+
+VkPipeline create_pipeline(const ImGui_ImplVulkanH_Window *wd, VkShaderModule vert, VkShaderModule frag) {
+    std::array<VkPipelineShaderStageCreateInfo, 2> stages = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag;
+    stages[1].pName = "main";
+
+    VkVertexInputBindingDescription binding = {0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX};
+    const std::array<VkVertexInputAttributeDescription, 2> attributes = {{
+        {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)},
+        {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)},
+    }};
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = 1;
+    vertex_input.pVertexBindingDescriptions = &binding;
+    vertex_input.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+    vertex_input.pVertexAttributeDescriptions = attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    // The projection flips Y, counter-clockwise on screen stays counter-clockwise
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = VK_TRUE;
+    depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+    VkPipelineColorBlendAttachmentState attachment = {};
+    attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo color_blend = {};
+    color_blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend.attachmentCount = 1;
+    color_blend.pAttachments = &attachment;
+
+    const std::array<VkDynamicState, 2> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic.pDynamicStates = dynamic_states.data();
+
+    VkPipelineRenderingCreateInfo rendering = {};
+    rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering.colorAttachmentCount = 1;
+    rendering.pColorAttachmentFormats = &wd->SurfaceFormat.format;
+    rendering.depthAttachmentFormat = Depth::g_Format;
+
+    VkGraphicsPipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.pNext = g_DynamicRendering ? &rendering : nullptr;
+    info.stageCount = static_cast<uint32_t>(stages.size());
+    info.pStages = stages.data();
+    info.pVertexInputState = &vertex_input;
+    info.pInputAssemblyState = &input_assembly;
+    info.pViewportState = &viewport;
+    info.pRasterizationState = &rasterization;
+    info.pMultisampleState = &multisample;
+    info.pDepthStencilState = &depth_stencil;
+    info.pColorBlendState = &color_blend;
+    info.pDynamicState = &dynamic;
+    info.layout = Bindless::g_PipelineLayout;
+    info.renderPass = g_DynamicRendering ? VK_NULL_HANDLE : wd->RenderPass;
+    info.subpass = 0;
+    VkPipeline pipeline;
+    Vulkan::check(vkCreateGraphicsPipelines(g_Device, g_PipelineCache, 1, &info, g_Allocator, &pipeline));
+    return pipeline;
+}
+
+VkPipeline create_cull_pipeline(VkShaderModule comp) {
+    VkComputePipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = comp;
+    info.stage.pName = "main";
+    info.layout = Bindless::g_PipelineLayout;
+    VkPipeline pipeline;
+    Vulkan::check(vkCreateComputePipelines(g_Device, g_PipelineCache, 1, &info, g_Allocator, &pipeline));
+    return pipeline;
+}
+
+// Flat shaded cube and octahedron, counter-clockwise seen from outside
+void build_geometry(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, std::vector<Mesh> &meshes) {
+    meshes.push_back({static_cast<uint32_t>(indices.size()), 36, static_cast<int32_t>(vertices.size()), std::sqrt(3.0f) * 0.5f});
+    for (int axis = 0; axis < 3; ++axis) {
+        for (float sign : {1.0f, -1.0f}) {
+            glm::vec3 n(0.0f), u(0.0f), v(0.0f);
+            n[axis] = sign;
+            u[(axis + 1) % 3] = 1.0f;
+            v[(axis + 2) % 3] = 1.0f;
+            if (sign < 0.0f) std::swap(u, v); // Keeps u x v == n
+            uint32_t base = static_cast<uint32_t>(vertices.size()) - static_cast<uint32_t>(meshes.back().vertex_offset);
+            for (glm::vec2 corner : {glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1)}) {
+                vertices.push_back({0.5f * (n + corner.x * u + corner.y * v), n});
+            }
+            indices.insert(indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+        }
+    }
+
+    const float extent = 0.7f;
+    meshes.push_back({static_cast<uint32_t>(indices.size()), 24, static_cast<int32_t>(vertices.size()), extent});
+    for (uint32_t octant = 0; octant < 8; ++octant) {
+        glm::vec3 s((octant & 1) ? -1.0f : 1.0f, (octant & 2) ? -1.0f : 1.0f, (octant & 4) ? -1.0f : 1.0f);
+        std::array<glm::vec3, 3> corners = {glm::vec3(s.x * extent, 0, 0), glm::vec3(0, s.y * extent, 0), glm::vec3(0, 0, s.z * extent)};
+        if (s.x * s.y * s.z < 0.0f) std::swap(corners[1], corners[2]); // Mirrored an odd number of times
+        uint32_t base = static_cast<uint32_t>(vertices.size()) - static_cast<uint32_t>(meshes.back().vertex_offset);
+        for (const glm::vec3 &corner : corners) vertices.push_back({corner, glm::normalize(s)});
+        indices.insert(indices.end(), {base, base + 1, base + 2});
+    }
+}
+
+// Uploads through the staging ring in pieces. When the ring is full the pending batch is submitted
+// and only the oldest batch is waited for, so the copies keep streaming while the CPU refills the
+// space it hands back. Fine for scene loads, not for per-frame updates.
+void upload(Memory::Buffer *dst, const void *data, VkDeviceSize size) {
+    const VkDeviceSize chunk_size = Constants::staging_ring_size / 4;
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (VkDeviceSize offset = 0; offset < size;) {
+        VkDeviceSize chunk = std::min(chunk_size, size - offset);
+        if (!Transfer::upload_buffer(dst, offset, bytes + offset, chunk)) {
+            Transfer::flush();
+            Transfer::wait_oldest();
+            continue;
+        }
+        offset += chunk;
+    }
+}
+
+// After a defragmentation move. Frames in flight may still index the old slot, which keeps
+// describing the old buffer until they retire, so the new buffer gets a fresh slot.
+void rebind(Bindless::BufferHandle &handle, const Memory::Buffer &buffer) {
+    Bindless::release(handle);
+    handle = Bindless::register_buffer(buffer.buffer);
+}
+
+void create_geometry() {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Mesh> meshes;
+    build_geometry(vertices, indices, meshes);
+    const VkBufferUsageFlags dst = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    // Read-only on the GPU, so they can be defragmented. The mesh table is also read by culling on
+    // the compute queue.
+    g_Vertices = Memory::create_buffer(vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | dst, Memory::Usage::GpuOnly, true);
+    g_Indices = Memory::create_buffer(indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | dst, Memory::Usage::GpuOnly, true);
+    g_MeshTable = Memory::create_buffer(meshes.size() * sizeof(Mesh), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | dst, Memory::Usage::GpuOnly, true, true);
+    upload(g_Vertices, vertices.data(), g_Vertices->size);
+    upload(g_Indices, indices.data(), g_Indices->size);
+    upload(g_MeshTable, meshes.data(), g_MeshTable->size);
+    g_MeshTableHandle = Bindless::register_buffer(g_MeshTable->buffer);
+    g_MeshTable->on_move = [](Memory::Buffer &buffer) { rebind(g_MeshTableHandle, buffer); };
+}
+
+// Call once the render target exists (render pass or formats), after Bindless::setup
+void setup(const ImGui_ImplVulkanH_Window *wd) {
+    if (!Bindless::g_Enabled || !g_Supported) {
+        DS_LOG_WARNING(Render, "Meshes need bindless descriptors, multiDrawIndirect and drawIndirectFirstInstance, mesh renderer disabled");
+        return;
+    }
+    bool loaded = ShaderRegistry::add({"mesh.vert", "mesh.frag"}, [wd](std::span<const VkShaderModule> modules) {
+        return create_pipeline(wd, modules[0], modules[1]);
+    }, &g_Pipeline);
+    loaded = loaded && ShaderRegistry::add({"cull.comp"}, [](std::span<const VkShaderModule> modules) {
+        return create_cull_pipeline(modules[0]);
+    }, &g_CullPipeline);
+    if (loaded) {
+        create_geometry();
+        g_Buffers.resize(g_FramesInFlight);
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+        g_MaxObjects = std::min(Constants::mesh_max_objects, properties.limits.maxDrawIndirectCount);
+        g_Enabled = true;
+        DS_LOG_INFO(Render, "Mesh renderer up to {} objects, {}", g_MaxObjects,
+            g_DrawIndirectCount ? "compacted draws with vkCmdDrawIndexedIndirectCount" : "one indirect command per object");
+    } else {
+        DS_LOG_WARNING(Render, "Mesh shaders missing, mesh renderer disabled");
+    }
+}
+
+// Only valid once the device is idle, before DeletionQueue::flush and Bindless::cleanup
+void cleanup() {
+    if (!g_Enabled) return;
+    g_Pipeline = g_CullPipeline = VK_NULL_HANDLE; // Owned by the shader registry
+    for (FrameBuffers &frame : g_Buffers) {
+        Bindless::release(frame.handle);
+        Memory::destroy_buffer(frame.draws);
+        Memory::destroy_buffer(frame.readback);
+    }
+    g_Buffers.clear();
+    Bindless::release(g_ObjectsHandle);
+    Bindless::release(g_MeshTableHandle);
+    for (Memory::Buffer *buffer : {g_Objects, g_MeshTable, g_Indices, g_Vertices}) Memory::destroy_buffer(buffer);
+    g_Objects = g_MeshTable = g_Indices = g_Vertices = nullptr;
+    g_Enabled = false;
+}
+
+// Replaces the scene. The previous buffers are retired through the deletion queue, frames in
+// flight keep drawing the old scene. Objects past g_MaxObjects are dropped.
+void set_objects(std::span<const Object> objects) {
+    if (!g_Enabled) return;
+    if (objects.size() > g_MaxObjects) {
+        DS_LOG_WARNING(Render, "{} mesh objects, only the first {} are drawn", objects.size(), g_MaxObjects);
+        objects = objects.first(g_MaxObjects);
+    }
+    Bindless::release(g_ObjectsHandle);
+    Memory::destroy_buffer_deferred(g_Objects);
+    g_Objects = nullptr;
+    g_ObjectsHandle = {};
+    g_ObjectCount = static_cast<uint32_t>(objects.size());
+    if (g_ObjectCount == 0) return;
+
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    // Replaced with every scene change, the main source of fragmentation, and only read by the GPU,
+    // on both the graphics and the compute queue
+    g_Objects = Memory::create_buffer(objects.size_bytes(), usage, Memory::Usage::GpuOnly, true, true);
+    upload(g_Objects, objects.data(), objects.size_bytes());
+    g_ObjectsHandle = Bindless::register_buffer(g_Objects->buffer);
+    g_Objects->on_move = [](Memory::Buffer &buffer) { rebind(g_ObjectsHandle, buffer); };
+
+    if (g_ObjectCount <= g_Capacity) return;
+    g_Capacity = g_ObjectCount;
+    for (FrameBuffers &frame : g_Buffers) {
+        Bindless::release(frame.handle);
+        Memory::destroy_buffer_deferred(frame.draws);
+        Memory::destroy_buffer_deferred(frame.readback);
+        VkDeviceSize size = draw_commands_offset + static_cast<VkDeviceSize>(g_Capacity) * sizeof(VkDrawIndexedIndirectCommand);
+        frame.draws = Memory::create_buffer(size,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            Memory::Usage::GpuOnly);
+        // Host coherent, so reading it needs no invalidate
+        frame.readback = Memory::create_buffer(sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, Memory::Usage::Upload);
+        *static_cast<uint32_t *>(frame.readback->allocation.mapped) = 0;
+        frame.handle = Bindless::register_buffer(frame.draws->buffer);
+    }
+}
+
+// Orbits the camera around the scene
+void animate(const ImGui_ImplVulkanH_Window *wd, float time) {
+    const float radius = g_SceneRadius;
+    const float aspect = static_cast<float>(wd->Width) / static_cast<float>(std::max(1, wd->Height));
+    const float distance = radius * 1.5f;
+    glm::vec3 eye(std::cos(time * 0.1f) * distance, radius * 0.4f, std::sin(time * 0.1f) * distance);
+    glm::mat4 view = glm::lookAtRH(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspectiveRH_ZO(glm::radians(60.0f), aspect, 0.1f, distance + radius * 2.0f);
+    proj[1][1] *= -1.0f; // Vulkan clip space has Y pointing down
+    g_ViewProj = proj * view;
+}
+
+PushConstants push_constants(uint32_t slot) {
+    return {
+        .view_proj = g_ViewProj,
+        .light = g_Light,
+        .objects = g_ObjectsHandle.index,
+        .meshes = g_MeshTableHandle.index,
+        .draws = g_Buffers[slot].handle.index,
+        .object_count = g_ObjectCount,
+        .compact = g_DrawIndirectCount ? 1u : 0u};
+}
+
+// Picks up the visible count of the frame that last used `slot`, call once its fence has signalled
+void prepare(uint32_t slot) {
+    if (!g_Enabled || g_ObjectCount == 0 || !g_DrawIndirectCount) return;
+    g_LastVisible = *static_cast<const uint32_t *>(g_Buffers[slot].readback->allocation.mapped);
+}
+
+// Records the culling dispatch, into the compute command buffer (cull_async) or into the graphics
+// one outside the render pass, where the frame graph orders the draw commands against the indirect
+// draw and the readback.
+void cull(VkCommandBuffer cmd, uint32_t slot) {
+    if (!g_Enabled || g_ObjectCount == 0) return;
+    DS_PROFILE_SCOPE("Meshes::cull");
+    FrameBuffers &frame = g_Buffers[slot];
+    vkCmdFillBuffer(cmd, frame.draws->buffer, 0, sizeof(uint32_t), 0);
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = frame.draws->buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        Constants::no_flags, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, g_CullPipeline);
+    Bindless::bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+    PushConstants constants = push_constants(slot);
+    vkCmdPushConstants(cmd, Bindless::g_PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+    vkCmdDispatch(cmd, (g_ObjectCount + cull_group_size - 1) / cull_group_size, 1, 1);
+}
+
+// Culls on the compute queue, ahead of the frame's graphics submit, so on GPUs with an async
+// compute queue it overlaps the previous frame's raster work. The inputs must have been acquired by
+// a graphics frame submitted before this one: the compute submit waits for that frame on the
+// graphics timeline, which also covers the transfer that wrote them. Until then (a scene was just
+// uploaded or defragmented) returns false and the frame graph's culling pass does the work.
+bool cull_async(uint32_t slot) {
+    if (!g_Enabled || g_ObjectCount == 0) return false;
+    uint64_t inputs_frame = std::max(g_Objects->last_write_frame, g_MeshTable->last_write_frame);
+    if (inputs_frame + 1 >= g_FrameNumber) {
+        g_AsyncCullFrame = 0;
+        return false;
+    }
+    // Retry of a dropped frame: its dispatch and the release are still waiting for a graphics submit
+    if (g_AsyncCullFrame == g_FrameNumber) return true;
+    g_AsyncCullFrame = g_FrameNumber;
+    VkCommandBuffer cmd = Compute::begin();
+    cull(cmd, slot);
+    // Graphics only reads the results. Whatever graphics read last time is done, this slot's fence was waited on.
+    Compute::release_buffer(g_Buffers[slot].draws, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+    Compute::submit(inputs_frame + 1);
+    return true;
+}
+
+// Copies the visible count out for prepare(), once the frame graph made the culling results visible
+void read_back(VkCommandBuffer cmd, uint32_t slot) {
+    if (!g_Enabled || g_ObjectCount == 0 || !g_DrawIndirectCount) return;
+    FrameBuffers &frame = g_Buffers[slot];
+    VkBufferCopy region = {0, 0, sizeof(uint32_t)};
+    vkCmdCopyBuffer(cmd, frame.draws->buffer, frame.readback->buffer, 1, &region);
+    VkBufferMemoryBarrier host = {};
+    host.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    host.buffer = frame.readback->buffer;
+    host.offset = 0;
+    host.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        Constants::no_flags, 0, nullptr, 1, &host, 0, nullptr);
+}
+
+// Per-frame buffers for the frame graph, VK_NULL_HANDLE while there is no scene
+VkBuffer draw_buffer(uint32_t slot) {
+    if (!g_Enabled || slot >= g_Buffers.size() || g_Buffers[slot].draws == nullptr) return VK_NULL_HANDLE;
+    return g_Buffers[slot].draws->buffer;
+}
+
+VkBuffer readback_buffer(uint32_t slot) {
+    if (!g_Enabled || slot >= g_Buffers.size() || g_Buffers[slot].readback == nullptr) return VK_NULL_HANDLE;
+    return g_Buffers[slot].readback->buffer;
+}
+
+// Recording task, the whole scene in one indirect draw
+void record(VkCommandBuffer cmd, const ImGui_ImplVulkanH_Window *wd) {
+    if (!g_Enabled || g_ObjectCount == 0) return;
+    VkViewport viewport = {0.0f, 0.0f, static_cast<float>(wd->Width), static_cast<float>(wd->Height), 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, {static_cast<uint32_t>(wd->Width), static_cast<uint32_t>(wd->Height)}};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_Pipeline);
+    Bindless::bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    PushConstants constants = push_constants(g_FrameSlot);
+    vkCmdPushConstants(cmd, Bindless::g_PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, &g_Vertices->buffer, &offset);
+    vkCmdBindIndexBuffer(cmd, g_Indices->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+    VkBuffer draws = g_Buffers[g_FrameSlot].draws->buffer;
+    constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (g_DrawIndirectCount) {
+        vkCmdDrawIndexedIndirectCount(cmd, draws, draw_commands_offset, draws, 0, g_ObjectCount, stride);
+    } else {
+        vkCmdDrawIndexedIndirect(cmd, draws, draw_commands_offset, g_ObjectCount, stride);
+    }
+}
+
+// --meshes <n>: a cloud of randomly rotated cubes and octahedra
+void demo_scene(uint32_t count) {
+    if (!g_Enabled) return;
+    const float radius = std::max(4.0f, 1.5f * std::cbrt(static_cast<float>(count))); // Roughly constant density
+    std::vector<Object> objects(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t hash = i * 2654435761u;
+        auto next = [&hash] {
+            hash ^= hash << 13;
+            hash ^= hash >> 17;
+            hash ^= hash << 5;
+            return static_cast<float>(hash & 0xFFFFFF) / static_cast<float>(0xFFFFFF);
+        };
+        glm::vec3 position(next() * 2.0f - 1.0f, next() * 2.0f - 1.0f, next() * 2.0f - 1.0f);
+        glm::vec4 rotation = glm::normalize(glm::vec4(next() - 0.5f, next() - 0.5f, next() - 0.5f, next() - 0.5f));
+        uint8_t shade = static_cast<uint8_t>(i * 37);
+        objects[i] = {
+            .position_scale = glm::vec4(position * radius, 0.5f + next()),
+            .rotation = rotation,
+            .mesh = i % builtin_mesh_count,
+            .color = IM_COL32(shade, 255 - shade, 160, 255),
+            .pad = {}};
+    }
+    g_SceneRadius = radius;
+    set_objects(objects);
+}
+} // namespace DS::Meshes
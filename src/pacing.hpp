@@ -0,0 +1,134 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <print>
+#include <thread>
+
+#include <imgui.h>
+
+#include <SDL3/SDL.h>
+
+#include "capture.hpp"
+#include "global.hpp"
+#include "io.hpp"
+#include "present.hpp"
+#include "profiler.hpp"
+#include "util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Pacing {
+// Frame pacing for the main loop. In on-demand mode the loop blocks in SDL_WaitEventTimeout until
+// there is a reason to draw: an event, the periodic redraw timer, or ImGui still animating (an item
+// held or a text field blinking). Independently, the frame limiter caps the loop at g_TargetFps by
+// sleeping to just before the deadline and spinning the rest.
+using Clock = std::chrono::steady_clock;
+
+bool g_OnDemand = false;
+uint32_t g_TargetFps = 0; // 0 = only limited by the present mode
+uint32_t g_RedrawsPending = Constants::on_demand_settle_frames;
+Clock::time_point g_LastDraw;
+Clock::time_point g_NextDeadline;
+
+// Idle accounting, published every idle_report_interval_s
+Clock::time_point g_IntervalStart;
+double g_IntervalIdleMs = 0.0; // Main thread blocked on events or sleeping in the limiter
+double g_IntervalGpuMs = 0.0;
+uint32_t g_IntervalFrames = 0;
+float g_CpuIdlePercent = 0.0f;
+float g_GpuIdlePercent = 0.0f;
+float g_DrawsPerSecond = 0.0f;
+
+void request_redraw(uint32_t frames = Constants::on_demand_settle_frames) {
+    g_RedrawsPending = std::max(g_RedrawsPending, frames);
+}
+
+bool redraw_due() {
+    return !g_OnDemand || g_RedrawsPending > 0 || g_SwapChainRebuild || g_ResizePending || Present::g_ModeChanged;
+}
+
+void handle(SDL_Event &event) {
+    Capture::record_event(event);
+    IO::handle_event(event);
+    request_redraw();
+}
+
+// Blocks while minimized, or in on-demand mode until a redraw is due, before the frame starts so the
+// wait never shows up in the profiler. Handles at most the one event it woke up for.
+void wait_for_events() {
+    SDL_Event event;
+    bool minimized = SDL_GetWindowFlags(g_Window) & SDL_WINDOW_MINIMIZED;
+    if (minimized || !redraw_due()) {
+        int32_t timeout_ms = Constants::minimized_wait_ms;
+        if (!minimized) {
+            auto next_timer = g_LastDraw + std::chrono::milliseconds(Constants::on_demand_redraw_interval_ms);
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(next_timer - Clock::now()).count();
+            timeout_ms = static_cast<int32_t>(std::max<int64_t>(remaining, 0));
+        }
+        auto start = Clock::now();
+        bool got_event = SDL_WaitEventTimeout(&event, timeout_ms);
+        g_IntervalIdleMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (got_event) {
+            handle(event);
+        } else if (!minimized) {
+            request_redraw(1); // Timer
+        }
+    }
+}
+
+// Replaces the SDL_PollEvent loop, drains whatever is queued. Call once the frame has begun.
+void poll_events() {
+    DS_PROFILE_SCOPE("Event polling");
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) handle(event);
+}
+
+// Call after building the GUI, before ImGui::Render
+void check_animations() {
+    if (ImGui::IsAnyItemActive() || g_IO->WantTextInput) request_redraw(1);
+}
+
+// Sleeps until the next frame deadline. A frame that missed its deadline moves the schedule
+// forward instead of being caught up with a burst of unlimited frames.
+void limit() {
+    if (g_TargetFps == 0) {
+        g_NextDeadline = {};
+        return;
+    }
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / g_TargetFps));
+    Clock::time_point now = Clock::now();
+    g_NextDeadline = std::max(g_NextDeadline + period, now);
+    Clock::time_point sleep_until = g_NextDeadline - std::chrono::microseconds(Constants::limiter_spin_us);
+    if (now < sleep_until) {
+        std::this_thread::sleep_until(sleep_until);
+        g_IntervalIdleMs += std::chrono::duration<double, std::milli>(Clock::now() - now).count();
+    }
+    while (Clock::now() < g_NextDeadline) std::this_thread::yield();
+}
+
+// Call once per rendered frame
+void frame_drawn() {
+    Clock::time_point now = Clock::now();
+    g_LastDraw = now;
+    if (g_RedrawsPending > 0) --g_RedrawsPending;
+    g_IntervalGpuMs += Profiler::g_LastGpuMs;
+    ++g_IntervalFrames;
+}
+
+// Call once per loop iteration, drawn or not
+void update_stats() {
+    Clock::time_point now = Clock::now();
+    if (g_IntervalStart == Clock::time_point{}) g_IntervalStart = now;
+    double interval_ms = std::chrono::duration<double, std::milli>(now - g_IntervalStart).count();
+    if (interval_ms < Constants::idle_report_interval_s * 1000.0) return;
+    g_CpuIdlePercent = static_cast<float>(std::clamp(100.0 * g_IntervalIdleMs / interval_ms, 0.0, 100.0));
+    g_GpuIdlePercent = static_cast<float>(std::clamp(100.0 - 100.0 * g_IntervalGpuMs / interval_ms, 0.0, 100.0));
+    g_DrawsPerSecond = static_cast<float>(g_IntervalFrames * 1000.0 / interval_ms);
+    g_IntervalStart = now;
+    g_IntervalIdleMs = 0.0;
+    g_IntervalGpuMs = 0.0;
+    g_IntervalFrames = 0;
+}
+} // namespace DS::Pacing
@@ -0,0 +1,192 @@
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "global.hpp"
+#include "log.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::PipelineCache {
+constexpr uint32_t file_magic = 0x43505344; // "DSPC"
+constexpr uint32_t file_version = 1;
+
+// Prepended to the raw vkGetPipelineCacheData blob. The driver validates its own header too, but
+// checking here lets us log *why* a cache was rejected (driver update, other GPU, corruption).
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+    uint64_t checksum;
+};
+
+// Whether the cache was seeded from disk, used to tag the cold/warm start timings
+bool g_Warm = false;
+uint64_t g_SeededChecksum = 0;
+
+uint64_t fnv1a(const std::vector<uint8_t> &data) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint8_t byte : data) {
+        hash ^= byte;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+FileHeader make_header(const VkPhysicalDeviceProperties &properties, const std::vector<uint8_t> &data) {
+    FileHeader header = {};
+    header.magic = file_magic;
+    header.version = file_version;
+    header.vendor_id = properties.vendorID;
+    header.device_id = properties.deviceID;
+    header.driver_version = properties.driverVersion;
+    std::memcpy(header.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.data_size = data.size();
+    header.checksum = fnv1a(data);
+    return header;
+}
+
+// Reads the cache file and returns its payload, empty if missing or not produced by this device/driver
+std::vector<uint8_t> read_file(const VkPhysicalDeviceProperties &properties, uint64_t *checksum = nullptr) {
+    std::ifstream file(Constants::pipeline_cache_path, std::ios::binary);
+    if (!file) {
+        DS_LOG_INFO(Vulkan, "No pipeline cache at '{}'", Constants::pipeline_cache_path);
+        return {};
+    }
+
+    FileHeader header = {};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        DS_LOG_WARNING(Vulkan, "Pipeline cache '{}' is truncated, ignoring it", Constants::pipeline_cache_path);
+        return {};
+    }
+    if (header.magic != file_magic || header.version != file_version) {
+        DS_LOG_WARNING(Vulkan, "Pipeline cache '{}' has an unknown format, ignoring it", Constants::pipeline_cache_path);
+        return {};
+    }
+    if (header.vendor_id != properties.vendorID || header.device_id != properties.deviceID) {
+        DS_LOG_INFO(Vulkan, "Pipeline cache was written by another device ({:#x}:{:#x}), ignoring it",
+            header.vendor_id, header.device_id);
+        return {};
+    }
+    if (header.driver_version != properties.driverVersion) {
+        DS_LOG_INFO(Vulkan, "Pipeline cache was written by driver version {} (current {}), ignoring it",
+            header.driver_version, properties.driverVersion);
+        return {};
+    }
+    if (std::memcmp(header.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        DS_LOG_INFO(Vulkan, "Pipeline cache UUID {} does not match device UUID {}, ignoring it",
+            Util::uuid_to_string(header.pipeline_cache_uuid),
+            Util::uuid_to_string(properties.pipelineCacheUUID));
+        return {};
+    }
+
+    // The size is untrusted until it fits the rest of the file
+    const std::streamoff payload_start = file.tellg();
+    file.seekg(0, std::ios::end);
+    const std::streamoff remaining = file.tellg() - payload_start;
+    file.seekg(payload_start);
+    if (header.data_size > Constants::pipeline_cache_max_size || remaining < 0 ||
+        header.data_size != static_cast<uint64_t>(remaining)) {
+        DS_LOG_WARNING(Vulkan, "Pipeline cache '{}' claims {} bytes but holds {}, ignoring it",
+            Constants::pipeline_cache_path, header.data_size, remaining);
+        return {};
+    }
+    std::vector<uint8_t> data(header.data_size);
+    if (!file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size())) || fnv1a(data) != header.checksum) {
+        DS_LOG_WARNING(Vulkan, "Pipeline cache '{}' is corrupted, ignoring it", Constants::pipeline_cache_path);
+        return {};
+    }
+    if (checksum) *checksum = header.checksum;
+    return data;
+}
+
+// Writes to a sibling temp file first and renames it over the old cache, so a crash mid-write
+// never leaves a half-written cache behind
+bool write_file(const VkPhysicalDeviceProperties &properties, const std::vector<uint8_t> &data) {
+    const std::filesystem::path path = Constants::pipeline_cache_path;
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        FileHeader header = make_header(properties, data);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        file.flush();
+        if (!file) {
+            DS_LOG_ERROR(Vulkan, "Failed to write pipeline cache '{}'", tmp_path.string());
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        DS_LOG_ERROR(Vulkan, "Failed to replace pipeline cache '{}': {}", path.string(), ec.message());
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+void create() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+
+    std::vector<uint8_t> data = read_file(properties, &g_SeededChecksum);
+    g_Warm = !data.empty();
+
+    VkPipelineCacheCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = data.size();
+    info.pInitialData = data.empty() ? nullptr : data.data();
+    Vulkan::check(vkCreatePipelineCache(g_Device, &info, g_Allocator, &g_PipelineCache));
+    if (g_Warm) DS_LOG_INFO(Vulkan, "Seeded pipeline cache with {} bytes", data.size());
+}
+
+// Merges in whatever another instance may have written since we loaded, then persists the result
+void save_and_destroy() {
+    if (g_PipelineCache == VK_NULL_HANDLE) return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+
+    uint64_t disk_checksum = 0;
+    std::vector<uint8_t> disk_data = read_file(properties, &disk_checksum);
+    if (!disk_data.empty() && disk_checksum != g_SeededChecksum) {
+        VkPipelineCacheCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        info.initialDataSize = disk_data.size();
+        info.pInitialData = disk_data.data();
+        VkPipelineCache disk_cache = VK_NULL_HANDLE;
+        if (vkCreatePipelineCache(g_Device, &info, g_Allocator, &disk_cache) == VK_SUCCESS) {
+            Vulkan::check(vkMergePipelineCaches(g_Device, g_PipelineCache, 1, &disk_cache));
+            vkDestroyPipelineCache(g_Device, disk_cache, g_Allocator);
+            DS_LOG_INFO(Vulkan, "Merged {} bytes of pipeline cache written by another instance", disk_data.size());
+        }
+    }
+
+    size_t size = 0;
+    Vulkan::check(vkGetPipelineCacheData(g_Device, g_PipelineCache, &size, nullptr));
+    std::vector<uint8_t> data(size);
+    Vulkan::check(vkGetPipelineCacheData(g_Device, g_PipelineCache, &size, data.data()));
+    data.resize(size);
+    if (write_file(properties, data)) {
+        DS_LOG_INFO(Vulkan, "Wrote {} bytes of pipeline cache to '{}'", size, Constants::pipeline_cache_path);
+    }
+
+    vkDestroyPipelineCache(g_Device, g_PipelineCache, g_Allocator);
+    g_PipelineCache = VK_NULL_HANDLE;
+}
+} // namespace DS::PipelineCache
@@ -0,0 +1,154 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <format>
+#include <optional>
+#include <print>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "global.hpp"
+#include "log.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Present {
+// Latency modes map to a preference list of present modes, the first one the surface supports wins
+enum class LatencyMode {
+    Vsync,      // FIFO, never tears, up to a full swapchain of latency
+    LowLatency, // MAILBOX replaces queued images so the newest frame is shown at the next vblank
+    Uncapped,   // IMMEDIATE, may tear, for measuring throughput
+};
+
+constexpr auto latency_mode_names = std::to_array<const char *>({"Vsync", "Low latency", "Uncapped"});
+
+constexpr auto vsync_preference = std::to_array<VkPresentModeKHR>({VK_PRESENT_MODE_FIFO_KHR});
+constexpr auto low_latency_preference = std::to_array<VkPresentModeKHR>(
+    {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR});
+constexpr auto uncapped_preference = std::to_array<VkPresentModeKHR>(
+    {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR});
+
+constexpr size_t interval_history_size = 120;
+
+LatencyMode g_LatencyMode = LatencyMode::Vsync;
+// An explicit mode from the CLI or debug UI takes precedence over the latency mode's list
+std::optional<VkPresentModeKHR> g_ExplicitMode;
+std::vector<VkPresentModeKHR> g_SupportedModes;
+bool g_ModeChanged = false;
+
+std::array<float, interval_history_size> g_IntervalHistoryMs = {};
+size_t g_IntervalHead = 0;
+size_t g_IntervalCount = 0;
+std::chrono::steady_clock::time_point g_LastPresent;
+
+// Swapchain rebuild cost on the CPU
+uint32_t g_RebuildCount = 0;
+float g_LastRebuildMs = 0.0f;
+float g_TotalRebuildMs = 0.0f;
+
+std::span<const VkPresentModeKHR> preference(LatencyMode mode) {
+    switch (mode) {
+    case LatencyMode::LowLatency:
+        return low_latency_preference;
+    case LatencyMode::Uncapped:
+        return uncapped_preference;
+    case LatencyMode::Vsync:
+    default:
+        return vsync_preference;
+    }
+}
+
+bool is_supported(VkPresentModeKHR mode) {
+    return std::find(g_SupportedModes.begin(), g_SupportedModes.end(), mode) != g_SupportedModes.end();
+}
+
+void query_supported_modes(VkSurfaceKHR surface) {
+    uint32_t count = 0;
+    Vulkan::check(vkGetPhysicalDeviceSurfacePresentModesKHR(g_PhysicalDevice, surface, &count, nullptr));
+    g_SupportedModes.resize(count);
+    Vulkan::check(vkGetPhysicalDeviceSurfacePresentModesKHR(g_PhysicalDevice, surface, &count, g_SupportedModes.data()));
+    DS_LOG_INFO(Vulkan, "Surface supports {} present modes", count);
+    for (VkPresentModeKHR mode : g_SupportedModes) {
+        DS_LOG_INFO(Vulkan, "\t{}", mode);
+    }
+}
+
+// FIFO is the only mode the spec guarantees, so it is the final fallback
+VkPresentModeKHR select() {
+    if (g_ExplicitMode) {
+        if (is_supported(*g_ExplicitMode)) return *g_ExplicitMode;
+        DS_LOG_WARNING(Vulkan, "Requested present mode {} is not supported, using latency mode preference", *g_ExplicitMode);
+    }
+    for (VkPresentModeKHR mode : preference(g_LatencyMode)) {
+        if (is_supported(mode)) return mode;
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+// Takes effect at the next recreate_swapchains_if_necessary
+void request_latency_mode(LatencyMode mode) {
+    g_LatencyMode = mode;
+    g_ExplicitMode.reset();
+    g_ModeChanged = true;
+}
+
+void request_mode(VkPresentModeKHR mode) {
+    g_ExplicitMode = mode;
+    g_ModeChanged = true;
+}
+
+// Call after every successful vkQueuePresentKHR; the CPU-side interval between presents is what
+// the present mode actually paces us at
+void record_present() {
+    auto now = std::chrono::steady_clock::now();
+    if (g_LastPresent != std::chrono::steady_clock::time_point{}) {
+        g_IntervalHistoryMs[g_IntervalHead] = std::chrono::duration<float, std::milli>(now - g_LastPresent).count();
+        g_IntervalHead = (g_IntervalHead + 1) % interval_history_size;
+        g_IntervalCount = std::min(g_IntervalCount + 1, interval_history_size);
+    }
+    g_LastPresent = now;
+}
+
+// The swapchain is rebuilt on a mode change, don't count the gap
+void reset_interval() {
+    g_LastPresent = {};
+}
+
+void record_rebuild(float ms) {
+    ++g_RebuildCount;
+    g_LastRebuildMs = ms;
+    g_TotalRebuildMs += ms;
+}
+
+float average_rebuild_ms() {
+    return g_RebuildCount == 0 ? 0.0f : g_TotalRebuildMs / static_cast<float>(g_RebuildCount);
+}
+
+float average_interval_ms() {
+    if (g_IntervalCount == 0) return 0.0f;
+    float sum = 0.0f;
+    for (size_t i = 0; i < g_IntervalCount; ++i) sum += g_IntervalHistoryMs[i];
+    return sum / static_cast<float>(g_IntervalCount);
+}
+
+std::optional<VkPresentModeKHR> parse_mode(std::string_view name) {
+    if (name == "fifo") return VK_PRESENT_MODE_FIFO_KHR;
+    if (name == "fifo_relaxed") return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    if (name == "mailbox") return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (name == "immediate") return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    return std::nullopt;
+}
+
+std::optional<LatencyMode> parse_latency_mode(std::string_view name) {
+    if (name == "vsync") return LatencyMode::Vsync;
+    if (name == "low") return LatencyMode::LowLatency;
+    if (name == "uncapped") return LatencyMode::Uncapped;
+    return std::nullopt;
+}
+} // namespace DS::Present
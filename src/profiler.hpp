@@ -0,0 +1,181 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <print>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "global.hpp"
+#include "log.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+// Set through the VULKANENGINE_PROFILER CMake option. With it off DS_PROFILE_SCOPE expands to nothing,
+// and everything below is behind `if constexpr (Profiler::enabled)`, so it compiles out completely.
+#ifndef DS_PROFILER
+#define DS_PROFILER 0
+#endif
+
+#if DS_PROFILER
+#define DS_PROFILE_CONCAT_INNER(a, b) a##b
+#define DS_PROFILE_CONCAT(a, b) DS_PROFILE_CONCAT_INNER(a, b)
+#define DS_PROFILE_SCOPE(name)                                                                                  \
+    static const uint32_t DS_PROFILE_CONCAT(ds_profile_id_, __LINE__) = DS::Profiler::register_scope(name); \
+    DS::Profiler::ScopeTimer DS_PROFILE_CONCAT(ds_profile_timer_, __LINE__)(DS_PROFILE_CONCAT(ds_profile_id_, __LINE__))
+#else
+#define DS_PROFILE_SCOPE(name) ((void)0)
+#endif
+
+using std::println, std::print;
+
+namespace DS::Profiler {
+constexpr bool enabled = DS_PROFILER;
+
+constexpr size_t history_size = 240;
+constexpr uint32_t max_gpu_slots = 16;
+constexpr uint32_t queries_per_slot = 2;
+static_assert(max_gpu_slots >= Constants::max_frames_in_flight);
+
+using Clock = std::chrono::steady_clock;
+using History = std::array<float, history_size>;
+
+struct Scope {
+    const char *name;
+    double accumulated_ms;
+    History history_ms;
+};
+
+std::vector<Scope> g_Scopes;
+History g_FrameHistoryMs = {};
+History g_GpuHistoryMs = {};
+size_t g_HistoryHead = 0;
+size_t g_HistoryCount = 0;
+Clock::time_point g_FrameStart;
+
+VkQueryPool g_QueryPool = VK_NULL_HANDLE;
+double g_TimestampPeriodNs = 0.0;
+uint64_t g_TimestampMask = 0;
+std::array<bool, max_gpu_slots> g_GpuSlotPending = {};
+double g_LastGpuMs = 0.0;
+
+uint32_t register_scope(const char *name) {
+    g_Scopes.push_back({.name = name, .accumulated_ms = 0.0, .history_ms = {}});
+    return static_cast<uint32_t>(g_Scopes.size() - 1);
+}
+
+// Accumulates into the scope's per-frame total, so scopes hit several times a frame add up
+struct ScopeTimer {
+    uint32_t id;
+    Clock::time_point start;
+
+    explicit ScopeTimer(uint32_t scope_id) : id(scope_id), start(Clock::now()) {}
+    ~ScopeTimer() {
+        g_Scopes[id].accumulated_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    ScopeTimer(const ScopeTimer &) = delete;
+    ScopeTimer &operator=(const ScopeTimer &) = delete;
+};
+
+// Call once per drawn frame, after the main loop has stopped waiting for events, so on-demand idle
+// time never shows up as a frame
+void begin_frame() {
+    if constexpr (!enabled) return;
+    g_FrameStart = Clock::now();
+}
+
+// Call at the bottom of the main loop; closes the frame and pushes it into the history
+void end_frame() {
+    if constexpr (!enabled) return;
+    if (g_FrameStart == Clock::time_point{}) return;
+    g_FrameHistoryMs[g_HistoryHead] = std::chrono::duration<float, std::milli>(Clock::now() - g_FrameStart).count();
+    g_GpuHistoryMs[g_HistoryHead] = static_cast<float>(g_LastGpuMs);
+    for (Scope &scope : g_Scopes) {
+        scope.history_ms[g_HistoryHead] = static_cast<float>(scope.accumulated_ms);
+        scope.accumulated_ms = 0.0;
+    }
+    g_HistoryHead = (g_HistoryHead + 1) % history_size;
+    g_HistoryCount = std::min(g_HistoryCount + 1, history_size);
+    g_FrameStart = {};
+}
+
+// Index of the most recently completed frame in the history rings
+size_t latest() {
+    return (g_HistoryHead + history_size - 1) % history_size;
+}
+
+float percentile(const History &history, float p) {
+    if (g_HistoryCount == 0) return 0.0f;
+    std::array<float, history_size> sorted;
+    std::copy_n(history.begin(), g_HistoryCount, sorted.begin());
+    auto nth = sorted.begin() + static_cast<ptrdiff_t>(p * static_cast<float>(g_HistoryCount - 1));
+    std::nth_element(sorted.begin(), nth, sorted.begin() + static_cast<ptrdiff_t>(g_HistoryCount));
+    return *nth;
+}
+
+void setup_gpu() {
+    if constexpr (!enabled) return;
+
+    uint32_t count;
+    vkGetPhysicalDeviceQueueFamilyProperties(g_PhysicalDevice, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(g_PhysicalDevice, &count, families.data());
+    uint32_t valid_bits = families[g_QueueFamily].timestampValidBits;
+    if (valid_bits == 0) {
+        DS_LOG_WARNING(Vulkan, "Graphics queue does not support timestamps, GPU profiling disabled");
+        return;
+    }
+    g_TimestampMask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+    g_TimestampPeriodNs = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    info.queryCount = max_gpu_slots * queries_per_slot;
+    Vulkan::check(vkCreateQueryPool(g_Device, &info, g_Allocator, &g_QueryPool));
+}
+
+void destroy_gpu() {
+    if (g_QueryPool == VK_NULL_HANDLE) return;
+    vkDestroyQueryPool(g_Device, g_QueryPool, g_Allocator);
+    g_QueryPool = VK_NULL_HANDLE;
+    g_GpuSlotPending = {};
+}
+
+// Must be called after the slot's fence was waited on: picks up the slot's previous timings,
+// then resets its queries and writes the start timestamp.
+void gpu_begin(VkCommandBuffer cmd, uint32_t slot) {
+    if constexpr (!enabled) return;
+    if (g_QueryPool == VK_NULL_HANDLE || slot >= max_gpu_slots) return;
+
+    uint32_t first_query = slot * queries_per_slot;
+    if (g_GpuSlotPending[slot]) {
+        std::array<uint64_t, queries_per_slot> timestamps;
+        VkResult err = vkGetQueryPoolResults(
+            g_Device, g_QueryPool, first_query, queries_per_slot,
+            sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT);
+        if (err == VK_SUCCESS) {
+            uint64_t ticks = (timestamps[1] - timestamps[0]) & g_TimestampMask;
+            g_LastGpuMs = static_cast<double>(ticks) * g_TimestampPeriodNs * 1e-6;
+        }
+        g_GpuSlotPending[slot] = false;
+    }
+    vkCmdResetQueryPool(cmd, g_QueryPool, first_query, queries_per_slot);
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, g_QueryPool, first_query);
+}
+
+void gpu_end(VkCommandBuffer cmd, uint32_t slot) {
+    if constexpr (!enabled) return;
+    if (g_QueryPool == VK_NULL_HANDLE || slot >= max_gpu_slots) return;
+
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, g_QueryPool, slot * queries_per_slot + 1);
+    g_GpuSlotPending[slot] = true;
+}
+} // namespace DS::Profiler
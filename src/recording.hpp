@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <limits>
+#include <print>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "global.hpp"
+#include "jobs.hpp"
+#include "log.hpp"
+#include "profiler.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Recording {
+// Parallel secondary command buffer recording on the job system. Every frame slot owns one command
+// pool per job thread, a job always records into the pool of the thread it runs on, so pools are
+// never shared between threads, and a slot's pools are reset together once its fence has signalled.
+// Task i always lands at index i of the result, whichever thread recorded it, so the primary
+// executes them in a deterministic order.
+using Task = std::function<void(VkCommandBuffer cmd)>;
+
+struct WorkerPool {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> secondaries; // Allocated on demand, reused after reset
+    uint32_t used = 0;
+};
+
+std::vector<std::vector<WorkerPool>> g_Pools; // [frame slot][job thread]
+std::vector<VkCommandBuffer> g_Recorded;
+bool g_Benchmark = false;
+
+// The job being recorded, read by the share jobs
+struct Job {
+    uint32_t slot = 0;
+    const VkCommandBufferInheritanceInfo *inheritance = nullptr;
+    std::span<const Task> tasks;
+    uint32_t shares = 1;
+};
+Job g_Job;
+
+VkCommandBuffer next_secondary(WorkerPool &worker) {
+    if (worker.used == worker.secondaries.size()) {
+        VkCommandBufferAllocateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        info.commandPool = worker.pool;
+        info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        info.commandBufferCount = 1;
+        VkCommandBuffer cmd;
+        Vulkan::check(vkAllocateCommandBuffers(g_Device, &info, &cmd));
+        worker.secondaries.push_back(cmd);
+    }
+    return worker.secondaries[worker.used++];
+}
+
+// Static round-robin split: share s records tasks s, s + n, s + 2n, ...
+void record_share(uint32_t share) {
+    WorkerPool &worker = g_Pools[g_Job.slot][Jobs::thread_index()];
+    for (size_t i = share; i < g_Job.tasks.size(); i += g_Job.shares) {
+        VkCommandBuffer cmd = next_secondary(worker);
+        VkCommandBufferBeginInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        info.pInheritanceInfo = g_Job.inheritance;
+        Vulkan::check(vkBeginCommandBuffer(cmd, &info));
+        g_Job.tasks[i](cmd);
+        Vulkan::check(vkEndCommandBuffer(cmd));
+        g_Recorded[i] = cmd;
+    }
+}
+
+// Call after Jobs::setup()
+void setup() {
+    g_Pools.resize(g_FramesInFlight);
+    for (auto &slot : g_Pools) {
+        slot.resize(Jobs::g_ThreadCount);
+        for (WorkerPool &worker : slot) {
+            VkCommandPoolCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            info.queueFamilyIndex = g_QueueFamily;
+            Vulkan::check(vkCreateCommandPool(g_Device, &info, g_Allocator, &worker.pool));
+        }
+    }
+}
+
+// Only valid once the device is idle
+void cleanup() {
+    for (auto &slot : g_Pools) {
+        for (WorkerPool &worker : slot) vkDestroyCommandPool(g_Device, worker.pool, g_Allocator);
+    }
+    g_Pools.clear();
+}
+
+// Call once the slot's fence has signalled
+void reset(uint32_t slot) {
+    for (WorkerPool &worker : g_Pools[slot]) {
+        Vulkan::check(vkResetCommandPool(g_Device, worker.pool, Constants::no_flags));
+        worker.used = 0;
+    }
+}
+
+// Records one secondary per task, split into `shares` jobs (one per job thread by default), and
+// returns them in task order. The result is valid until the next record().
+std::span<const VkCommandBuffer> record(uint32_t slot, const VkCommandBufferInheritanceInfo &inheritance, std::span<const Task> tasks, uint32_t shares = 0) {
+    DS_PROFILE_SCOPE("Recording::record");
+    g_Recorded.resize(tasks.size());
+    g_Job = {
+        .slot = slot,
+        .inheritance = &inheritance,
+        .tasks = tasks,
+        .shares = std::clamp(shares == 0 ? Jobs::g_ThreadCount : shares, 1u, std::max<uint32_t>(1, static_cast<uint32_t>(tasks.size())))};
+    if (g_Job.shares == 1) {
+        record_share(0);
+        return g_Recorded;
+    }
+    Jobs::Counter counter;
+    for (uint32_t share = 1; share < g_Job.shares; ++share) {
+        Jobs::run([share] { record_share(share); }, &counter);
+    }
+    record_share(0);
+    Jobs::wait(counter);
+    return g_Recorded;
+}
+
+// Records the same synthetic workload split over 1..Jobs::g_ThreadCount shares and reports the throughput.
+// Each task is a batch of dynamic state commands, cheap on the GPU but representative of the CPU
+// cost of recording draws. Nothing is submitted.
+void benchmark(const VkCommandBufferInheritanceInfo &inheritance) {
+    using Clock = std::chrono::steady_clock;
+    Vulkan::check(vkDeviceWaitIdle(g_Device));
+
+    std::vector<Task> tasks(Constants::bench_record_tasks, [](VkCommandBuffer cmd) {
+        for (uint32_t i = 0; i < Constants::bench_record_commands; ++i) {
+            VkViewport viewport = {0.0f, 0.0f, static_cast<float>(i % 1024 + 1), 1.0f, 0.0f, 1.0f};
+            VkRect2D scissor = {{0, 0}, {i % 1024 + 1, 1}};
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+        }
+    });
+    DS_LOG_INFO(Render, "Recording benchmark, {} secondaries x {} commands, best of {} runs",
+        Constants::bench_record_tasks, Constants::bench_record_commands * 2, Constants::bench_record_runs);
+    double single_thread_ms = 0.0;
+    for (uint32_t threads = 1; threads <= Jobs::g_ThreadCount; ++threads) {
+        double best_ms = std::numeric_limits<double>::max();
+        for (uint32_t run = 0; run < Constants::bench_record_runs; ++run) {
+            reset(0);
+            Jobs::begin_frame();
+            auto start = Clock::now();
+            record(0, inheritance, tasks, threads);
+            best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        if (threads == 1) single_thread_ms = best_ms;
+        double commands_per_s = Constants::bench_record_tasks * Constants::bench_record_commands * 2 / (best_ms / 1000.0);
+        DS_LOG_INFO(Render, "\t{:2} threads {:8.3f} ms {:8.2f} Mcmd/s  x{:.2f}",
+            threads, best_ms, commands_per_s / 1e6, single_thread_ms / best_ms);
+    }
+    reset(0);
+}
+} // namespace DS::Recording
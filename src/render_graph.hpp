@@ -0,0 +1,632 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <functional>
+#include <print>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "deletion_queue.hpp"
+#include "global.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+#include "util.hpp"
+#include "validation.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::RenderGraph {
+// Frame render graph. Passes declare the resources they read and write, in execution order, and
+// compile() turns that into:
+//   - the passes that contribute to an output, the rest are culled;
+//   - one barrier batch in front of each pass, with the fewest barriers that cover every hazard;
+//   - memory for the transient images, shared between those whose lifetimes don't overlap.
+// The compiled graph is reused every frame. Imported resources (the backbuffer, per-frame buffers)
+// are bound before execute(), which only patches their handles into the precomputed barriers, so
+// the graph only needs rebuilding when resources change shape, e.g. on resize.
+//
+// Barriers go through vkCmdPipelineBarrier2 when synchronization2 is enabled, otherwise each batch
+// is folded into one vkCmdPipelineBarrier call.
+using ResourceId = uint32_t;
+using PassId = uint32_t;
+using Execute = std::function<void(VkCommandBuffer)>;
+
+constexpr uint32_t no_slot = UINT32_MAX;
+
+enum class Access : uint32_t {
+    ColorAttachment,
+    DepthAttachment, // Tested and written
+    DepthRead,
+    SampledFragment,
+    SampledCompute,
+    StorageRead, // Compute
+    StorageWrite,
+    IndirectRead,
+    TransferSrc,
+    TransferDst,
+};
+
+struct State {
+    VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 access = VK_ACCESS_2_NONE;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+struct AccessInfo {
+    State state;
+    bool write;
+    VkImageUsageFlags usage; // What a transient image has to be created with
+};
+
+constexpr AccessInfo access_info(Access access) {
+    switch (access) {
+    case Access::ColorAttachment:
+        return {{VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+            true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+    case Access::DepthAttachment:
+        return {{VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL},
+            true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+    case Access::DepthRead:
+        return {{VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL},
+            false, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+    case Access::SampledFragment:
+        return {{VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+            false, VK_IMAGE_USAGE_SAMPLED_BIT};
+    case Access::SampledCompute:
+        return {{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+            false, VK_IMAGE_USAGE_SAMPLED_BIT};
+    case Access::StorageRead:
+        return {{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL},
+            false, VK_IMAGE_USAGE_STORAGE_BIT};
+    case Access::StorageWrite:
+        return {{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL},
+            true, VK_IMAGE_USAGE_STORAGE_BIT};
+    case Access::IndirectRead:
+        return {{VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED},
+            false, 0};
+    case Access::TransferSrc:
+        return {{VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL},
+            false, VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+    case Access::TransferDst:
+    default:
+        return {{VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL},
+            true, VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+    }
+}
+
+constexpr bool is_attachment(Access access) {
+    return access == Access::ColorAttachment || access == Access::DepthAttachment || access == Access::DepthRead;
+}
+
+struct Resource {
+    std::string name;
+    bool is_image = true;
+    bool imported = false;
+    VkImageAspectFlags aspect = 0;
+    State initial;                                          // Imported: the last use before the frame
+    VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED; // Imported images: left like this, UNDEFINED = don't care
+    // Transient images
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = {};
+    VkImageUsageFlags usage = 0;
+    uint32_t slot = no_slot;
+    uint32_t first_use = 0; // Indices into the executed passes
+    uint32_t last_use = 0;
+    // Bound for the current frame, or owned by the graph for transients
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+};
+
+struct Use {
+    ResourceId resource;
+    Access access;
+};
+
+// Handles are patched in at execution, barriers on resources that aren't bound this frame are dropped
+struct Batch {
+    std::vector<VkImageMemoryBarrier2> images;
+    std::vector<ResourceId> image_ids;
+    std::vector<VkBufferMemoryBarrier2> buffers;
+    std::vector<ResourceId> buffer_ids;
+
+    bool empty() const {
+        return images.empty() && buffers.empty();
+    }
+};
+
+struct Pass {
+    std::string name;
+    std::vector<Use> uses;
+    Execute execute;
+    bool side_effects = false; // Never culled, e.g. a readback
+    bool render_pass = false;  // Its attachments are transitioned by a VkRenderPass, not by the graph
+    bool culled = false;
+    Batch before;
+};
+
+// Memory shared by transient images with disjoint lifetimes
+struct Slot {
+    VkMemoryRequirements requirements = {};
+    Memory::Allocation allocation;
+    std::vector<ResourceId> occupants; // In order of first use
+};
+
+struct Graph {
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<Slot> slots;
+    Batch after; // Final layouts of the imported images
+    bool compiled = false;
+
+    uint32_t culled_passes = 0;
+    uint32_t barrier_count = 0;
+    uint32_t batch_count = 0;
+    VkDeviceSize transient_bytes = 0; // Allocated, and what it would take without aliasing
+    VkDeviceSize unaliased_bytes = 0;
+};
+
+// Scratch for execute(), main thread only
+std::vector<VkImageMemoryBarrier2> g_ImageBarriers;
+std::vector<VkBufferMemoryBarrier2> g_BufferBarriers;
+std::vector<VkImageMemoryBarrier> g_LegacyImageBarriers;
+std::vector<VkBufferMemoryBarrier> g_LegacyBufferBarriers;
+
+// `initial` is how the previous user left the image, the graph waits for it before the first use
+ResourceId import_image(Graph &graph, std::string name, VkImageAspectFlags aspect, State initial, VkImageLayout final_layout) {
+    Resource resource;
+    resource.name = std::move(name);
+    resource.imported = true;
+    resource.aspect = aspect;
+    resource.initial = initial;
+    resource.final_layout = final_layout;
+    graph.resources.push_back(std::move(resource));
+    return static_cast<ResourceId>(graph.resources.size() - 1);
+}
+
+// Buffers start every frame without pending work, frame fences order them against earlier frames
+ResourceId import_buffer(Graph &graph, std::string name) {
+    Resource resource;
+    resource.name = std::move(name);
+    resource.is_image = false;
+    resource.imported = true;
+    graph.resources.push_back(std::move(resource));
+    return static_cast<ResourceId>(graph.resources.size() - 1);
+}
+
+// Created by compile(), only valid within a frame: every frame starts with undefined contents
+ResourceId create_image(Graph &graph, std::string name, VkFormat format, VkExtent2D extent, VkImageAspectFlags aspect) {
+    Resource resource;
+    resource.name = std::move(name);
+    resource.aspect = aspect;
+    resource.format = format;
+    resource.extent = extent;
+    graph.resources.push_back(std::move(resource));
+    return static_cast<ResourceId>(graph.resources.size() - 1);
+}
+
+PassId add_pass(Graph &graph, std::string name, Execute execute, bool side_effects = false) {
+    Pass pass;
+    pass.name = std::move(name);
+    pass.execute = std::move(execute);
+    pass.side_effects = side_effects;
+    graph.passes.push_back(std::move(pass));
+    return static_cast<PassId>(graph.passes.size() - 1);
+}
+
+void set_render_pass(Graph &graph, PassId pass, bool render_pass) {
+    graph.passes[pass].render_pass = render_pass;
+}
+
+// A pass uses each resource once, DepthAttachment and StorageWrite already include the read
+void use(Graph &graph, PassId pass, ResourceId resource, Access access) {
+    Pass &p = graph.passes[pass];
+    for (const Use &u : p.uses) {
+        if (u.resource == resource) {
+            DS_LOG_ERROR(Render, "Pass '{}' uses '{}' twice", p.name, graph.resources[resource].name);
+            abort();
+        }
+    }
+    p.uses.push_back({resource, access});
+}
+
+void bind_image(Graph &graph, ResourceId resource, VkImage image, VkImageView view) {
+    graph.resources[resource].image = image;
+    graph.resources[resource].view = view;
+}
+
+void bind_buffer(Graph &graph, ResourceId resource, VkBuffer buffer) {
+    graph.resources[resource].buffer = buffer;
+}
+
+VkImageView view(const Graph &graph, ResourceId resource) {
+    return graph.resources[resource].view;
+}
+
+// Walks back from the outputs: a pass survives if it has side effects or writes something a
+// surviving later pass reads or the frame hands on
+void cull(Graph &graph) {
+    std::vector<bool> needed(graph.resources.size(), false);
+    for (ResourceId id = 0; id < graph.resources.size(); ++id) {
+        needed[id] = graph.resources[id].final_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    graph.culled_passes = 0;
+    for (size_t i = graph.passes.size(); i-- > 0;) {
+        Pass &pass = graph.passes[i];
+        bool alive = pass.side_effects || std::any_of(pass.uses.begin(), pass.uses.end(), [&](const Use &use) {
+            return access_info(use.access).write && needed[use.resource];
+        });
+        pass.culled = !alive;
+        if (!alive) {
+            ++graph.culled_passes;
+            continue;
+        }
+        for (const Use &use : pass.uses) {
+            if (!access_info(use.access).write || use.access == Access::DepthAttachment || use.access == Access::StorageWrite) {
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+// Stages and writes of `resource` since its last write, as the next user has to wait for them
+State last_state(const Graph &graph, const std::vector<PassId> &executed, ResourceId resource) {
+    State state;
+    for (PassId pass : executed) {
+        for (const Use &use : graph.passes[pass].uses) {
+            if (use.resource != resource) continue;
+            AccessInfo info = access_info(use.access);
+            if (info.write) {
+                state = info.state;
+            } else {
+                state.stages |= info.state.stages;
+                state.layout = info.state.layout;
+            }
+        }
+    }
+    return state;
+}
+
+void create_transients(Graph &graph, const std::vector<PassId> &executed) {
+    std::vector<ResourceId> transients;
+    for (ResourceId id = 0; id < graph.resources.size(); ++id) {
+        Resource &resource = graph.resources[id];
+        if (resource.imported) continue;
+        bool used = false;
+        resource.usage = 0;
+        for (uint32_t i = 0; i < executed.size(); ++i) {
+            for (const Use &use : graph.passes[executed[i]].uses) {
+                if (use.resource != id) continue;
+                resource.usage |= access_info(use.access).usage;
+                if (!used) resource.first_use = i;
+                resource.last_use = i;
+                used = true;
+            }
+        }
+        if (used) transients.push_back(id);
+    }
+
+    std::vector<VkMemoryRequirements> requirements(graph.resources.size());
+    for (ResourceId id : transients) {
+        Resource &resource = graph.resources[id];
+        VkImageCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = resource.format;
+        info.extent = {resource.extent.width, resource.extent.height, 1};
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = resource.usage;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Vulkan::check(vkCreateImage(g_Device, &info, g_Allocator, &resource.image));
+        Validation::set_name(VK_OBJECT_TYPE_IMAGE, resource.image, "{} (transient)", resource.name);
+        vkGetImageMemoryRequirements(g_Device, resource.image, &requirements[id]);
+        graph.unaliased_bytes += requirements[id].size;
+    }
+
+    // Largest first, each into the first slot it fits without overlapping a lifetime already there
+    std::sort(transients.begin(), transients.end(), [&](ResourceId a, ResourceId b) {
+        return requirements[a].size > requirements[b].size;
+    });
+    for (ResourceId id : transients) {
+        Resource &resource = graph.resources[id];
+        const VkMemoryRequirements &needs = requirements[id];
+        for (uint32_t s = 0; s < graph.slots.size() && resource.slot == no_slot; ++s) {
+            Slot &slot = graph.slots[s];
+            if ((slot.requirements.memoryTypeBits & needs.memoryTypeBits) == 0) continue;
+            bool overlaps = std::any_of(slot.occupants.begin(), slot.occupants.end(), [&](ResourceId other) {
+                const Resource &o = graph.resources[other];
+                return resource.first_use <= o.last_use && o.first_use <= resource.last_use;
+            });
+            if (overlaps) continue;
+            slot.requirements.size = std::max(slot.requirements.size, needs.size);
+            slot.requirements.alignment = std::max(slot.requirements.alignment, needs.alignment);
+            slot.requirements.memoryTypeBits &= needs.memoryTypeBits;
+            slot.occupants.push_back(id);
+            resource.slot = s;
+        }
+        if (resource.slot == no_slot) {
+            graph.slots.push_back({needs, {}, {id}});
+            resource.slot = static_cast<uint32_t>(graph.slots.size() - 1);
+        }
+    }
+
+    for (Slot &slot : graph.slots) {
+        std::sort(slot.occupants.begin(), slot.occupants.end(), [&](ResourceId a, ResourceId b) {
+            return graph.resources[a].first_use < graph.resources[b].first_use;
+        });
+        slot.allocation = Memory::allocate(slot.requirements, Memory::Usage::GpuOnly, Memory::ResourceKind::Optimal);
+        graph.transient_bytes += slot.requirements.size;
+        for (ResourceId id : slot.occupants) {
+            Resource &resource = graph.resources[id];
+            Vulkan::check(vkBindImageMemory(g_Device, resource.image, slot.allocation.memory, slot.allocation.offset));
+            VkImageViewCreateInfo view_info = {};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = resource.image;
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = resource.format;
+            view_info.subresourceRange = {resource.aspect, 0, 1, 0, 1};
+            Vulkan::check(vkCreateImageView(g_Device, &view_info, g_Allocator, &resource.view));
+        }
+    }
+
+    // A transient takes its memory over from the previous occupant, the first one from the last
+    // occupant in the previous frame
+    for (const Slot &slot : graph.slots) {
+        for (size_t i = 0; i < slot.occupants.size(); ++i) {
+            ResourceId previous = slot.occupants[(i + slot.occupants.size() - 1) % slot.occupants.size()];
+            State state = last_state(graph, executed, previous);
+            graph.resources[slot.occupants[i]].initial = {state.stages, state.access, VK_IMAGE_LAYOUT_UNDEFINED};
+        }
+    }
+}
+
+void add_barrier(Graph &graph, Batch &batch, ResourceId id, const State &src, const State &dst, VkImageLayout old_layout) {
+    const Resource &resource = graph.resources[id];
+    if (resource.is_image) {
+        VkImageMemoryBarrier2 barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = src.stages;
+        barrier.srcAccessMask = src.access;
+        barrier.dstStageMask = dst.stages;
+        barrier.dstAccessMask = dst.access;
+        barrier.oldLayout = old_layout;
+        barrier.newLayout = dst.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = {resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+        batch.images.push_back(barrier);
+        batch.image_ids.push_back(id);
+    } else {
+        VkBufferMemoryBarrier2 barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        barrier.srcStageMask = src.stages;
+        barrier.srcAccessMask = src.access;
+        barrier.dstStageMask = dst.stages;
+        barrier.dstAccessMask = dst.access;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        batch.buffers.push_back(barrier);
+        batch.buffer_ids.push_back(id);
+    }
+    ++graph.barrier_count;
+}
+
+// Per resource while walking the executed passes
+struct Tracked {
+    State write;                        // Last write, what readers have to wait for
+    VkPipelineStageFlags2 reads = 0;    // Stages that read since, what the next write has to wait for
+    VkPipelineStageFlags2 visible = 0;  // Stages the last write was already made visible to
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+void place_barriers(Graph &graph, const std::vector<PassId> &executed) {
+    std::vector<Tracked> tracked(graph.resources.size());
+    for (ResourceId id = 0; id < graph.resources.size(); ++id) {
+        const Resource &resource = graph.resources[id];
+        tracked[id].write = {resource.initial.stages, resource.initial.access};
+        tracked[id].layout = resource.initial.layout;
+    }
+
+    for (uint32_t i = 0; i < executed.size(); ++i) {
+        Pass &pass = graph.passes[executed[i]];
+        for (const Use &use : pass.uses) {
+            const Resource &resource = graph.resources[use.resource];
+            Tracked &t = tracked[use.resource];
+            AccessInfo info = access_info(use.access);
+
+            // The render pass' initial layouts and external dependency already cover its attachments
+            if (pass.render_pass && is_attachment(use.access)) {
+                bool final = resource.final_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+                t = {info.state, 0, 0, final ? resource.final_layout : info.state.layout};
+                continue;
+            }
+
+            bool transition = resource.is_image && t.layout != info.state.layout;
+            if (info.write) {
+                // Write after write and write after read, or just the layout transition
+                if (transition || t.write.stages != 0 || t.reads != 0) {
+                    add_barrier(graph, pass.before, use.resource, {t.write.stages | t.reads, t.write.access}, info.state, t.layout);
+                }
+                t = {info.state, 0, 0, info.state.layout};
+                continue;
+            }
+
+            // Read after write. Makes the write visible to every later reader in the same layout at
+            // once, so they don't need barriers of their own.
+            if (transition || (t.write.access != 0 && (info.state.stages & ~t.visible) != 0)) {
+                State dst = info.state;
+                for (uint32_t j = i + 1; j < executed.size(); ++j) {
+                    bool stop = false;
+                    for (const Use &later : graph.passes[executed[j]].uses) {
+                        if (later.resource != use.resource) continue;
+                        AccessInfo later_info = access_info(later.access);
+                        stop = later_info.write || (resource.is_image && later_info.state.layout != dst.layout) ||
+                               (graph.passes[executed[j]].render_pass && is_attachment(later.access));
+                        if (!stop) {
+                            dst.stages |= later_info.state.stages;
+                            dst.access |= later_info.state.access;
+                        }
+                    }
+                    if (stop) break;
+                }
+                State src = {t.write.stages | (transition ? t.reads : 0), t.write.access};
+                add_barrier(graph, pass.before, use.resource, src, dst, t.layout);
+                t.visible |= dst.stages;
+                t.layout = info.state.layout;
+            }
+            t.reads |= info.state.stages;
+        }
+        if (!pass.before.empty()) ++graph.batch_count;
+    }
+
+    for (ResourceId id = 0; id < graph.resources.size(); ++id) {
+        const Resource &resource = graph.resources[id];
+        const Tracked &t = tracked[id];
+        if (!resource.imported || resource.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || t.layout == resource.final_layout) continue;
+        add_barrier(graph, graph.after, id, {t.write.stages | t.reads, t.write.access},
+            {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, resource.final_layout}, t.layout);
+    }
+    if (!graph.after.empty()) ++graph.batch_count;
+}
+
+void compile(Graph &graph) {
+    cull(graph);
+    std::vector<PassId> executed;
+    for (PassId pass = 0; pass < graph.passes.size(); ++pass) {
+        if (!graph.passes[pass].culled) executed.push_back(pass);
+    }
+    create_transients(graph, executed);
+    place_barriers(graph, executed);
+    graph.compiled = true;
+
+    DS_LOG_INFO(Render, "Render graph: {} passes ({} culled), {} barriers in {} batches ({}), {} KiB of transients ({} KiB unaliased)",
+        graph.passes.size(), graph.culled_passes, graph.barrier_count, graph.batch_count,
+        g_Synchronization2 ? "synchronization2" : "legacy barriers", graph.transient_bytes / 1024, graph.unaliased_bytes / 1024);
+    for (const Pass &pass : graph.passes) {
+        if (pass.culled) DS_LOG_INFO(Render, "Culled pass '{}', nothing uses its output", pass.name);
+    }
+}
+
+// Legacy stage masks can't be empty
+VkPipelineStageFlags legacy_stages(VkPipelineStageFlags2 stages, VkPipelineStageFlags none) {
+    return stages == VK_PIPELINE_STAGE_2_NONE ? none : static_cast<VkPipelineStageFlags>(stages);
+}
+
+void emit(const Graph &graph, const Batch &batch, VkCommandBuffer cmd) {
+    if (batch.empty()) return;
+    g_ImageBarriers.clear();
+    g_BufferBarriers.clear();
+    for (size_t i = 0; i < batch.images.size(); ++i) {
+        VkImage image = graph.resources[batch.image_ids[i]].image;
+        if (image == VK_NULL_HANDLE) continue;
+        g_ImageBarriers.push_back(batch.images[i]);
+        g_ImageBarriers.back().image = image;
+    }
+    for (size_t i = 0; i < batch.buffers.size(); ++i) {
+        VkBuffer buffer = graph.resources[batch.buffer_ids[i]].buffer;
+        if (buffer == VK_NULL_HANDLE) continue;
+        g_BufferBarriers.push_back(batch.buffers[i]);
+        g_BufferBarriers.back().buffer = buffer;
+    }
+    if (g_ImageBarriers.empty() && g_BufferBarriers.empty()) return;
+
+    if (g_Synchronization2) {
+        VkDependencyInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        info.bufferMemoryBarrierCount = static_cast<uint32_t>(g_BufferBarriers.size());
+        info.pBufferMemoryBarriers = g_BufferBarriers.data();
+        info.imageMemoryBarrierCount = static_cast<uint32_t>(g_ImageBarriers.size());
+        info.pImageMemoryBarriers = g_ImageBarriers.data();
+        vkCmdPipelineBarrier2(cmd, &info);
+        return;
+    }
+
+    // The stage and access bits the graph uses all exist in the legacy flags with the same values
+    VkPipelineStageFlags2 src_stages = VK_PIPELINE_STAGE_2_NONE;
+    VkPipelineStageFlags2 dst_stages = VK_PIPELINE_STAGE_2_NONE;
+    g_LegacyImageBarriers.clear();
+    g_LegacyBufferBarriers.clear();
+    for (const VkImageMemoryBarrier2 &b : g_ImageBarriers) {
+        src_stages |= b.srcStageMask;
+        dst_stages |= b.dstStageMask;
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = static_cast<VkAccessFlags>(b.srcAccessMask);
+        barrier.dstAccessMask = static_cast<VkAccessFlags>(b.dstAccessMask);
+        barrier.oldLayout = b.oldLayout;
+        barrier.newLayout = b.newLayout;
+        barrier.srcQueueFamilyIndex = b.srcQueueFamilyIndex;
+        barrier.dstQueueFamilyIndex = b.dstQueueFamilyIndex;
+        barrier.image = b.image;
+        barrier.subresourceRange = b.subresourceRange;
+        g_LegacyImageBarriers.push_back(barrier);
+    }
+    for (const VkBufferMemoryBarrier2 &b : g_BufferBarriers) {
+        src_stages |= b.srcStageMask;
+        dst_stages |= b.dstStageMask;
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = static_cast<VkAccessFlags>(b.srcAccessMask);
+        barrier.dstAccessMask = static_cast<VkAccessFlags>(b.dstAccessMask);
+        barrier.srcQueueFamilyIndex = b.srcQueueFamilyIndex;
+        barrier.dstQueueFamilyIndex = b.dstQueueFamilyIndex;
+        barrier.buffer = b.buffer;
+        barrier.offset = b.offset;
+        barrier.size = b.size;
+        g_LegacyBufferBarriers.push_back(barrier);
+    }
+    vkCmdPipelineBarrier(cmd, legacy_stages(src_stages, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT), legacy_stages(dst_stages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+        Constants::no_flags, 0, nullptr,
+        static_cast<uint32_t>(g_LegacyBufferBarriers.size()), g_LegacyBufferBarriers.data(),
+        static_cast<uint32_t>(g_LegacyImageBarriers.size()), g_LegacyImageBarriers.data());
+}
+
+// Records every surviving pass with its barriers, the imported resources have to be bound. Each
+// pass is wrapped in a debug label so validation messages and captures name the pass.
+void execute(const Graph &graph, VkCommandBuffer cmd) {
+    for (const Pass &pass : graph.passes) {
+        if (pass.culled) continue;
+        Validation::begin_label(cmd, pass.name.c_str());
+        emit(graph, pass.before, cmd);
+        pass.execute(cmd);
+        Validation::end_label(cmd);
+    }
+    emit(graph, graph.after, cmd);
+}
+
+// Transients are retired through the deletion queue, frames in flight may still use them
+void destroy(Graph &graph) {
+    std::vector<std::pair<VkImage, VkImageView>> images;
+    for (const Resource &resource : graph.resources) {
+        if (!resource.imported && resource.image != VK_NULL_HANDLE) images.push_back({resource.image, resource.view});
+    }
+    std::vector<Memory::Allocation> allocations;
+    for (const Slot &slot : graph.slots) allocations.push_back(slot.allocation);
+    if (!images.empty()) {
+        DeletionQueue::push([images, allocations] {
+            for (auto [image, view] : images) {
+                vkDestroyImageView(g_Device, view, g_Allocator);
+                vkDestroyImage(g_Device, image, g_Allocator);
+            }
+            for (const Memory::Allocation &allocation : allocations) Memory::free_allocation(allocation);
+        });
+    }
+    graph = {};
+}
+} // namespace DS::RenderGraph
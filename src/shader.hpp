@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "global.hpp"
+#include "log.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Shader {
+// SPIR-V produced from shaders/*.vert|frag|comp by glslc at build time, see CMakeLists.txt
+std::filesystem::path spirv_path(std::string_view name) {
+    return std::filesystem::path(Constants::shader_dir) / std::format("{}.spv", name);
+}
+
+std::vector<uint32_t> read_spirv(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        DS_LOG_ERROR(Shader, "Can't open '{}'", path.string());
+        return {};
+    }
+    std::streamsize size = file.tellg();
+    if (size <= 0 || size % sizeof(uint32_t) != 0) {
+        DS_LOG_ERROR(Shader, "'{}' is not a SPIR-V module ({} bytes)", path.string(), size);
+        return {};
+    }
+    std::vector<uint32_t> code(static_cast<size_t>(size) / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(code.data()), size);
+    return code;
+}
+
+// FNV-1a, `seed` chains several pieces into one key
+uint64_t hash(const void *data, size_t size, uint64_t seed = 0xcbf29ce484222325ull) {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        seed ^= bytes[i];
+        seed *= 0x100000001b3ull;
+    }
+    return seed;
+}
+
+VkShaderModule create_module(std::span<const uint32_t> code) {
+    VkShaderModuleCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    info.codeSize = code.size() * sizeof(uint32_t);
+    info.pCode = code.data();
+    VkShaderModule module;
+    Vulkan::check(vkCreateShaderModule(g_Device, &info, g_Allocator, &module));
+    return module;
+}
+
+// `name` is the source file name, e.g. "sprite.vert". Returns VK_NULL_HANDLE if the module is missing.
+VkShaderModule load(std::string_view name) {
+    std::vector<uint32_t> code = read_spirv(spirv_path(name));
+    if (code.empty()) return VK_NULL_HANDLE;
+    return create_module(code);
+}
+} // namespace DS::Shader
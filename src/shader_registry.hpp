@@ -0,0 +1,394 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <mutex>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include <vulkan/vulkan.h>
+
+#include "global.hpp"
+#include "log.hpp"
+#include "shader.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+extern char **environ;
+
+namespace DS::ShaderRegistry {
+// Owns the shader modules and every pipeline built from them. A renderer registers each pipeline with
+// the shaders it uses and a function that builds it, and reads it back through `target`.
+//
+// With hot reload on, a watcher thread reports edited sources and a worker thread compiles them with
+// glslc and rebuilds only the pipelines that use them, while the old ones keep rendering. update()
+// swaps the results in between frames. Compiled SPIR-V is cached on disk by the hash of its source, and
+// pipelines are kept by the hash of their SPIR-V, so undoing an edit swaps back without compiling
+// anything. Replaced pipelines live until cleanup, which also covers the frames still in flight.
+using Builder = std::function<VkPipeline(std::span<const VkShaderModule>)>;
+
+struct Module {
+    std::string name;  // Source file name, e.g. "mesh.frag"
+    uint64_t hash = 0; // Of the SPIR-V in use
+    VkShaderModule module = VK_NULL_HANDLE;
+    std::unordered_map<uint64_t, VkShaderModule> versions;
+};
+
+struct Program {
+    std::vector<uint32_t> modules; // Into g_Modules, in the order the builder expects them
+    Builder build;
+    VkPipeline *target = nullptr;
+    uint64_t key = 0; // Hash of the module hashes
+    std::unordered_map<uint64_t, VkPipeline> built;
+};
+
+// Filled by the worker, applied on the main thread
+struct Reload {
+    struct ModuleUpdate {
+        uint32_t module;
+        uint64_t hash;
+        VkShaderModule handle;
+        bool created;
+    };
+    struct ProgramUpdate {
+        uint32_t program;
+        uint64_t key;
+        VkPipeline pipeline;
+        bool created;
+    };
+    std::vector<ModuleUpdate> modules;
+    std::vector<ProgramUpdate> programs;
+    uint32_t failed = 0;
+    double milliseconds = 0.0;
+};
+
+constexpr uint32_t invalid_module = UINT32_MAX;
+
+// Only added to during setup. While the worker runs it reads both, update() writes them once it joined.
+std::vector<Module> g_Modules;
+std::vector<Program> g_Programs;
+
+bool g_HotReload = false;
+std::atomic<bool> g_Stop = false;
+std::thread g_Watcher;
+std::mutex g_ChangedMutex;
+std::vector<uint32_t> g_Changed; // Edited since the last reload, guarded by g_ChangedMutex
+std::chrono::steady_clock::time_point g_LastChange;
+
+std::thread g_Worker;
+std::atomic<bool> g_WorkerDone = false;
+Reload g_Reload;
+
+uint32_t g_Reloads = 0;
+uint32_t g_Failures = 0;
+double g_LastReloadMs = 0.0;
+
+std::filesystem::path source_path(std::string_view name) {
+    return std::filesystem::path(Constants::shader_dir) / name;
+}
+
+uint64_t program_key(std::span<const uint64_t> hashes) {
+    return Shader::hash(hashes.data(), hashes.size_bytes());
+}
+
+// Loads the SPIR-V built with the project the first time a shader is used
+uint32_t find_or_load(std::string_view name) {
+    for (uint32_t i = 0; i < g_Modules.size(); ++i) {
+        if (g_Modules[i].name == name) return i;
+    }
+    std::vector<uint32_t> code = Shader::read_spirv(Shader::spirv_path(name));
+    if (code.empty()) return invalid_module;
+    Module module;
+    module.name = name;
+    module.hash = Shader::hash(code.data(), code.size() * sizeof(uint32_t));
+    module.module = Shader::create_module(code);
+    module.versions[module.hash] = module.module;
+    g_Modules.push_back(std::move(module));
+    return static_cast<uint32_t>(g_Modules.size() - 1);
+}
+
+// Builds the pipeline into `target` and keeps it current, false if a shader is missing. Setup only.
+bool add(std::initializer_list<std::string_view> shaders, Builder build, VkPipeline *target) {
+    Program program;
+    std::vector<VkShaderModule> handles;
+    std::vector<uint64_t> hashes;
+    for (std::string_view name : shaders) {
+        uint32_t module = find_or_load(name);
+        if (module == invalid_module) return false;
+        program.modules.push_back(module);
+        handles.push_back(g_Modules[module].module);
+        hashes.push_back(g_Modules[module].hash);
+    }
+    *target = build(handles);
+    program.key = program_key(hashes);
+    program.built[program.key] = *target;
+    program.build = std::move(build);
+    program.target = target;
+    g_Programs.push_back(std::move(program));
+    return true;
+}
+
+// Runs glslc directly, no shell, its diagnostics go to our stderr
+bool run_compiler(const std::filesystem::path &source, const std::filesystem::path &output) {
+    std::string compiler = "glslc";
+    if (const char *sdk = std::getenv("VULKAN_SDK")) {
+        std::error_code ec;
+        std::filesystem::path path = std::filesystem::path(sdk) / "bin" / "glslc";
+        if (std::filesystem::exists(path, ec)) compiler = path.string();
+    }
+    std::string target_env = std::format("--target-env={}", Constants::shader_target_env);
+    std::string output_flag = "-o";
+    std::string output_path = output.string();
+    std::string source_path = source.string();
+    std::array<char *, 6> argv = {compiler.data(), target_env.data(), output_flag.data(), output_path.data(), source_path.data(), nullptr};
+    pid_t pid;
+    if (int err = posix_spawnp(&pid, compiler.c_str(), nullptr, nullptr, argv.data(), environ); err != 0) {
+        DS_LOG_ERROR(Shader, "Can't run '{}': {}", compiler, std::strerror(err));
+        return false;
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// SPIR-V for the current source text, compiled only if this exact text wasn't before. The shaders
+// don't #include anything, so the text, file name and target are the whole input.
+std::vector<uint32_t> compile(std::string_view name) {
+    std::ifstream file(source_path(name), std::ios::binary);
+    if (!file) {
+        DS_LOG_ERROR(Shader, "Can't open '{}'", source_path(name).string());
+        return {};
+    }
+    std::string text{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    uint64_t key = Shader::hash(Constants::shader_target_env, std::strlen(Constants::shader_target_env));
+    key = Shader::hash(name.data(), name.size(), key);
+    key = Shader::hash(text.data(), text.size(), key);
+
+    std::filesystem::path cached = std::filesystem::path(Constants::shader_cache_dir) / std::format("{:016x}.spv", key);
+    std::error_code ec;
+    if (!std::filesystem::exists(cached, ec)) {
+        std::filesystem::create_directories(Constants::shader_cache_dir, ec);
+        std::filesystem::path tmp = cached;
+        tmp += ".tmp";
+        bool compiled = run_compiler(source_path(name), tmp);
+        if (compiled) std::filesystem::rename(tmp, cached, ec);
+        if (!compiled || ec) {
+            std::filesystem::remove(tmp, ec);
+            return {};
+        }
+    }
+    return Shader::read_spirv(cached);
+}
+
+// Worker thread: compiles the changed shaders and builds the pipelines that use them
+void reload(std::vector<uint32_t> changed) {
+    auto start = std::chrono::steady_clock::now();
+    Reload result;
+    std::vector<uint64_t> hashes(g_Modules.size());
+    std::vector<VkShaderModule> handles(g_Modules.size());
+    for (uint32_t i = 0; i < g_Modules.size(); ++i) {
+        hashes[i] = g_Modules[i].hash;
+        handles[i] = g_Modules[i].module;
+    }
+
+    for (uint32_t index : changed) {
+        const Module &module = g_Modules[index];
+        std::vector<uint32_t> code = compile(module.name);
+        if (code.empty()) {
+            DS_LOG_ERROR(Shader, "'{}' failed to compile, keeping the previous version", module.name);
+            ++result.failed;
+            continue;
+        }
+        uint64_t hash = Shader::hash(code.data(), code.size() * sizeof(uint32_t));
+        if (hash == module.hash) continue; // Saved without a change that reaches the SPIR-V
+        auto it = module.versions.find(hash);
+        bool created = it == module.versions.end();
+        VkShaderModule handle = created ? Shader::create_module(code) : it->second;
+        result.modules.push_back({index, hash, handle, created});
+        hashes[index] = hash;
+        handles[index] = handle;
+    }
+
+    std::vector<uint64_t> program_hashes;
+    std::vector<VkShaderModule> program_handles;
+    for (uint32_t index = 0; index < g_Programs.size(); ++index) {
+        const Program &program = g_Programs[index];
+        program_hashes.clear();
+        program_handles.clear();
+        for (uint32_t module : program.modules) {
+            program_hashes.push_back(hashes[module]);
+            program_handles.push_back(handles[module]);
+        }
+        uint64_t key = program_key(program_hashes);
+        if (key == program.key) continue; // None of its shaders changed
+        auto it = program.built.find(key);
+        bool created = it == program.built.end();
+        VkPipeline pipeline = created ? program.build(program_handles) : it->second;
+        result.programs.push_back({index, key, pipeline, created});
+    }
+
+    result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    g_Reload = std::move(result);
+    g_WorkerDone.store(true, std::memory_order_release);
+}
+
+void apply(const Reload &result) {
+    for (const Reload::ModuleUpdate &update : result.modules) {
+        Module &module = g_Modules[update.module];
+        if (update.created) module.versions[update.hash] = update.handle;
+        module.hash = update.hash;
+        module.module = update.handle;
+    }
+    uint32_t built = 0;
+    for (const Reload::ProgramUpdate &update : result.programs) {
+        Program &program = g_Programs[update.program];
+        if (update.created) {
+            program.built[update.key] = update.pipeline;
+            ++built;
+        }
+        program.key = update.key;
+        *program.target = update.pipeline;
+    }
+    g_Failures += result.failed;
+    if (result.programs.empty()) return;
+    ++g_Reloads;
+    g_LastReloadMs = result.milliseconds;
+    DS_LOG_INFO(Shader, "Swapped {} pipelines ({} built, {} from earlier versions) after {:.3f} ms",
+        result.programs.size(), built, result.programs.size() - built, result.milliseconds);
+}
+
+// Call once per frame outside of recording. Returns true if pipelines were swapped.
+bool update() {
+    if (!g_HotReload) return false;
+    bool swapped = false;
+    if (g_Worker.joinable()) {
+        if (!g_WorkerDone.load(std::memory_order_acquire)) return false;
+        g_Worker.join();
+        swapped = !g_Reload.programs.empty();
+        apply(g_Reload);
+        g_Reload = {};
+    }
+
+    std::vector<uint32_t> changed;
+    {
+        std::lock_guard lock(g_ChangedMutex);
+        // Editors write a file in several steps, wait until it has been quiet for a moment
+        if (g_Changed.empty() || std::chrono::steady_clock::now() - g_LastChange < std::chrono::milliseconds(Constants::shader_reload_debounce_ms)) {
+            return swapped;
+        }
+        changed.swap(g_Changed);
+    }
+    g_WorkerDone.store(false, std::memory_order_relaxed);
+    g_Worker = std::thread(reload, std::move(changed));
+    return swapped;
+}
+
+void mark_changed(std::string_view file) {
+    for (uint32_t i = 0; i < g_Modules.size(); ++i) {
+        if (g_Modules[i].name != file) continue;
+        std::lock_guard lock(g_ChangedMutex);
+        if (std::find(g_Changed.begin(), g_Changed.end(), i) == g_Changed.end()) g_Changed.push_back(i);
+        g_LastChange = std::chrono::steady_clock::now();
+    }
+}
+
+#ifdef __linux__
+// Watches the directory rather than the files, editors often save by renaming a new file over the old one
+void watch() {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, Constants::shader_dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        DS_LOG_ERROR(Shader, "Can't watch '{}': {}", Constants::shader_dir, std::strerror(errno));
+        if (fd >= 0) close(fd);
+        return;
+    }
+    alignas(inotify_event) char buffer[4096];
+    while (!g_Stop.load(std::memory_order_relaxed)) {
+        pollfd descriptor = {fd, POLLIN, 0};
+        if (poll(&descriptor, 1, Constants::shader_watch_interval_ms) <= 0) continue;
+        ssize_t size = read(fd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < size;) {
+            const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+            if (event->len > 0) mark_changed(event->name);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+    }
+    close(fd);
+}
+#else
+// No inotify, compare modification times instead
+void watch() {
+    std::vector<std::filesystem::file_time_type> times(g_Modules.size());
+    std::error_code ec;
+    for (uint32_t i = 0; i < g_Modules.size(); ++i) times[i] = std::filesystem::last_write_time(source_path(g_Modules[i].name), ec);
+    while (!g_Stop.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(Constants::shader_watch_interval_ms));
+        for (uint32_t i = 0; i < g_Modules.size(); ++i) {
+            auto time = std::filesystem::last_write_time(source_path(g_Modules[i].name), ec);
+            if (ec || time == times[i]) continue;
+            times[i] = time;
+            mark_changed(g_Modules[i].name);
+        }
+    }
+}
+#endif
+
+// Call after the renderers' setup, only the shaders registered by then are watched
+void start_hot_reload() {
+    if (!g_HotReload || g_Modules.empty()) return;
+    std::error_code ec;
+    if (!std::filesystem::exists(source_path(g_Modules.front().name), ec)) {
+        DS_LOG_WARNING(Shader, "No shader sources in '{}', hot reload disabled", Constants::shader_dir);
+        g_HotReload = false;
+        return;
+    }
+    g_Watcher = std::thread(watch);
+    DS_LOG_INFO(Shader, "Watching {} shaders used by {} pipelines in '{}'", g_Modules.size(), g_Programs.size(), Constants::shader_dir);
+}
+
+// Only valid once the device is idle, after the renderers' cleanup
+void cleanup() {
+    g_Stop.store(true, std::memory_order_relaxed);
+    if (g_Watcher.joinable()) g_Watcher.join();
+    if (g_Worker.joinable()) {
+        g_Worker.join();
+        apply(g_Reload); // Hands its objects over so they get destroyed below
+        g_Reload = {};
+    }
+    for (Program &program : g_Programs) {
+        for (auto &[key, pipeline] : program.built) vkDestroyPipeline(g_Device, pipeline, g_Allocator);
+        *program.target = VK_NULL_HANDLE;
+    }
+    for (Module &module : g_Modules) {
+        for (auto &[hash, handle] : module.versions) vkDestroyShaderModule(g_Device, handle, g_Allocator);
+    }
+    g_Programs.clear();
+    g_Modules.clear();
+}
+} // namespace DS::ShaderRegistry
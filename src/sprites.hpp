@@ -0,0 +1,440 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <print>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <imgui.h>
+#include <imgui_impl_vulkan.h>
+
+#include <vulkan/vulkan.h>
+
+#include "bindless.hpp"
+#include "depth.hpp"
+#include "global.hpp"
+#include "jobs.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+#include "profiler.hpp"
+#include "shader_registry.hpp"
+#include "transfer.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Sprites {
+// Instanced 2D quads. Sprites submitted with draw() are sorted by layer, blend mode and texture, their
+// instance data is written into the frame slot's persistently mapped buffer, and every run of equal
+// keys becomes one instanced draw of a 4 vertex strip. The draws are recorded as the frame's second
+// secondary, after the meshes and before the dear imgui overlay, all in the same render pass.
+// Textures come from the bindless tables, without descriptor indexing the renderer is disabled.
+enum class Blend : uint8_t {
+    Alpha,
+    Additive,
+};
+constexpr uint32_t blend_count = 2;
+
+struct Sprite {
+    glm::vec2 position = {0.0f, 0.0f}; // Center, in pixels from the top left
+    glm::vec2 size = {1.0f, 1.0f};     // In pixels
+    float rotation = 0.0f;             // Radians, around the center
+    glm::vec4 uv_rect = {0.0f, 0.0f, 1.0f, 1.0f};
+    uint32_t color = 0xFFFFFFFF;    // RGBA8, packed like IM_COL32
+    Bindless::ImageHandle texture;  // Invalid draws untextured
+    Blend blend = Blend::Alpha;
+    uint8_t layer = 0; // Lower layers draw first, order within a batch is submission order
+};
+
+// Matches the vertex inputs of shaders/sprite.vert
+struct Instance {
+    glm::vec2 position;
+    glm::vec2 size;
+    glm::vec4 uv_rect;
+    uint32_t color;
+    float rotation;
+};
+static_assert(sizeof(Instance) == 40);
+
+struct PushConstants {
+    glm::vec2 pixel_to_ndc;
+    uint32_t texture;
+    uint32_t sampler;
+};
+static_assert(sizeof(PushConstants) <= Constants::bindless_push_constant_size);
+
+struct Batch {
+    Blend blend;
+    uint32_t texture;
+    uint32_t first;
+    uint32_t count;
+};
+
+struct FrameBuffer {
+    Memory::Buffer *buffer = nullptr;
+    uint32_t capacity = 0;
+};
+
+// Sort key layout, above the 32 bit submission index
+constexpr uint32_t key_texture_bits = 22;
+constexpr uint32_t key_blend_shift = key_texture_bits;
+constexpr uint32_t key_layer_shift = key_texture_bits + 2;
+constexpr uint32_t key_texture_mask = (1u << key_texture_bits) - 1;
+
+bool g_Enabled = false;
+std::array<VkPipeline, blend_count> g_Pipelines = {};
+std::vector<FrameBuffer> g_Buffers; // One per frame in flight
+Memory::Image *g_WhiteImage = nullptr;
+VkImageView g_WhiteView = VK_NULL_HANDLE;
+VkSampler g_Sampler = VK_NULL_HANDLE;
+Bindless::ImageHandle g_White;
+Bindless::SamplerHandle g_SamplerHandle;
+
+std::vector<Instance> g_Instances; // In submission order
+std::vector<uint64_t> g_Keys;      // (sort key << 32) | submission index
+std::vector<uint64_t> g_SortScratch;
+std::vector<Batch> g_Batches;
+VkBuffer g_PreparedBuffer = VK_NULL_HANDLE;
+
+uint32_t g_LastCount = 0; // Sprites drawn by the last prepared frame
+uint32_t g_DemoCount = 0;
+bool g_Benchmark = false;
+
+VkPipeline create_pipeline(const ImGui_ImplVulkanH_Window *wd, Blend blend, VkShaderModule vert, VkShaderModule frag) {
+    std::array<VkPipelineShaderStageCreateInfo, 2> stages = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag;
+    stages[1].pName = "main";
+
+    VkVertexInputBindingDescription binding = {0, sizeof(Instance), VK_VERTEX_INPUT_RATE_INSTANCE};
+    const std::array<VkVertexInputAttributeDescription, 5> attributes = {{
+        {0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Instance, position)},
+        {1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Instance, size)},
+        {2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Instance, uv_rect)},
+        {3, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(Instance, color)},
+        {4, 0, VK_FORMAT_R32_SFLOAT, offsetof(Instance, rotation)},
+    }};
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = 1;
+    vertex_input.pVertexBindingDescriptions = &binding;
+    vertex_input.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+    vertex_input.pVertexAttributeDescriptions = attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_NONE;
+    rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Drawn over the meshes, without testing against or writing their depth
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+
+    VkPipelineColorBlendAttachmentState attachment = {};
+    attachment.blendEnable = VK_TRUE;
+    attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    attachment.dstColorBlendFactor = blend == Blend::Additive ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo color_blend = {};
+    color_blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend.attachmentCount = 1;
+    color_blend.pAttachments = &attachment;
+
+    const std::array<VkDynamicState, 2> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic.pDynamicStates = dynamic_states.data();
+
+    VkPipelineRenderingCreateInfo rendering = {};
+    rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering.colorAttachmentCount = 1;
+    rendering.pColorAttachmentFormats = &wd->SurfaceFormat.format;
+    rendering.depthAttachmentFormat = Depth::g_Format;
+
+    VkGraphicsPipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.pNext = g_DynamicRendering ? &rendering : nullptr;
+    info.stageCount = static_cast<uint32_t>(stages.size());
+    info.pStages = stages.data();
+    info.pVertexInputState = &vertex_input;
+    info.pInputAssemblyState = &input_assembly;
+    info.pViewportState = &viewport;
+    info.pRasterizationState = &rasterization;
+    info.pMultisampleState = &multisample;
+    info.pDepthStencilState = &depth_stencil;
+    info.pColorBlendState = &color_blend;
+    info.pDynamicState = &dynamic;
+    info.layout = Bindless::g_PipelineLayout;
+    info.renderPass = g_DynamicRendering ? VK_NULL_HANDLE : wd->RenderPass;
+    info.subpass = 0;
+    VkPipeline pipeline;
+    Vulkan::check(vkCreateGraphicsPipelines(g_Device, g_PipelineCache, 1, &info, g_Allocator, &pipeline));
+    return pipeline;
+}
+
+// 1x1 white texture and a linear clamp sampler, used for untextured sprites
+void create_defaults() {
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    image_info.extent = {1, 1, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    g_WhiteImage = Memory::create_image(image_info, Memory::Usage::GpuOnly);
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = g_WhiteImage->image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = image_info.format;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    Vulkan::check(vkCreateImageView(g_Device, &view_info, g_Allocator, &g_WhiteView));
+    const uint32_t white = 0xFFFFFFFF;
+    if (!Transfer::upload_image(g_WhiteImage->image, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, {1, 1, 1},
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &white, sizeof(white))) {
+        DS_LOG_ERROR(Render, "Staging ring full, can't upload the default sprite texture");
+    }
+    g_White = Bindless::register_image(g_WhiteView);
+
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    Vulkan::check(vkCreateSampler(g_Device, &sampler_info, g_Allocator, &g_Sampler));
+    g_SamplerHandle = Bindless::register_sampler(g_Sampler);
+}
+
+// Call once the render target exists (render pass or surface format), after Bindless::setup
+void setup(const ImGui_ImplVulkanH_Window *wd) {
+    if (!Bindless::g_Enabled) {
+        DS_LOG_WARNING(Render, "Sprites need bindless descriptors, sprite renderer disabled");
+        return;
+    }
+    bool loaded = true;
+    for (uint32_t i = 0; i < blend_count && loaded; ++i) {
+        loaded = ShaderRegistry::add({"sprite.vert", "sprite.frag"}, [wd, i](std::span<const VkShaderModule> modules) {
+            return create_pipeline(wd, static_cast<Blend>(i), modules[0], modules[1]);
+        }, &g_Pipelines[i]);
+    }
+    if (loaded) {
+        create_defaults();
+        g_Buffers.resize(g_FramesInFlight);
+        g_Enabled = true;
+    } else {
+        DS_LOG_WARNING(Render, "Sprite shaders missing, sprite renderer disabled");
+    }
+}
+
+// Only valid once the device is idle, before DeletionQueue::flush and Bindless::cleanup
+void cleanup() {
+    if (!g_Enabled) return;
+    g_Pipelines = {}; // Owned by the shader registry
+    for (FrameBuffer &frame : g_Buffers) Memory::destroy_buffer(frame.buffer);
+    g_Buffers.clear();
+    Bindless::release(g_White);
+    Bindless::release(g_SamplerHandle);
+    vkDestroySampler(g_Device, g_Sampler, g_Allocator);
+    vkDestroyImageView(g_Device, g_WhiteView, g_Allocator);
+    Memory::destroy_image(g_WhiteImage);
+    g_WhiteImage = nullptr;
+    g_Enabled = false;
+}
+
+// Drops whatever was submitted but not drawn, call at the top of the main loop
+void begin_frame() {
+    g_Instances.clear();
+    g_Keys.clear();
+}
+
+void draw(const Sprite &sprite) {
+    uint32_t texture = sprite.texture.valid() ? sprite.texture.index : g_White.index;
+    uint32_t key = (static_cast<uint32_t>(sprite.layer) << key_layer_shift) |
+                   (static_cast<uint32_t>(sprite.blend) << key_blend_shift) |
+                   (texture & key_texture_mask);
+    g_Keys.push_back((static_cast<uint64_t>(key) << 32) | g_Instances.size());
+    g_Instances.push_back({sprite.position, sprite.size, sprite.uv_rect, sprite.color, sprite.rotation});
+}
+
+// Stable LSD radix sort on the upper 32 bits. Input is in submission order, so equal keys keep it.
+// A byte that is the same for every key (the common case, few layers and textures) costs only
+// its histogram pass.
+void sort_keys() {
+    const size_t count = g_Keys.size();
+    g_SortScratch.resize(count);
+    for (uint32_t shift = 32; shift < 64; shift += 8) {
+        std::array<size_t, 256> offsets = {};
+        for (uint64_t key : g_Keys) ++offsets[(key >> shift) & 0xFF];
+        if (std::find(offsets.begin(), offsets.end(), count) != offsets.end()) continue;
+        size_t sum = 0;
+        for (size_t &offset : offsets) {
+            size_t bucket = offset;
+            offset = sum;
+            sum += bucket;
+        }
+        for (uint64_t key : g_Keys) g_SortScratch[offsets[(key >> shift) & 0xFF]++] = key;
+        g_Keys.swap(g_SortScratch);
+    }
+}
+
+// Sorts the frame's sprites and writes them into `slot`'s instance buffer. Call once the slot's
+// fence has signalled, the buffer is overwritten in place.
+void prepare(uint32_t slot) {
+    DS_PROFILE_SCOPE("Sprites::prepare");
+    g_Batches.clear();
+    g_PreparedBuffer = VK_NULL_HANDLE;
+    g_LastCount = static_cast<uint32_t>(g_Instances.size());
+    if (!g_Enabled || g_Instances.empty()) return;
+
+    FrameBuffer &frame = g_Buffers[slot];
+    const uint32_t count = static_cast<uint32_t>(g_Instances.size());
+    if (count > frame.capacity) {
+        Memory::destroy_buffer_deferred(frame.buffer);
+        frame.capacity = std::max(Constants::sprite_initial_capacity, std::bit_ceil(count));
+        frame.buffer = Memory::create_buffer(frame.capacity * sizeof(Instance), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, Memory::Usage::Upload);
+    }
+
+    sort_keys();
+    auto *dst = static_cast<Instance *>(frame.buffer->allocation.mapped);
+    Jobs::parallel_for(count, Constants::sprite_write_batch, [dst](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) dst[i] = g_Instances[static_cast<uint32_t>(g_Keys[i])];
+    });
+
+    uint32_t first = 0;
+    for (uint32_t i = 1; i <= count; ++i) {
+        if (i < count && (g_Keys[i] >> 32) == (g_Keys[first] >> 32)) continue;
+        uint32_t key = static_cast<uint32_t>(g_Keys[first] >> 32);
+        g_Batches.push_back({static_cast<Blend>((key >> key_blend_shift) & 0x3), key & key_texture_mask, first, i - first});
+        first = i;
+    }
+    g_PreparedBuffer = frame.buffer->buffer;
+}
+
+// Recording task, one instanced draw per batch
+void record(VkCommandBuffer cmd, const ImGui_ImplVulkanH_Window *wd) {
+    if (g_Batches.empty()) return;
+    VkViewport viewport = {0.0f, 0.0f, static_cast<float>(wd->Width), static_cast<float>(wd->Height), 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, {static_cast<uint32_t>(wd->Width), static_cast<uint32_t>(wd->Height)}};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    Bindless::bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, &g_PreparedBuffer, &offset);
+
+    PushConstants constants = {
+        .pixel_to_ndc = {2.0f / static_cast<float>(wd->Width), 2.0f / static_cast<float>(wd->Height)},
+        .texture = 0,
+        .sampler = g_SamplerHandle.index};
+    uint32_t bound = blend_count;
+    for (const Batch &batch : g_Batches) {
+        uint32_t blend = Util::enum_to_number(batch.blend);
+        if (blend != bound) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_Pipelines[blend]);
+            bound = blend;
+        }
+        constants.texture = batch.texture;
+        vkCmdPushConstants(cmd, Bindless::g_PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+        vkCmdDraw(cmd, 4, batch.count, 0, batch.first);
+    }
+}
+
+// --sprites <n>: a field of spinning quads over two layers and both blend modes
+void demo(const ImGui_ImplVulkanH_Window *wd, float time) {
+    const uint32_t columns = std::max(1u, static_cast<uint32_t>(std::sqrt(static_cast<float>(g_DemoCount) * wd->Width / std::max(1, wd->Height))));
+    const float spacing = static_cast<float>(wd->Width) / static_cast<float>(columns);
+    for (uint32_t i = 0; i < g_DemoCount; ++i) {
+        float x = (static_cast<float>(i % columns) + 0.5f) * spacing;
+        float y = (static_cast<float>(i / columns) + 0.5f) * spacing;
+        uint8_t shade = static_cast<uint8_t>(i * 37);
+        draw({.position = {x, y},
+            .size = {spacing * 0.8f, spacing * 0.8f},
+            .rotation = time + static_cast<float>(i) * 0.01f,
+            .color = IM_COL32(shade, 255 - shade, 160, 200),
+            .blend = i % 4 == 0 ? Blend::Additive : Blend::Alpha,
+            .layer = static_cast<uint8_t>(i % 2)});
+    }
+}
+
+// --bench-sprites: CPU cost of submitting, sorting and writing a frame's sprites. The GPU side
+// shows up in the frame rate of a headless run with --sprites.
+void benchmark() {
+    using Clock = std::chrono::steady_clock;
+    if (!g_Enabled) {
+        DS_LOG_WARNING(Render, "Sprite renderer disabled, skipping sprite benchmark");
+        return;
+    }
+    Vulkan::check(vkDeviceWaitIdle(g_Device));
+    DS_LOG_INFO(Render, "Sprite benchmark, {} sprites over 8 layers x {} blend modes, best of {} runs",
+        Constants::bench_sprite_count, blend_count, Constants::bench_sprite_runs);
+    double best_submit_ms = std::numeric_limits<double>::max();
+    double best_prepare_ms = std::numeric_limits<double>::max();
+    for (uint32_t run = 0; run < Constants::bench_sprite_runs; ++run) {
+        Jobs::begin_frame();
+        begin_frame();
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < Constants::bench_sprite_count; ++i) {
+            uint32_t hash = i * 2654435761u;
+            draw({.position = {static_cast<float>(hash % 1280), static_cast<float>((hash >> 11) % 720)},
+                .size = {8.0f, 8.0f},
+                .rotation = static_cast<float>(i),
+                .blend = static_cast<Blend>((hash >> 7) % blend_count),
+                .layer = static_cast<uint8_t>((hash >> 3) % 8)});
+        }
+        auto submitted = Clock::now();
+        prepare(0);
+        auto prepared = Clock::now();
+        best_submit_ms = std::min(best_submit_ms, std::chrono::duration<double, std::milli>(submitted - start).count());
+        best_prepare_ms = std::min(best_prepare_ms, std::chrono::duration<double, std::milli>(prepared - submitted).count());
+    }
+    DS_LOG_INFO(Render, "\tsubmit  {:8.3f} ms {:10.1f} sprites/ms", best_submit_ms, Constants::bench_sprite_count / best_submit_ms);
+    DS_LOG_INFO(Render, "\tprepare {:8.3f} ms {:10.1f} sprites/ms, {} draws", best_prepare_ms,
+        Constants::bench_sprite_count / best_prepare_ms, g_Batches.size());
+    begin_frame();
+    g_Batches.clear();
+}
+} // namespace DS::Sprites
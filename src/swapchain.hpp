@@ -0,0 +1,206 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <print>
+#include <vector>
+
+#include <imgui.h>
+#include <imgui_impl_vulkan.h>
+
+#include <vulkan/vulkan.h>
+
+#include "deletion_queue.hpp"
+#include "depth.hpp"
+#include "global.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Swapchain {
+// Engine-owned replacement for ImGui_ImplVulkanH_CreateOrResizeWindow. A rebuild passes the current
+// swapchain as oldSwapchain and hands the old swapchain, its views, framebuffers and semaphores to
+// the deletion queue, so frames still in flight on it finish undisturbed and nothing waits for the
+// device to go idle. The depth buffer is recreated at the new size the same way. The render pass only
+// depends on the formats and is kept across rebuilds.
+//
+// Only the fields FrameRender and FramePresent use are filled in: Swapchain, Width/Height,
+// ImageCount, RenderPass, Frames[i].Backbuffer/BackbufferView/Framebuffer and
+// FrameSemaphores[i].RenderCompleteSemaphore. Command buffers and fences live in g_Frames.
+// Color plus the shared depth buffer (see DS::Depth). Also used for the headless target, which
+// finishes in TRANSFER_SRC instead of PRESENT_SRC.
+VkRenderPass create_render_pass(VkFormat color_format, VkImageLayout final_layout) {
+    std::array<VkAttachmentDescription, 2> attachments = {};
+    attachments[0].format = color_format;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = final_layout;
+    attachments[1].format = Depth::g_Format;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    VkAttachmentReference color_attachment = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depth_attachment = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_attachment;
+    subpass.pDepthStencilAttachment = &depth_attachment;
+    // The depth buffer is shared between frames, its clear waits for the previous frame's tests
+    VkSubpassDependency dependency = {};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    VkRenderPassCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    info.attachmentCount = static_cast<uint32_t>(attachments.size());
+    info.pAttachments = attachments.data();
+    info.subpassCount = 1;
+    info.pSubpasses = &subpass;
+    info.dependencyCount = 1;
+    info.pDependencies = &dependency;
+    VkRenderPass render_pass;
+    Vulkan::check(vkCreateRenderPass(g_Device, &info, g_Allocator, &render_pass));
+    return render_pass;
+}
+
+// Hands the per-image objects of the current swapchain to the deletion queue
+void retire_images(ImGui_ImplVulkanH_Window *wd) {
+    std::vector<VkImageView> views;
+    std::vector<VkFramebuffer> framebuffers;
+    std::vector<VkSemaphore> semaphores;
+    for (uint32_t i = 0; i < wd->ImageCount; ++i) {
+        views.push_back(wd->Frames[i].BackbufferView);
+        framebuffers.push_back(wd->Frames[i].Framebuffer);
+    }
+    for (uint32_t i = 0; i < wd->SemaphoreCount; ++i) {
+        semaphores.push_back(wd->FrameSemaphores[i].RenderCompleteSemaphore);
+    }
+    DeletionQueue::push([views, framebuffers, semaphores] {
+        for (VkFramebuffer framebuffer : framebuffers) vkDestroyFramebuffer(g_Device, framebuffer, g_Allocator);
+        for (VkImageView view : views) vkDestroyImageView(g_Device, view, g_Allocator);
+        for (VkSemaphore semaphore : semaphores) vkDestroySemaphore(g_Device, semaphore, g_Allocator);
+    });
+}
+
+// Creates the swapchain, or rebuilds it at the new size / present mode without stalling
+void create_or_resize(ImGui_ImplVulkanH_Window *wd, int width, int height) {
+    VkSurfaceCapabilitiesKHR capabilities;
+    Vulkan::check(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(g_PhysicalDevice, wd->Surface, &capabilities));
+
+    uint32_t min_image_count = std::max(g_MinImageCount, capabilities.minImageCount);
+    if (capabilities.maxImageCount != 0) min_image_count = std::min(min_image_count, capabilities.maxImageCount);
+    VkExtent2D extent = capabilities.currentExtent;
+    if (extent.width == std::numeric_limits<uint32_t>::max()) {
+        extent.width = std::clamp(static_cast<uint32_t>(width), capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+        extent.height = std::clamp(static_cast<uint32_t>(height), capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+    }
+
+    VkSwapchainKHR old_swapchain = wd->Swapchain;
+    VkSwapchainCreateInfoKHR info = {};
+    info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    info.surface = wd->Surface;
+    info.minImageCount = min_image_count;
+    info.imageFormat = wd->SurfaceFormat.format;
+    info.imageColorSpace = wd->SurfaceFormat.colorSpace;
+    info.imageExtent = extent;
+    info.imageArrayLayers = 1;
+    info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.preTransform = (capabilities.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
+                            ? VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR
+                            : capabilities.currentTransform;
+    info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    info.presentMode = wd->PresentMode;
+    info.clipped = VK_TRUE;
+    info.oldSwapchain = old_swapchain;
+    Vulkan::check(vkCreateSwapchainKHR(g_Device, &info, g_Allocator, &wd->Swapchain));
+
+    if (old_swapchain != VK_NULL_HANDLE) {
+        // The old swapchain is retired by the create call, frames already submitted to it may still
+        // present. Its images go away with it once those frames have retired.
+        retire_images(wd);
+        DeletionQueue::push([old_swapchain] { vkDestroySwapchainKHR(g_Device, old_swapchain, g_Allocator); });
+    }
+
+    wd->Width = static_cast<int>(extent.width);
+    wd->Height = static_cast<int>(extent.height);
+    Vulkan::check(vkGetSwapchainImagesKHR(g_Device, wd->Swapchain, &wd->ImageCount, nullptr));
+    std::vector<VkImage> images(wd->ImageCount);
+    Vulkan::check(vkGetSwapchainImagesKHR(g_Device, wd->Swapchain, &wd->ImageCount, images.data()));
+
+    Depth::create(extent.width, extent.height);
+    if (!g_DynamicRendering && wd->RenderPass == VK_NULL_HANDLE) {
+        wd->RenderPass = create_render_pass(wd->SurfaceFormat.format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
+
+    // Render-complete semaphores are per image, an image is never in flight twice
+    wd->SemaphoreCount = wd->ImageCount;
+    wd->Frames.resize(static_cast<int>(wd->ImageCount));
+    wd->FrameSemaphores.resize(static_cast<int>(wd->SemaphoreCount));
+    for (uint32_t i = 0; i < wd->ImageCount; ++i) {
+        ImGui_ImplVulkanH_Frame *fd = &wd->Frames[i];
+        *fd = ImGui_ImplVulkanH_Frame();
+        fd->Backbuffer = images[i];
+        {
+            VkImageViewCreateInfo view_info = {};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = fd->Backbuffer;
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = wd->SurfaceFormat.format;
+            view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            Vulkan::check(vkCreateImageView(g_Device, &view_info, g_Allocator, &fd->BackbufferView));
+        }
+        if (!g_DynamicRendering) {
+            VkFramebufferCreateInfo framebuffer_info = {};
+            framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            const std::array<VkImageView, 2> attachments = {fd->BackbufferView, Depth::g_View};
+            framebuffer_info.renderPass = wd->RenderPass;
+            framebuffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebuffer_info.pAttachments = attachments.data();
+            framebuffer_info.width = extent.width;
+            framebuffer_info.height = extent.height;
+            framebuffer_info.layers = 1;
+            Vulkan::check(vkCreateFramebuffer(g_Device, &framebuffer_info, g_Allocator, &fd->Framebuffer));
+        }
+
+        ImGui_ImplVulkanH_FrameSemaphores *fsd = &wd->FrameSemaphores[i];
+        *fsd = ImGui_ImplVulkanH_FrameSemaphores();
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        Vulkan::check(vkCreateSemaphore(g_Device, &semaphore_info, g_Allocator, &fsd->RenderCompleteSemaphore));
+    }
+    wd->FrameIndex = 0;
+    wd->SemaphoreIndex = 0;
+}
+
+// Only valid once the device is idle and the deletion queue has been flushed
+void destroy(ImGui_ImplVulkanH_Window *wd) {
+    for (uint32_t i = 0; i < wd->ImageCount; ++i) {
+        vkDestroyFramebuffer(g_Device, wd->Frames[i].Framebuffer, g_Allocator);
+        vkDestroyImageView(g_Device, wd->Frames[i].BackbufferView, g_Allocator);
+    }
+    for (uint32_t i = 0; i < wd->SemaphoreCount; ++i) {
+        vkDestroySemaphore(g_Device, wd->FrameSemaphores[i].RenderCompleteSemaphore, g_Allocator);
+    }
+    vkDestroyRenderPass(g_Device, wd->RenderPass, g_Allocator);
+    vkDestroySwapchainKHR(g_Device, wd->Swapchain, g_Allocator);
+    vkDestroySurfaceKHR(g_Instance, wd->Surface, g_Allocator);
+    *wd = ImGui_ImplVulkanH_Window();
+}
+} // namespace DS::Swapchain
@@ -0,0 +1,313 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <print>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "deletion_queue.hpp"
+#include "global.hpp"
+#include "memory.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Transfer {
+// Asynchronous uploads: data is copied into a persistently mapped staging ring, the copies are
+// batched into one command buffer per flush() and submitted on g_TransferQueue. Each batch releases
+// its resources to the graphics family and signals a semaphore that the next graphics submit waits
+// on; the matching acquire barriers are recorded at the start of that frame's command buffer.
+// When there is no dedicated transfer family everything runs on g_Queue without ownership transfers.
+// Batches flushed while no graphics submit picked up the previous one (dropped frames) wait on its
+// semaphore themselves, so graphics only ever waits on the newest batch: a semaphore signal covers
+// everything submitted before it on the same queue.
+struct Batch {
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    uint64_t ring_end = 0;      // Ring position to release once the fence signals
+    bool semaphore_busy = false; // Waited on by a submit that may not have executed yet
+    Batch *chained = nullptr;    // Previous batch whose semaphore this one's submit waits on
+};
+
+struct PendingAcquire {
+    std::vector<VkBufferMemoryBarrier> buffers;
+    std::vector<VkImageMemoryBarrier> images;
+};
+
+Memory::Buffer *g_Ring = nullptr;
+uint8_t *g_RingData = nullptr;
+VkDeviceSize g_RingSize = 0;
+uint64_t g_RingHead = 0; // Monotonic write position, offset into the ring is head % size
+uint64_t g_RingTail = 0; // Everything before tail has been consumed by the GPU
+
+std::vector<Batch *> g_FreeBatches;
+std::deque<Batch *> g_InFlight;
+Batch *g_Recording = nullptr;
+PendingAcquire g_Recorded;            // Acquire barriers for g_Recording
+PendingAcquire g_AcquiresForGraphics; // Acquire barriers for the next graphics command buffer
+Batch *g_WaitForGraphics = nullptr; // Newest flushed batch no graphics submit has waited on yet
+
+uint64_t g_BytesUploaded = 0;
+uint32_t g_BatchesSubmitted = 0;
+
+bool needs_ownership_transfer() {
+    return g_TransferQueueFamily != g_QueueFamily;
+}
+
+Batch *create_batch() {
+    auto *batch = new Batch();
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = g_TransferQueueFamily;
+    Vulkan::check(vkCreateCommandPool(g_Device, &pool_info, g_Allocator, &batch->command_pool));
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = batch->command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    Vulkan::check(vkAllocateCommandBuffers(g_Device, &alloc_info, &batch->command_buffer));
+    VkFenceCreateInfo fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    Vulkan::check(vkCreateFence(g_Device, &fence_info, g_Allocator, &batch->fence));
+    VkSemaphoreCreateInfo semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    Vulkan::check(vkCreateSemaphore(g_Device, &semaphore_info, g_Allocator, &batch->semaphore));
+    return batch;
+}
+
+void destroy_batch(Batch *batch) {
+    vkDestroySemaphore(g_Device, batch->semaphore, g_Allocator);
+    vkDestroyFence(g_Device, batch->fence, g_Allocator);
+    vkDestroyCommandPool(g_Device, batch->command_pool, g_Allocator);
+    delete batch;
+}
+
+void setup() {
+    g_RingSize = Constants::staging_ring_size;
+    g_Ring = Memory::create_buffer(g_RingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, Memory::Usage::Upload);
+    g_RingData = static_cast<uint8_t *>(g_Ring->allocation.mapped);
+    g_RingHead = g_RingTail = 0;
+}
+
+// Only valid once the device is idle and the deletion queue has been flushed
+void cleanup() {
+    std::set<Batch *> batches(g_FreeBatches.begin(), g_FreeBatches.end());
+    batches.insert(g_InFlight.begin(), g_InFlight.end());
+    for (Batch *batch : g_InFlight) {
+        if (batch->chained) batches.insert(batch->chained);
+    }
+    if (g_WaitForGraphics) batches.insert(g_WaitForGraphics);
+    if (g_Recording) batches.insert(g_Recording);
+    for (Batch *batch : batches) destroy_batch(batch);
+    g_Recording = nullptr;
+    g_FreeBatches.clear();
+    g_InFlight.clear();
+    g_WaitForGraphics = nullptr;
+    Memory::destroy_buffer(g_Ring);
+    g_Ring = nullptr;
+}
+
+void release_semaphore(Batch *batch) {
+    batch->semaphore_busy = false;
+    bool in_flight = std::find(g_InFlight.begin(), g_InFlight.end(), batch) != g_InFlight.end();
+    if (!in_flight) g_FreeBatches.push_back(batch);
+}
+
+// Retires finished batches in submission order, handing their ring space back
+void collect() {
+    while (!g_InFlight.empty()) {
+        Batch *batch = g_InFlight.front();
+        if (vkGetFenceStatus(g_Device, batch->fence) != VK_SUCCESS) break;
+        g_RingTail = batch->ring_end;
+        g_InFlight.pop_front();
+        // Its wait on the chained batch's semaphore has executed
+        if (batch->chained) release_semaphore(std::exchange(batch->chained, nullptr));
+        if (!batch->semaphore_busy) g_FreeBatches.push_back(batch);
+    }
+}
+
+// Blocks until the oldest in-flight batch has finished and hands its ring space back, for loaders
+// that can't wait for the next frame. False if nothing is in flight, waiting then can't free space.
+bool wait_oldest() {
+    if (g_InFlight.empty()) return false;
+    Vulkan::check(vkWaitForFences(g_Device, 1, &g_InFlight.front()->fence, VK_TRUE, Constants::no_timeout));
+    collect();
+    return true;
+}
+
+Batch *recording_batch() {
+    if (g_Recording) return g_Recording;
+    if (g_FreeBatches.empty()) {
+        g_Recording = create_batch();
+    } else {
+        g_Recording = g_FreeBatches.back();
+        g_FreeBatches.pop_back();
+    }
+    Vulkan::check(vkResetFences(g_Device, 1, &g_Recording->fence));
+    Vulkan::check(vkResetCommandPool(g_Device, g_Recording->command_pool, Constants::no_flags));
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    Vulkan::check(vkBeginCommandBuffer(g_Recording->command_buffer, &info));
+    return g_Recording;
+}
+
+// Reserves `size` bytes of staging memory, returns false if the ring is full. Allocations never
+// straddle the end of the ring.
+bool reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) {
+    if (size > g_RingSize) return false;
+    collect();
+    uint64_t start = (g_RingHead + alignment - 1) & ~(alignment - 1);
+    if (start % g_RingSize + size > g_RingSize) start = (start / g_RingSize + 1) * g_RingSize;
+    if (start + size - g_RingTail > g_RingSize) return false;
+    g_RingHead = start + size;
+    offset = start % g_RingSize;
+    return true;
+}
+
+// Queues a copy of `size` bytes into `dst` at `dst_offset`. The destination must not be in use by
+// in-flight graphics work; the data is visible to graphics from the first frame submitted after
+// the next flush(). Returns false if the ring is full, retry next frame.
+bool upload_buffer(Memory::Buffer *dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size) {
+    VkDeviceSize offset;
+    if (!reserve(size, Constants::staging_alignment, offset)) return false;
+    std::memcpy(g_RingData + offset, data, size);
+
+    Batch *batch = recording_batch();
+    dst->last_write_frame = g_FrameNumber; // Pins a movable buffer until the copy has been acquired
+    VkBufferCopy region = {offset, dst_offset, size};
+    vkCmdCopyBuffer(batch->command_buffer, g_Ring->buffer, dst->buffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    // Shared buffers are never owned by one family, the graphics submit's semaphore wait is enough
+    bool release = needs_ownership_transfer() && !dst->shared;
+    barrier.srcQueueFamilyIndex = release ? g_TransferQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = release ? g_QueueFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = dst->buffer;
+    barrier.offset = dst_offset;
+    barrier.size = size;
+    if (release) {
+        // Release half, the acquire half with the real dstAccessMask goes into the graphics queue
+        vkCmdPipelineBarrier(batch->command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            Constants::no_flags, 0, nullptr, 1, &barrier, 0, nullptr);
+        barrier.srcAccessMask = 0;
+    }
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    g_Recorded.buffers.push_back(barrier);
+    g_BytesUploaded += size;
+    return true;
+}
+
+// Uploads tightly packed texel data for a whole mip level/layer range and leaves the image in
+// `final_layout` for graphics. The previous contents are discarded.
+bool upload_image(VkImage dst, VkImageSubresourceLayers subresource, VkExtent3D extent, VkImageLayout final_layout, const void *data, VkDeviceSize size) {
+    VkDeviceSize offset;
+    if (!reserve(size, Constants::staging_alignment, offset)) return false;
+    std::memcpy(g_RingData + offset, data, size);
+
+    Batch *batch = recording_batch();
+    VkImageSubresourceRange range = {subresource.aspectMask, subresource.mipLevel, 1, subresource.baseArrayLayer, subresource.layerCount};
+    VkImageMemoryBarrier to_transfer = {};
+    to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    to_transfer.srcAccessMask = 0;
+    to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_transfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.image = dst;
+    to_transfer.subresourceRange = range;
+    vkCmdPipelineBarrier(batch->command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        Constants::no_flags, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = offset;
+    region.imageSubresource = subresource;
+    region.imageExtent = extent;
+    vkCmdCopyBufferToImage(batch->command_buffer, g_Ring->buffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // Layout transition to final_layout, done as part of the ownership transfer when there is one
+    VkImageMemoryBarrier barrier = to_transfer;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = final_layout;
+    barrier.srcQueueFamilyIndex = needs_ownership_transfer() ? g_TransferQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = needs_ownership_transfer() ? g_QueueFamily : VK_QUEUE_FAMILY_IGNORED;
+    if (needs_ownership_transfer()) {
+        vkCmdPipelineBarrier(batch->command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            Constants::no_flags, 0, nullptr, 0, nullptr, 1, &barrier);
+        barrier.srcAccessMask = 0;
+    }
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    g_Recorded.images.push_back(barrier);
+    g_BytesUploaded += size;
+    return true;
+}
+
+// Submits everything queued since the last flush as one batch
+void flush() {
+    if (!g_Recording) return;
+    Batch *batch = g_Recording;
+    g_Recording = nullptr;
+    Vulkan::check(vkEndCommandBuffer(batch->command_buffer));
+
+    // Consume the semaphore graphics hasn't waited on yet, ours then covers both batches
+    const VkPipelineStageFlags chained_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    batch->chained = std::exchange(g_WaitForGraphics, nullptr);
+    VkSubmitInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.waitSemaphoreCount = batch->chained ? 1 : 0;
+    info.pWaitSemaphores = batch->chained ? &batch->chained->semaphore : nullptr;
+    info.pWaitDstStageMask = &chained_stage;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &batch->command_buffer;
+    info.signalSemaphoreCount = 1;
+    info.pSignalSemaphores = &batch->semaphore;
+    Vulkan::check(vkQueueSubmit(g_TransferQueue, 1, &info, batch->fence));
+
+    batch->ring_end = g_RingHead;
+    batch->semaphore_busy = true;
+    g_InFlight.push_back(batch);
+    g_WaitForGraphics = batch;
+    auto &buffers = g_AcquiresForGraphics.buffers;
+    auto &images = g_AcquiresForGraphics.images;
+    buffers.insert(buffers.end(), g_Recorded.buffers.begin(), g_Recorded.buffers.end());
+    images.insert(images.end(), g_Recorded.images.begin(), g_Recorded.images.end());
+    g_Recorded.buffers.clear();
+    g_Recorded.images.clear();
+    ++g_BatchesSubmitted;
+}
+
+// Graphics side: records the acquire barriers into the frame's command buffer (outside a render
+// pass) and adds the batch semaphores to the frame's submit
+void acquire_for_graphics(VkCommandBuffer cmd, Vulkan::SubmitWaits &waits) {
+    if (!g_WaitForGraphics) return;
+    auto &buffers = g_AcquiresForGraphics.buffers;
+    auto &images = g_AcquiresForGraphics.images;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, Constants::no_flags,
+        0, nullptr,
+        static_cast<uint32_t>(buffers.size()), buffers.data(),
+        static_cast<uint32_t>(images.size()), images.data());
+    buffers.clear();
+    images.clear();
+
+    waits.add(g_WaitForGraphics->semaphore, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+    // A binary semaphore may only be signalled again once its wait has executed, i.e. once this frame retired
+    DeletionQueue::push([batch = std::exchange(g_WaitForGraphics, nullptr)] { release_semaphore(batch); });
+}
+} // namespace DS::Transfer
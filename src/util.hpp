@@ -30,6 +30,83 @@ constexpr char null_terminator = '\0';
 constexpr uint32_t queue_familily_not_init = std::numeric_limits<uint32_t>::max();
 
 constexpr uint32_t descriptor_pool_count = 8;
+
+constexpr uint32_t default_frames_in_flight = 2;
+constexpr uint32_t max_frames_in_flight = 4;
+constexpr uint64_t acquire_timeout_ns = 100'000'000; // Drop the frame rather than block forever
+
+constexpr uint32_t headless_image_count = 3;
+constexpr VkFormat headless_color_format = VK_FORMAT_B8G8R8A8_UNORM;
+constexpr double frame_rate_report_interval_s = 1.0;
+
+constexpr const char *pipeline_cache_path = "pipeline_cache.bin";
+constexpr uint64_t pipeline_cache_max_size = 256ull * 1024 * 1024; // Larger headers are treated as corrupt
+
+constexpr VkDeviceSize memory_block_size = 64ull << 20;
+constexpr VkDeviceSize memory_min_block_size = 1ull << 20;
+constexpr VkDeviceSize memory_min_allocation = 256;
+constexpr uint32_t defrag_moves_per_frame = 4;
+
+constexpr VkDeviceSize staging_ring_size = 32ull << 20;
+constexpr VkDeviceSize staging_alignment = 16;
+
+constexpr uint32_t bench_record_tasks = 256;
+constexpr uint32_t bench_record_commands = 1000;
+constexpr uint32_t bench_record_runs = 5;
+
+constexpr uint32_t bench_suite_samples = 15;
+constexpr uint32_t bench_suite_sample_ms = 20; // Micro benchmark batches are sized to take about this long
+constexpr uint32_t bench_suite_extensions = 512;
+constexpr uint32_t bench_suite_warmup_frames = 30;
+constexpr uint32_t bench_suite_frames = 500;
+constexpr uint32_t bench_suite_resizes = 20;
+constexpr uint32_t bench_suite_meshes = 10'000;
+constexpr uint32_t bench_suite_sprites = 10'000;
+constexpr uint32_t bench_suite_mesh_scale_min = 1'000; // macro/meshes/<n>, in steps of 10x
+constexpr uint32_t bench_suite_mesh_scale_max = 1'000'000;
+constexpr uint32_t bench_suite_mesh_scale_frames = 100;
+constexpr const char *bench_suite_json_path = "bench.json";
+
+constexpr uint32_t bindless_image_capacity = 16384; // Clamped to the device's update-after-bind limits
+constexpr uint32_t bindless_buffer_capacity = 8192;
+constexpr uint32_t bindless_sampler_capacity = 256;
+constexpr uint32_t bindless_push_constant_size = 128; // The guaranteed minimum maxPushConstantsSize
+
+constexpr uint64_t log_ring_capacity = 4096; // Slots, power of two
+constexpr size_t log_payload_size = 224;     // Argument bytes per slot, makes a slot 256 bytes
+constexpr uint32_t log_site_burst = 256;     // Messages per second a single log site may write, above that it is a storm
+constexpr uint32_t log_writer_sleep_ms = 1;
+
+constexpr uint32_t max_job_threads = 64;
+constexpr size_t job_payload_size = 32;         // Inline functor storage, Job is one cache line
+constexpr int64_t job_deque_capacity = 1 << 14; // Per thread, a full deque runs jobs inline
+constexpr size_t job_arena_size = 8ull << 20;   // Per frame
+constexpr uint32_t job_idle_spins = 64;         // Yields before an idle worker goes to sleep
+constexpr uint32_t bench_jobs_per_round = 10'000;
+constexpr uint32_t bench_jobs_rounds = 5;
+
+constexpr uint32_t on_demand_settle_frames = 3;       // Redraws after an event, ImGui needs a few to settle hover and layout
+constexpr uint32_t on_demand_redraw_interval_ms = 1000; // Keeps clocks and stats fresh while idle
+constexpr uint32_t minimized_wait_ms = 100;
+constexpr uint32_t max_target_fps = 1000;
+constexpr uint32_t limiter_spin_us = 1000; // Spin the last stretch, sleeps overshoot by up to a scheduler tick
+constexpr double idle_report_interval_s = 0.5;
+
+constexpr const char *shader_dir = "shaders";
+constexpr const char *shader_cache_dir = "shaders/cache"; // Hot reloaded SPIR-V, named by the hash of its source
+constexpr const char *shader_target_env = "vulkan1.2";    // Same as the build, see CMakeLists.txt
+constexpr uint32_t shader_watch_interval_ms = 100;        // How often the watcher checks for shutdown, or polls without inotify
+constexpr uint32_t shader_reload_debounce_ms = 30;
+
+constexpr uint32_t sprite_initial_capacity = 1 << 16; // Instances per frame buffer, grows by doubling
+constexpr uint32_t sprite_write_batch = 16'384;       // Instances per job when filling the buffer
+constexpr uint32_t bench_sprite_count = 250'000;
+constexpr uint32_t bench_sprite_runs = 5;
+
+constexpr uint32_t mesh_max_objects = 1 << 20; // Also clamped to maxDrawIndirectCount
+
+constexpr uint64_t asset_stream_budget = 8ull << 20; // Staged per frame, a larger mip level still goes in one piece
+constexpr uint64_t asset_chunk_size = 4ull << 20;    // Largest single buffer upload
 } // namespace DS::Constants
 
 namespace DS::Util {
@@ -0,0 +1,287 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "global.hpp"
+#include "log.hpp"
+#include "util.hpp"
+#include "vulkan_util.hpp"
+
+using std::println, std::print;
+
+namespace DS::Validation {
+// The tier is fixed at instance creation. Off loads neither the layer nor VK_EXT_debug_utils, so the
+// function pointers below stay null and naming / labelling is a single branch per call.
+enum class Tier {
+    Off,
+    Errors, // Validation layer, only errors reach the messenger
+    Full,   // Errors, warnings and performance warnings
+    Sync,   // Full plus synchronization validation
+    Gpu,    // Full plus GPU-assisted validation (shader instrumentation)
+};
+constexpr auto tier_names = std::to_array<const char *>({"off", "errors", "full", "sync", "gpu"});
+
+enum Severity : uint32_t { Error, Warning, Info, severity_count };
+
+#ifdef NDEBUG
+constexpr Tier default_tier = Tier::Off;
+#else
+constexpr Tier default_tier = Tier::Errors;
+#endif
+
+std::optional<Tier> g_Requested; // From --validation, falls back to DS_VALIDATION
+Tier g_Tier = Tier::Off;         // What request() actually enabled
+VkDebugUtilsMessengerEXT g_Messenger = VK_NULL_HANDLE;
+
+PFN_vkCreateDebugUtilsMessengerEXT f_vkCreateDebugUtilsMessengerEXT = nullptr;
+PFN_vkDestroyDebugUtilsMessengerEXT f_vkDestroyDebugUtilsMessengerEXT = nullptr;
+PFN_vkSetDebugUtilsObjectNameEXT f_vkSetDebugUtilsObjectNameEXT = nullptr;
+PFN_vkCmdBeginDebugUtilsLabelEXT f_vkCmdBeginDebugUtilsLabelEXT = nullptr;
+PFN_vkCmdEndDebugUtilsLabelEXT f_vkCmdEndDebugUtilsLabelEXT = nullptr;
+
+// The messenger runs on whichever thread made the offending call
+std::array<std::atomic<uint32_t>, severity_count> g_FrameMessages = {};
+std::array<std::atomic<uint64_t>, severity_count> g_TotalMessages = {};
+std::atomic<int64_t> g_FrameCallbackNs{0};
+std::array<uint32_t, severity_count> g_MessagesLastFrame = {};
+double g_CallbackMsLastFrame = 0.0;
+
+// Kept alive between request() and vkCreateInstance
+VkDebugUtilsMessengerCreateInfoEXT g_MessengerInfo = {};
+VkValidationFeaturesEXT g_Features = {};
+VkValidationFeatureEnableEXT g_FeatureEnables[2] = {};
+
+std::optional<Tier> parse_tier(std::string_view name) {
+    for (size_t i = 0; i < tier_names.size(); ++i) {
+        if (name == tier_names[i]) return static_cast<Tier>(i);
+    }
+    return std::nullopt;
+}
+
+const char *tier_name(Tier tier) { return tier_names[static_cast<size_t>(tier)]; }
+
+bool enabled() { return g_Tier != Tier::Off; }
+
+VKAPI_ATTR VkBool32 VKAPI_CALL messenger(
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+    VkDebugUtilsMessageTypeFlagsEXT types,
+    const VkDebugUtilsMessengerCallbackDataEXT *data,
+    void *user_data) {
+
+    (void)types;
+    (void)user_data;
+    auto start = std::chrono::steady_clock::now();
+
+    // Object names and the innermost command buffer labels are what make a message findable
+    std::string context;
+    for (uint32_t i = 0; i < data->objectCount; ++i) {
+        const VkDebugUtilsObjectNameInfoEXT &object = data->pObjects[i];
+        if (object.pObjectName) std::format_to(std::back_inserter(context), "\n\tObject: {}", object.pObjectName);
+    }
+    for (uint32_t i = data->cmdBufLabelCount; i > 0; --i) {
+        std::format_to(std::back_inserter(context), "\n\tIn: {}", data->pCmdBufLabels[i - 1].pLabelName);
+    }
+    const char *id = data->pMessageIdName ? data->pMessageIdName : "";
+
+    // Validation storms are what the logger's rate limit and repeat folding are for
+    Severity counted;
+    if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        counted = Error;
+        DS_LOG_ERROR_ASYNC(Vulkan, "{}: {}{}", id, data->pMessage, context);
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        counted = Warning;
+        DS_LOG_WARNING(Vulkan, "{}: {}{}", id, data->pMessage, context);
+    } else {
+        counted = Info;
+        DS_LOG_DEBUG(Vulkan, "{}: {}{}", id, data->pMessage, context);
+    }
+    g_FrameMessages[counted].fetch_add(1, std::memory_order_relaxed);
+    g_TotalMessages[counted].fetch_add(1, std::memory_order_relaxed);
+    g_FrameCallbackNs.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(),
+        std::memory_order_relaxed);
+    return VK_FALSE;
+}
+
+bool has_layer(Vulkan::ValidationLayer layer) {
+    uint32_t count = 0;
+    vkEnumerateInstanceLayerProperties(&count, nullptr);
+    std::vector<VkLayerProperties> layers(count);
+    vkEnumerateInstanceLayerProperties(&count, layers.data());
+    for (const VkLayerProperties &l : layers) {
+        if (strcmp(l.layerName, layer) == 0) return true;
+    }
+    return false;
+}
+
+// Resolves the requested tier and adds the layer, extensions and pNext chain it needs to the
+// instance create info. `properties` are the loader's instance extensions.
+void request(VkInstanceCreateInfo &create_info, std::vector<Vulkan::Extension> &extensions,
+    const std::vector<VkExtensionProperties> &properties) {
+    static Vulkan::ValidationLayer layers[] = {Vulkan::Strings::layer_validation};
+
+    std::optional<Tier> tier = g_Requested;
+    const char *source = "--validation";
+    if (!tier) {
+        const char *env = std::getenv("DS_VALIDATION");
+        source = "DS_VALIDATION";
+        if (env != nullptr && !(tier = parse_tier(env))) {
+            DS_LOG_WARNING(Vulkan, "DS_VALIDATION '{}' is not one of off, errors, full, sync, gpu", env);
+        }
+    }
+    if (!tier) {
+        tier = default_tier;
+        source = "build default";
+    }
+    g_Tier = *tier;
+    if (g_Tier == Tier::Off) {
+        DS_LOG_INFO(Vulkan, "Validation off ({})", source);
+        return;
+    }
+
+    if (!has_layer(Vulkan::Strings::layer_validation)) {
+        DS_LOG_WARNING(Vulkan, "Validation tier {} requested by {} but {} is not installed, validation off",
+            tier_name(g_Tier), source, Vulkan::Strings::layer_validation);
+        g_Tier = Tier::Off;
+        return;
+    }
+    create_info.enabledLayerCount = 1;
+    create_info.ppEnabledLayerNames = layers;
+
+    // debug_utils is usually provided by the loader, otherwise by the layer itself
+    uint32_t count = 0;
+    vkEnumerateInstanceExtensionProperties(Vulkan::Strings::layer_validation, &count, nullptr);
+    std::vector<VkExtensionProperties> layer_properties(count);
+    vkEnumerateInstanceExtensionProperties(Vulkan::Strings::layer_validation, &count, layer_properties.data());
+    if (!Vulkan::has_extension(properties, Vulkan::Strings::extension_debug_utils) &&
+        !Vulkan::has_extension(layer_properties, Vulkan::Strings::extension_debug_utils)) {
+        DS_LOG_WARNING(Vulkan, "{} is not available, validation runs without a messenger", Vulkan::Strings::extension_debug_utils);
+    } else {
+        extensions.push_back(Vulkan::Strings::extension_debug_utils);
+        // Chained into the instance as well, so vkCreateInstance / vkDestroyInstance get reported
+        g_MessengerInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+        g_MessengerInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        g_MessengerInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+        if (g_Tier != Tier::Errors) {
+            g_MessengerInfo.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+            g_MessengerInfo.messageType |= VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        }
+        g_MessengerInfo.pfnUserCallback = messenger;
+        g_MessengerInfo.pNext = create_info.pNext;
+        create_info.pNext = &g_MessengerInfo;
+    }
+
+    if (g_Tier == Tier::Sync || g_Tier == Tier::Gpu) {
+        if (!Vulkan::has_extension(layer_properties, Vulkan::Strings::extension_validation_features)) {
+            DS_LOG_WARNING(Vulkan, "{} is not available, falling back to validation tier full",
+                Vulkan::Strings::extension_validation_features);
+            g_Tier = Tier::Full;
+        } else {
+            extensions.push_back(Vulkan::Strings::extension_validation_features);
+            uint32_t enable_count = 0;
+            if (g_Tier == Tier::Sync) {
+                g_FeatureEnables[enable_count++] = VK_VALIDATION_FEATURE_ENABLE_SYNCHRONIZATION_VALIDATION_EXT;
+            } else {
+                g_FeatureEnables[enable_count++] = VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_EXT;
+                g_FeatureEnables[enable_count++] = VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_RESERVE_BINDING_SLOT_EXT;
+            }
+            g_Features.sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT;
+            g_Features.enabledValidationFeatureCount = enable_count;
+            g_Features.pEnabledValidationFeatures = g_FeatureEnables;
+            g_Features.pNext = create_info.pNext;
+            create_info.pNext = &g_Features;
+        }
+    }
+    DS_LOG_INFO(Vulkan, "Validation tier {} ({})", tier_name(g_Tier), source);
+}
+
+// After vkCreateInstance: creates the messenger and loads the naming and label entry points
+void setup() {
+    if (g_MessengerInfo.pfnUserCallback == nullptr) return;
+    f_vkCreateDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(
+        vkGetInstanceProcAddr(g_Instance, Vulkan::Strings::vkCreateDebugUtilsMessengerEXT));
+    f_vkDestroyDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(
+        vkGetInstanceProcAddr(g_Instance, Vulkan::Strings::vkDestroyDebugUtilsMessengerEXT));
+    if (!f_vkCreateDebugUtilsMessengerEXT || !f_vkDestroyDebugUtilsMessengerEXT) {
+        DS_LOG_ERROR(Vulkan, "Failed to setup the debug utils messenger!");
+        abort();
+    }
+    VkDebugUtilsMessengerCreateInfoEXT info = g_MessengerInfo;
+    info.pNext = nullptr;
+    Vulkan::check(f_vkCreateDebugUtilsMessengerEXT(g_Instance, &info, g_Allocator, &g_Messenger));
+
+    f_vkSetDebugUtilsObjectNameEXT = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(
+        vkGetInstanceProcAddr(g_Instance, Vulkan::Strings::vkSetDebugUtilsObjectNameEXT));
+    f_vkCmdBeginDebugUtilsLabelEXT = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(
+        vkGetInstanceProcAddr(g_Instance, Vulkan::Strings::vkCmdBeginDebugUtilsLabelEXT));
+    f_vkCmdEndDebugUtilsLabelEXT = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(
+        vkGetInstanceProcAddr(g_Instance, Vulkan::Strings::vkCmdEndDebugUtilsLabelEXT));
+}
+
+// Formats the name only when it will actually be set
+template <typename Handle, typename... Args>
+void set_name(VkObjectType type, Handle handle, std::format_string<Args...> fmt, Args &&...args) {
+    if (f_vkSetDebugUtilsObjectNameEXT == nullptr || handle == VK_NULL_HANDLE) return;
+    std::string name = std::format(fmt, std::forward<Args>(args)...);
+    VkDebugUtilsObjectNameInfoEXT info = {};
+    info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    info.objectType = type;
+    if constexpr (std::is_pointer_v<Handle>) {
+        info.objectHandle = reinterpret_cast<uint64_t>(handle);
+    } else {
+        info.objectHandle = static_cast<uint64_t>(handle);
+    }
+    info.pObjectName = name.c_str();
+    f_vkSetDebugUtilsObjectNameEXT(g_Device, &info);
+}
+
+void begin_label(VkCommandBuffer cmd, const char *name) {
+    if (f_vkCmdBeginDebugUtilsLabelEXT == nullptr) return;
+    VkDebugUtilsLabelEXT label = {};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name;
+    f_vkCmdBeginDebugUtilsLabelEXT(cmd, &label);
+}
+
+void end_label(VkCommandBuffer cmd) {
+    if (f_vkCmdEndDebugUtilsLabelEXT == nullptr) return;
+    f_vkCmdEndDebugUtilsLabelEXT(cmd);
+}
+
+void begin_frame() {
+    if (!enabled()) return;
+    for (uint32_t s = 0; s < severity_count; ++s) {
+        g_MessagesLastFrame[s] = g_FrameMessages[s].exchange(0, std::memory_order_relaxed);
+    }
+    g_CallbackMsLastFrame = static_cast<double>(g_FrameCallbackNs.exchange(0, std::memory_order_relaxed)) / 1e6;
+}
+
+// Before vkDestroyInstance
+void cleanup() {
+    if (g_Messenger != VK_NULL_HANDLE) {
+        f_vkDestroyDebugUtilsMessengerEXT(g_Instance, g_Messenger, g_Allocator);
+        g_Messenger = VK_NULL_HANDLE;
+    }
+    if (enabled()) {
+        DS_LOG_INFO(Vulkan, "Validation tier {}: {} errors, {} warnings, {} info messages in total", tier_name(g_Tier),
+            g_TotalMessages[Error].load(), g_TotalMessages[Warning].load(), g_TotalMessages[Info].load());
+    }
+    f_vkSetDebugUtilsObjectNameEXT = nullptr;
+    f_vkCmdBeginDebugUtilsLabelEXT = nullptr;
+    f_vkCmdEndDebugUtilsLabelEXT = nullptr;
+}
+} // namespace DS::Validation
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <cstring>
 #include <format>
 #include <print>
@@ -6,6 +7,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include "log.hpp"
 #include "util.hpp"
 
 using std::println, std::print;
@@ -47,7 +49,31 @@ constexpr std::string_view vk_result_to_string(VkResult r) {
     }
 }
 
+constexpr std::string_view present_mode_to_string(VkPresentModeKHR mode) {
+    switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "FIFO_RELAXED";
+    default:
+        return "Unknown";
+    }
+}
+
 namespace std {
+template <>
+struct formatter<VkPresentModeKHR> : formatter<string_view> {
+    constexpr auto parse(format_parse_context &ctx) { return ctx.begin(); }
+    template <class FormatContext>
+    auto format(VkPresentModeKHR mode, FormatContext &ctx) const {
+        return format_to(ctx.out(), "{} ({})", present_mode_to_string(mode), Util::enum_to_number(mode));
+    }
+};
+
 template <>
 struct formatter<VkResult> : formatter<string_view> {
     constexpr auto parse(format_parse_context &ctx) { return ctx.begin(); }
@@ -104,31 +130,9 @@ namespace Vulkan {
 using Extension = const char *;
 using ValidationLayer = const char *;
 
-VKAPI_ATTR VkBool32 VKAPI_CALL debug_report(
-    VkDebugReportFlagsEXT flags,
-    VkDebugReportObjectTypeEXT objectType,
-    uint64_t object,
-    size_t location,
-    int32_t messageCode,
-    const char *pLayerPrefix,
-    const char *pMessage,
-    void *pUserData) {
-
-    (void)flags;
-    (void)object;
-    (void)location;
-    (void)messageCode;
-    (void)pUserData;
-    (void)pLayerPrefix; // Unused arguments
-    println(stderr,
-        "[Vulkan] Debug: ObjectType: {}\nMessage: {}\n",
-        Util::enum_to_number(objectType), pMessage);
-    return VK_FALSE;
-}
-
 void check(VkResult err) {
     if (err == VK_SUCCESS) return;
-    println(stderr, "[Vulkan] Error: VkResult = {}", err);
+    DS_LOG_ERROR(Vulkan, "VkResult = {}", err);
     if (err < 0) abort();
 }
 
@@ -142,23 +146,55 @@ std::vector<Extension> get_sdl_extensions() {
     return extensions;
 }
 
-bool check_extension(const std::vector<VkExtensionProperties> &properties, Extension extension) {
+bool has_extension(const std::vector<VkExtensionProperties> &properties, Extension extension) {
     for (const auto &p : properties) {
-        if (strcmp(p.extensionName, extension) == 0) {
-            println("[Vulkan] Info: Extension {} is availiable.", extension);
-            return true;
-        }
+        if (strcmp(p.extensionName, extension) == 0) return true;
     }
-    println("[Vulkan] Warning: Extension {} is not availiable.", extension);
     return false;
 }
 
+bool check_extension(const std::vector<VkExtensionProperties> &properties, Extension extension) {
+    if (has_extension(properties, extension)) {
+        DS_LOG_INFO(Vulkan, "Extension {} is availiable.", extension);
+        return true;
+    }
+    DS_LOG_WARNING(Vulkan, "Extension {} is not availiable.", extension);
+    return false;
+}
+
+// Extra semaphores a queue submit has to wait on, gathered from the subsystems feeding the frame.
+// `values` is only read for timeline semaphores, binary ones leave it at 0. Waits on a semaphore
+// that is already in the list are merged (stages combined, the later value kept).
+struct SubmitWaits {
+    std::vector<VkSemaphore> semaphores;
+    std::vector<VkPipelineStageFlags> stages;
+    std::vector<uint64_t> values;
+    uint32_t count = 0;
+
+    void add(VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value = 0) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (semaphores[i] != semaphore) continue;
+            stages[i] |= stage;
+            values[i] = std::max(values[i], value);
+            return;
+        }
+        semaphores.push_back(semaphore);
+        stages.push_back(stage);
+        values.push_back(value);
+        ++count;
+    }
+};
+
 namespace Strings {
-const char *vkCreateDebugReportCallbackEXT = "vkCreateDebugReportCallbackEXT";
-const char *vkDestroyDebugReportCallbackEXT = "vkDestroyDebugReportCallbackEXT";
+const char *vkCreateDebugUtilsMessengerEXT = "vkCreateDebugUtilsMessengerEXT";
+const char *vkDestroyDebugUtilsMessengerEXT = "vkDestroyDebugUtilsMessengerEXT";
+const char *vkSetDebugUtilsObjectNameEXT = "vkSetDebugUtilsObjectNameEXT";
+const char *vkCmdBeginDebugUtilsLabelEXT = "vkCmdBeginDebugUtilsLabelEXT";
+const char *vkCmdEndDebugUtilsLabelEXT = "vkCmdEndDebugUtilsLabelEXT";
 
-Vulkan::Extension extension_debug_report = "VK_EXT_debug_report";
+Vulkan::Extension extension_debug_utils = "VK_EXT_debug_utils";
 Vulkan::Extension extension_swapchain = "VK_KHR_swapchain";
+Vulkan::Extension extension_validation_features = "VK_EXT_validation_features";
 
 Vulkan::ValidationLayer layer_validation = "VK_LAYER_KHRONOS_validation";
 } // namespace Strings
@@ -0,0 +1,343 @@
+// Offline packer for the engine's asset container, see src/asset_format.hpp.
+//
+//   asset_packer <output.pak> [--synthetic <n>] <inputs>...
+//
+// Inputs are packed by extension: .obj meshes (positions, normals, faces fanned into triangles),
+// binary .ppm (P6) textures with a box filtered mip chain, anything else as an opaque blob. Assets
+// are named by their path as given on the command line. --synthetic adds n generated 1024x1024
+// textures, handy for load benchmarks without real content.
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <print>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "../src/asset_format.hpp"
+
+using std::println, std::print;
+
+namespace Format = DS::AssetFormat;
+
+namespace {
+struct Asset {
+    std::string name;
+    Format::Entry entry = {};
+    std::vector<uint8_t> payload;
+};
+
+struct Vertex { // DS::Meshes::Vertex
+    float position[3];
+    float normal[3];
+};
+static_assert(sizeof(Vertex) == 24);
+
+constexpr uint32_t synthetic_size = 1024;
+
+bool read_file(const std::filesystem::path &path, std::vector<uint8_t> &bytes) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    bytes.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(file);
+}
+
+template <typename T>
+void append(std::vector<uint8_t> &bytes, const std::vector<T> &values) {
+    const auto *data = reinterpret_cast<const uint8_t *>(values.data());
+    bytes.insert(bytes.end(), data, data + values.size() * sizeof(T));
+}
+
+// Fills in the levels after the first by averaging 2x2 blocks (edges clamp on odd sizes)
+void build_mips(Asset &asset, std::vector<uint8_t> base) {
+    Format::Entry &entry = asset.entry;
+    entry.mip_levels = 1 + static_cast<uint32_t>(std::bit_width(std::max(entry.width, entry.height)) - 1);
+    asset.payload.assign(Format::level_offset(entry, entry.mip_levels - 1) + Format::level_size(entry, entry.mip_levels - 1), 0);
+    std::copy(base.begin(), base.end(), asset.payload.begin());
+    for (uint32_t level = 1; level < entry.mip_levels; ++level) {
+        const uint8_t *src = asset.payload.data() + Format::level_offset(entry, level - 1);
+        uint8_t *dst = asset.payload.data() + Format::level_offset(entry, level);
+        const uint32_t src_w = Format::level_extent(entry.width, level - 1);
+        const uint32_t src_h = Format::level_extent(entry.height, level - 1);
+        const uint32_t w = Format::level_extent(entry.width, level);
+        const uint32_t h = Format::level_extent(entry.height, level);
+        for (uint32_t y = 0; y < h; ++y) {
+            for (uint32_t x = 0; x < w; ++x) {
+                for (uint32_t c = 0; c < 4; ++c) {
+                    uint32_t sum = 0;
+                    for (uint32_t dy = 0; dy < 2; ++dy) {
+                        for (uint32_t dx = 0; dx < 2; ++dx) {
+                            uint32_t sx = std::min(x * 2 + dx, src_w - 1);
+                            uint32_t sy = std::min(y * 2 + dy, src_h - 1);
+                            sum += src[(sy * src_w + sx) * 4 + c];
+                        }
+                    }
+                    dst[(y * w + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+    asset.entry.size = asset.payload.size();
+}
+
+bool pack_ppm(const std::vector<uint8_t> &bytes, Asset &asset) {
+    std::string text(bytes.begin(), bytes.end());
+    std::istringstream stream(text);
+    std::string tag;
+    uint32_t width = 0, height = 0, max_value = 0;
+    stream >> tag;
+    // Skip comments between the header fields
+    auto next = [&stream](uint32_t &value) {
+        stream >> std::ws;
+        while (stream.peek() == '#') {
+            std::string comment;
+            std::getline(stream, comment);
+            stream >> std::ws;
+        }
+        stream >> value;
+    };
+    next(width);
+    next(height);
+    next(max_value);
+    if (tag != "P6" || !stream || width == 0 || height == 0 || max_value != 255) {
+        println(stderr, "[  Pack] Error: {}: only binary 8 bit PPM (P6) is supported", asset.name);
+        return false;
+    }
+    stream.get(); // Single whitespace before the raster
+    size_t raster = static_cast<size_t>(stream.tellg());
+    if (bytes.size() - raster < static_cast<size_t>(width) * height * 3) {
+        println(stderr, "[  Pack] Error: {}: truncated raster", asset.name);
+        return false;
+    }
+    std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+        std::memcpy(&rgba[i * 4], &bytes[raster + i * 3], 3);
+        rgba[i * 4 + 3] = 255;
+    }
+    asset.entry.type = Format::Type::Texture;
+    asset.entry.format = Format::TextureFormat::RGBA8;
+    asset.entry.width = width;
+    asset.entry.height = height;
+    build_mips(asset, std::move(rgba));
+    return true;
+}
+
+// The whole of `text` as a (possibly negative) OBJ index
+bool parse_index(std::string_view text, int64_t &out) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return !text.empty() && ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+bool pack_obj(const std::vector<uint8_t> &bytes, Asset &asset) {
+    std::istringstream stream(std::string(bytes.begin(), bytes.end()));
+    std::vector<std::array<float, 3>> positions;
+    std::vector<std::array<float, 3>> normals;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::map<std::pair<int64_t, int64_t>, uint32_t> unique; // (position, normal) -> vertex
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::istringstream fields(line);
+        std::string tag;
+        fields >> tag;
+        if (tag == "v" || tag == "vn") {
+            std::array<float, 3> value = {};
+            fields >> value[0] >> value[1] >> value[2];
+            (tag == "v" ? positions : normals).push_back(value);
+        } else if (tag == "f") {
+            std::vector<uint32_t> face;
+            std::string corner;
+            while (fields >> corner) {
+                // v, v/vt, v//vn or v/vt/vn, negative indices count from the end
+                int64_t v = 0, vn = 0;
+                std::string_view text = corner;
+                size_t first = text.find('/');
+                size_t last = text.rfind('/');
+                bool has_normal = first != std::string_view::npos && last != first;
+                if (!parse_index(text.substr(0, first), v) || (has_normal && !parse_index(text.substr(last + 1), vn))) {
+                    println(stderr, "[  Pack] Error: {}: malformed face index in '{}'", asset.name, line);
+                    return false;
+                }
+                if (v < 0) v += static_cast<int64_t>(positions.size()) + 1;
+                if (vn < 0) vn += static_cast<int64_t>(normals.size()) + 1;
+                if (v < 1 || v > static_cast<int64_t>(positions.size()) || vn > static_cast<int64_t>(normals.size())) {
+                    println(stderr, "[  Pack] Error: {}: face index out of range in '{}'", asset.name, line);
+                    return false;
+                }
+                auto [it, inserted] = unique.try_emplace({v, vn}, static_cast<uint32_t>(vertices.size()));
+                if (inserted) {
+                    Vertex vertex = {};
+                    std::memcpy(vertex.position, positions[v - 1].data(), sizeof(vertex.position));
+                    if (vn > 0) std::memcpy(vertex.normal, normals[vn - 1].data(), sizeof(vertex.normal));
+                    vertices.push_back(vertex);
+                }
+                face.push_back(it->second);
+            }
+            for (size_t i = 2; i < face.size(); ++i) indices.insert(indices.end(), {face[0], face[i - 1], face[i]});
+        }
+    }
+    if (indices.empty()) {
+        println(stderr, "[  Pack] Error: {}: no faces", asset.name);
+        return false;
+    }
+    asset.entry.type = Format::Type::Mesh;
+    asset.entry.vertex_count = static_cast<uint32_t>(vertices.size());
+    asset.entry.vertex_stride = sizeof(Vertex);
+    asset.entry.index_count = static_cast<uint32_t>(indices.size());
+    append(asset.payload, vertices);
+    asset.payload.resize(Format::align_up(asset.payload.size(), sizeof(uint32_t)));
+    asset.entry.index_offset = asset.payload.size();
+    append(asset.payload, indices);
+    asset.entry.size = asset.payload.size();
+    return true;
+}
+
+Asset synthetic_texture(uint32_t index) {
+    Asset asset;
+    asset.name = std::format("synthetic/{}", index);
+    asset.entry.type = Format::Type::Texture;
+    asset.entry.format = Format::TextureFormat::RGBA8;
+    asset.entry.width = synthetic_size;
+    asset.entry.height = synthetic_size;
+    std::vector<uint8_t> rgba(static_cast<size_t>(synthetic_size) * synthetic_size * 4);
+    for (uint32_t y = 0; y < synthetic_size; ++y) {
+        for (uint32_t x = 0; x < synthetic_size; ++x) {
+            uint8_t *texel = &rgba[(static_cast<size_t>(y) * synthetic_size + x) * 4];
+            texel[0] = static_cast<uint8_t>(x ^ y);
+            texel[1] = static_cast<uint8_t>(x + index * 37);
+            texel[2] = static_cast<uint8_t>(y * 3);
+            texel[3] = 255;
+        }
+    }
+    build_mips(asset, std::move(rgba));
+    return asset;
+}
+
+bool write_package(const std::filesystem::path &path, std::vector<Asset> &assets) {
+    std::sort(assets.begin(), assets.end(), [](const Asset &a, const Asset &b) { return a.name < b.name; });
+    for (size_t i = 1; i < assets.size(); ++i) {
+        if (assets[i].name == assets[i - 1].name) {
+            println(stderr, "[  Pack] Error: Asset '{}' given twice", assets[i].name);
+            return false;
+        }
+    }
+
+    Format::Header header = {};
+    header.magic = Format::magic;
+    header.version = Format::version;
+    header.entry_count = static_cast<uint32_t>(assets.size());
+    uint64_t offset = Format::align_up(sizeof(Format::Header), Format::data_alignment);
+    std::string names;
+    for (Asset &asset : assets) {
+        asset.entry.offset = offset;
+        asset.entry.size = asset.payload.size();
+        asset.entry.name_offset = static_cast<uint32_t>(names.size());
+        asset.entry.name_size = static_cast<uint32_t>(asset.name.size());
+        names += asset.name;
+        offset = Format::align_up(offset + asset.entry.size, Format::data_alignment);
+    }
+    header.index_offset = offset;
+    header.names_offset = header.index_offset + assets.size() * sizeof(Format::Entry);
+    header.names_size = names.size();
+    header.file_size = header.names_offset + header.names_size;
+
+    // Temp file and rename, a failed pack never leaves a half written package behind
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        auto pad_to = [&file](uint64_t position) {
+            static const std::array<char, Format::data_alignment> zeros = {};
+            uint64_t current = static_cast<uint64_t>(file.tellp());
+            if (position > current) file.write(zeros.data(), static_cast<std::streamsize>(position - current));
+        };
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const Asset &asset : assets) {
+            pad_to(asset.entry.offset);
+            file.write(reinterpret_cast<const char *>(asset.payload.data()), static_cast<std::streamsize>(asset.payload.size()));
+        }
+        pad_to(header.index_offset);
+        for (const Asset &asset : assets) file.write(reinterpret_cast<const char *>(&asset.entry), sizeof(Format::Entry));
+        file.write(names.data(), static_cast<std::streamsize>(names.size()));
+        if (!file) {
+            println(stderr, "[  Pack] Error: Failed to write '{}'", tmp_path.string());
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        println(stderr, "[  Pack] Error: Failed to rename '{}': {}", tmp_path.string(), ec.message());
+        return false;
+    }
+
+    // Read back through the same validation the engine runs
+    std::vector<uint8_t> bytes;
+    Format::View view;
+    const char *error = read_file(path, bytes) ? Format::open(bytes, view) : "unreadable";
+    if (error) {
+        println(stderr, "[  Pack] Error: '{}' failed validation: {}", path.string(), error);
+        return false;
+    }
+    println("[  Pack] Info: Wrote '{}', {} assets, {:.2f} MiB", path.string(), assets.size(),
+        static_cast<double>(header.file_size) / (1024.0 * 1024.0));
+    return true;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        println(stderr, "Usage: asset_packer <output.pak> [--synthetic <n>] <inputs>...");
+        return 1;
+    }
+    std::vector<Asset> assets;
+    for (int i = 2; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--synthetic") {
+            uint32_t count = 0;
+            if (i + 1 >= argc || std::sscanf(argv[i + 1], "%u", &count) != 1) {
+                println(stderr, "[  Pack] Error: --synthetic expects a count");
+                return 1;
+            }
+            for (uint32_t n = 0; n < count; ++n) assets.push_back(synthetic_texture(n));
+            ++i;
+            continue;
+        }
+
+        std::filesystem::path path(arg);
+        Asset asset;
+        asset.name = path.generic_string();
+        std::vector<uint8_t> bytes;
+        if (!read_file(path, bytes)) {
+            println(stderr, "[  Pack] Error: Can't read '{}'", asset.name);
+            return 1;
+        }
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        bool ok = true;
+        if (extension == ".obj") {
+            ok = pack_obj(bytes, asset);
+        } else if (extension == ".ppm") {
+            ok = pack_ppm(bytes, asset);
+        } else {
+            asset.entry.type = Format::Type::Blob;
+            asset.payload = std::move(bytes);
+        }
+        if (!ok) return 1;
+        assets.push_back(std::move(asset));
+    }
+    return write_package(argv[1], assets) ? 0 : 1;
+}